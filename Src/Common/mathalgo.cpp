@@ -5,6 +5,8 @@
 
 namespace LoboLab {
 
+thread_local std::mt19937_64 MathAlgo::rand_gen(MathAlgo::randSeed());
+
 // Cumm prob t distribution for CI 90%
 double MathAlgo::t90[] = { 
   6.313751515,
@@ -231,14 +231,32 @@ bool insideArea(const int pX, const int pY, const QVector<QPointF> &area);
 
 // Returns a different number each milisecond 
 inline unsigned int randSeed() {
-  static std::random_device rdev;
+  static thread_local std::random_device rdev;
   return rdev();
 
   //return  1000 * QDateTime::currentDateTimeUtc().toTime_t() +
   //        (uint) QTime::currentTime().msec();
 }
 
-static std::mt19937_64 rand_gen(randSeed());
+// Shared by all the translation units, so its state can be checkpointed. 
+// One per thread, since several searches can evolve concurrently.
+extern thread_local std::mt19937_64 rand_gen;
+
+// Replaces the generator of the thread with an independent stream, given by 
+// the seed, in the scope, so the numbers drawn do not depend on the thread.
+// The previous state is restored at the end of the scope.
+class ScopedRandStream {
+ public:
+  explicit ScopedRandStream(quint64 seed)
+    : savedGen_(rand_gen) {
+    std::seed_seq seq = {(quint32) seed, (quint32) (seed >> 32)};
+    rand_gen.seed(seq);
+  }
+  ~ScopedRandStream() { rand_gen = savedGen_; }
+
+ private:
+  std::mt19937_64 savedGen_;
+};
 
 inline bool randBool() {
   return (rand_gen() % 2) == 0;
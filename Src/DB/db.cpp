@@ -9,6 +9,10 @@
 #include <QSqlRelationalTableModel>
 #include <QSqlError>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QMutexLocker>
 #include <QStringList>
 #include <QDebug>
 #include <QUuid>
@@ -18,8 +22,26 @@ namespace LoboLab {
 
 const char *DB::DatetimeFormat = "yyyy-MM-ddThh:mm:ss.zzzZ";
 
+const int DB::MaxRowsPerInsert = 64;
+// Limit of SQLite in its default build
+const int DB::MaxBoundValues = 999;
+
+const int DB::BusyTimeoutMsecs = 10000;
+const int DB::WalAutoCheckpointPages = 1000; // Default of SQLite
+const int DB::WalSizeLimit = 64 * 1024 * 1024; // Bytes kept after a checkpoint
+const int DB::MirrorPeriodMsecs = 60000;
+const int DB::SlowQueryMsecs = 100;
+
+QString DB::scratchDir_;
+QHash<QString, int> DB::nScratchUsers_;
+QMutex DB::scratchMutex_;
+QHash<QString, QHash<QString, int> > DB::nextIds_;
+QHash<QString, int> DB::nRecordingUsers_;
+QMutex DB::idsMutex_;
+
 DB::DB()
-  : nNestedTrans_(0), tempDbUsed_(false) {
+  : nNestedTrans_(0), readOnly_(false), recording_(false), 
+    tempDbUsed_(false), mirrorTransStart_(0), flushingMirror_(false) {
 }
 
 DB::~DB() {
@@ -27,6 +49,17 @@ DB::~DB() {
 }
 
 int DB::connect(const QString &fileName, bool inFastMode) {
+  return openConnection(fileName, inFastMode, false);
+}
+
+// For viewing the database while another process writes it. The log of the
+// writer is read too, so the data is as recent as the last commit.
+int DB::connectReadOnly(const QString &fileName) {
+  return openConnection(fileName, false, true);
+}
+
+int DB::openConnection(const QString &fileName, bool inFastMode, 
+                       bool readOnly) {
   int error = 0;
 
   if (isConnected())
@@ -41,26 +74,41 @@ int DB::connect(const QString &fileName, bool inFastMode) {
     db_ = QSqlDatabase::addDatabase("QSQLITE", connectionName);
 
     QString dbFileName;
-    if (false) { //fsType == "nfs") {
+    if (!scratchDir_.isEmpty() && !readOnly) {
       tempDbUsed_ = true;
-      originalFileName_ = fileName;
-      dbFileName = QDir::tempPath() + '/' + connectionName;
-      Log::write() << "DB::connect: NFS detected. Using tmp file: " << dbFileName << endl;
-      if (QFile::exists(dbFileName)) {
-        Log::write() << "DB::connect: WARNING tmp file overwritten." << dbFileName << endl;
-        QFile::remove(dbFileName);
-      }
-      QFile::copy(originalFileName_, dbFileName);
-      QFile::setPermissions(dbFileName, QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::WriteGroup);
+      originalFileName_ = QFileInfo(fileName).absoluteFilePath();
+      dbFileName = openScratch(originalFileName_);
     } else {
        dbFileName = fileName;
     }
   
     db_.setDatabaseName(dbFileName);
+    // The connections wait for the locks of the others instead of failing
+    QString options = QString("QSQLITE_BUSY_TIMEOUT=%1").arg(BusyTimeoutMsecs);
+    if (readOnly)
+      options += ";QSQLITE_OPEN_READONLY";
+    db_.setConnectOptions(options);
+    readOnly_ = readOnly;
+
     if (db_.open()) {
       QSqlQuery query(db_);
 
-      if(inFastMode) {
+      // The log needs shared memory, which is not reliable over the network.
+      // The journal mode is stored in the file, so the read-only connections
+      // use the one set by the writers.
+      if (!readOnly && (fsType != "nfs" || tempDbUsed_)) {
+        query.exec("PRAGMA journal_mode = WAL;");
+        if (!query.next() || query.value(0).toString().toLower() != "wal")
+          Log::write() << "DB::connect: WARNING unable to use the write-ahead "
+                          "log (" << dbFileName << ")." << endl;
+        query.finish();
+
+        setPragma(QString("journal_size_limit = %1").arg(WalSizeLimit));
+      }
+
+      if (readOnly) {
+        setPragma("query_only = true");
+      } else if(inFastMode) {
         query.exec("PRAGMA foreign_keys = false;");
         Q_ASSERT_X(query.isActive(), "DB::connect: setting PRAGMA :",
           query.lastError().text().toLatin1());
@@ -78,6 +126,15 @@ int DB::connect(const QString &fileName, bool inFastMode) {
           query.lastError().text().toLatin1());
       }
 
+      if (tempDbUsed_) {
+        query.prepare("ATTACH DATABASE ? AS Mirror;");
+        query.addBindValue(originalFileName_);
+        query.exec();
+        Q_ASSERT_X(query.isActive(), "DB::connect: attaching original file:",
+          query.lastError().text().toLatin1());
+
+        mirrorTimer_.start();
+      }
     } else
       error = 1;
   } else
@@ -87,22 +144,112 @@ int DB::connect(const QString &fileName, bool inFastMode) {
 }
 
 void DB::disconnect() {
+  if (recording_)
+    stopRecording();
+
   QString dbFileName;
-  if (tempDbUsed_ && isConnected())
+  if (tempDbUsed_ && isConnected()) {
+    if (!flushMirror())
+      Log::write() << "DB::disconnect: WARNING " << mirrorPending_.size() << 
+        " row changes not copied to " << originalFileName_ << endl;
+
     dbFileName = fileName();
+  }
+
+  clearCachedQueries();
 
   QString connectionName = db_.connectionName();
   db_ = QSqlDatabase();
+  readOnly_ = false;
   QSqlDatabase::removeDatabase(connectionName);
 
-  if (!dbFileName.isEmpty()) {
-    // Delete and move temp database
-    //QFile::remove(originalFileName_);
-    //QFile dbFile(dbFileName);
-    //dbFile.rename(originalFileName_);
+  if (!dbFileName.isEmpty())
+    closeScratch(originalFileName_, dbFileName);
+
+  tempDbUsed_ = false;
+  mirrorPending_.clear();
+}
+
+void DB::setScratchDir(const QString &dir) {
+  scratchDir_ = dir;
+}
+
+// The first connection to a file copies it into the scratch directory, and
+// the rest use the same copy
+QString DB::openScratch(const QString &fileName) {
+  QByteArray hash = QCryptographicHash::hash(fileName.toUtf8(),
+                                             QCryptographicHash::Md5);
+  QString scratchFileName = QDir(scratchDir_).filePath(
+    QFileInfo(fileName).completeBaseName() + '_' + hash.toHex().left(8) + 
+    ".sdb");
+
+  QMutexLocker locker(&scratchMutex_);
+  int &nUsers = nScratchUsers_[fileName];
+  if (nUsers == 0) {
+    Log::write() << "DB::connect: Using scratch file: " << scratchFileName <<
+      endl;
+    if (QFile::exists(scratchFileName)) {
+      Log::write() << "DB::connect: WARNING scratch file overwritten." << 
+        scratchFileName << endl;
+      QFile::remove(scratchFileName);
+    }
+    QFile::copy(fileName, scratchFileName);
+    QFile::setPermissions(scratchFileName, QFile::ReadOwner | 
+      QFile::WriteOwner | QFile::ReadGroup | QFile::WriteGroup);
+  }
+  ++nUsers;
+
+  return scratchFileName;
+}
+
+// The original file already has all the changes of the connections
+void DB::closeScratch(const QString &fileName, 
+                      const QString &scratchFileName) {
+  QMutexLocker locker(&scratchMutex_);
+  if (--nScratchUsers_[fileName] == 0) {
+    nScratchUsers_.remove(fileName);
+    QFile::remove(scratchFileName);
+  }
+}
+
+// The changes are copied with their ids in their own transaction, so inside
+// a transaction they are left for when it ends. Only the connections sharing
+// the scratch copy can write the original file meanwhile.
+bool DB::flushMirror() {
+  if (!tempDbUsed_ || mirrorPending_.isEmpty())
+    return true;
+  else if (nNestedTrans_ > 0)
+    return false;
+
+  QList<RowChange> changes = mirrorPending_;
+  int n = changes.size();
+  for (int i = 0; i < n; ++i)
+    changes[i].table.prepend("Mirror.");
+
+  flushingMirror_ = true;
+  bool ok = executeChanges(changes);
+  flushingMirror_ = false;
+
+  if (ok)
+    mirrorPending_.clear();
+  else
+    Log::write() << "DB::flushMirror: WARNING unable to copy " << n << 
+      " row changes to " << originalFileName_ << ". Retrying later." << endl;
+
+  mirrorTimer_.restart();
 
-    // Only delete temp database
-    QFile::remove(dbFileName);
+  return ok;
+}
+
+void DB::mirrorChange(RowChange::Type type, const QString &table, int id,
+                      const QHash<QString, QVariant> &values) const {
+  if (tempDbUsed_ && !flushingMirror_) {
+    RowChange change;
+    change.type = type;
+    change.table = table;
+    change.id = id;
+    change.values = values;
+    mirrorPending_.append(change);
   }
 }
 
@@ -110,6 +257,32 @@ bool DB::isConnected() {
   return db_.isOpen();
 }
 
+bool DB::setPragma(const QString &pragmaStr) {
+  QSqlQuery query(db_);
+  bool ok = query.exec("PRAGMA " + pragmaStr + ";");
+
+  Q_ASSERT_X(ok, ("DB::setPragma: " + pragmaStr).toLatin1(),
+             query.lastError().text().toLatin1());
+
+  return ok;
+}
+
+bool DB::setWalAutoCheckpoint(bool enabled) {
+  return setPragma(QString("wal_autocheckpoint = %1")
+                   .arg(enabled ? WalAutoCheckpointPages : 0));
+}
+
+// Passive, so it does not block the readers nor waits for them. It does 
+// nothing if the database does not use the log.
+bool DB::checkpointWal() {
+  QSqlQuery query(db_);
+  bool ok = query.exec("PRAGMA wal_checkpoint(PASSIVE);");
+
+  Q_ASSERT_X(ok, "DB::checkpointWal:", query.lastError().text().toLatin1());
+
+  return ok;
+}
+
 bool DB::createEmptyDB(const QString &fileName) {
   if (db_.isOpen())
     disconnect();
@@ -127,10 +300,17 @@ bool DB::createEmptyDB(const QString &fileName) {
   return ok;
 }
 
+// The row changes to copy to the original file made before the transaction
+// are counted, so a rollback discards only the ones made inside it.
 bool DB::beginTransaction() {
   bool ok;
 
-  if (nNestedTrans_ == 0) {
+  if (nNestedTrans_ == 0)
+    mirrorTransStart_ = mirrorPending_.size();
+
+  if (recording_)
+    ok = true;
+  else if (nNestedTrans_ == 0) {
     QSqlQuery query(db_);
     ok = query.exec("BEGIN TRANSACTION;");
 
@@ -148,19 +328,16 @@ bool DB::endTransaction() {
   bool ok = true;
   --nNestedTrans_;
 
-  if (nNestedTrans_ == 0) {
+  if (nNestedTrans_ == 0 && !recording_) {
     QSqlQuery query(db_);
     ok = query.exec("COMMIT;");
 
     Q_ASSERT_X(ok, "DB::endTransaction:",
                query.lastError().text().toLatin1());
 
-    if (tempDbUsed_) {
-      Log::write() << "DB::endTransaction: Copying tmp file database." << endl;
-      QFile::remove(originalFileName_);
-      QFile::copy(fileName(), originalFileName_);
-      Log::write() << "DB::endTransaction: Copying tmp file database. Done." << endl;
-    }
+    if (ok && tempDbUsed_ && !flushingMirror_ && 
+        mirrorTimer_.elapsed() >= MirrorPeriodMsecs)
+      flushMirror();
   }
 
   if (nNestedTrans_ < 0) {
@@ -173,13 +350,21 @@ bool DB::endTransaction() {
 
 bool DB::rollbackTransaction() {
   bool ok;
-  if (nNestedTrans_ > 0) {
+  if (recording_) { // The changes already recorded are kept
+    Log::write() << "DB::rollbackTransaction: WARNING: rollback while "
+      "recording." << endl;
+    nNestedTrans_ = 0;
+    ok = false;
+  } else if (nNestedTrans_ > 0) {
     QSqlQuery query(db_);
     ok = query.exec("ROLLBACK;");
 
     Q_ASSERT_X(ok, "DB::rollbackTransaction:",
                query.lastError().text().toLatin1());
 
+    while (mirrorPending_.size() > mirrorTransStart_)
+      mirrorPending_.removeLast();
+
     nNestedTrans_ = 0;
   } else if (nNestedTrans_ < 0) {
     nNestedTrans_ = 0;
@@ -212,7 +397,10 @@ QSqlQuery *DB::newQuery() const {
 QSqlQuery *DB::newQuery(const QString &sqlStr) const {
   QSqlQuery *query = new QSqlQuery(sqlStr, db_);
   query->setForwardOnly(true);
+  QElapsedTimer timer;
+  timer.start();
   query->exec();
+  logSlowQuery(sqlStr, QVariantList(), timer.elapsed());
 
   Q_ASSERT_X(query->isActive(), ("DB::newQuery: " + sqlStr).toLatin1(),
              query->lastError().text().toLatin1());
@@ -225,7 +413,10 @@ QSqlQuery *DB::newQuery(const QString &sqlStr, const QVariant &value) const {
   query->setForwardOnly(true);
   bool ok = query->prepare(sqlStr);
   query->addBindValue(value);
+  QElapsedTimer timer;
+  timer.start();
   ok &= query->exec();
+  logSlowQuery(sqlStr, QVariantList() << value, timer.elapsed());
 
   Q_ASSERT_X(ok, QString("DB::newQuery: %1 value=%2")
              .arg(sqlStr).arg(value.toString()).toLatin1(),
@@ -244,7 +435,10 @@ QSqlQuery *DB::newQuery(const QString &sqlStr,
   for (int i = 0; i<nValues; ++i)
     query->addBindValue(values.at(i));
 
+  QElapsedTimer timer;
+  timer.start();
   ok &= query->exec();
+  logSlowQuery(sqlStr, values, timer.elapsed());
 
   Q_ASSERT_X(ok, QString("DB::newQuery: %1 nValues=%2")
              .arg(sqlStr).arg(nValues).toLatin1(),
@@ -257,7 +451,10 @@ QSqlQuery *DB::newTableQuery(const QString &table) const {
   QString sqlStr = "SELECT * FROM " + table;
   QSqlQuery *query = new QSqlQuery(sqlStr, db_);
   query->setForwardOnly(true);
+  QElapsedTimer timer;
+  timer.start();
   query->exec();
+  logSlowQuery(sqlStr, QVariantList(), timer.elapsed());
 
   Q_ASSERT_X(query->isActive(), ("DB::newQuery: " + sqlStr).toLatin1(),
              query->lastError().text().toLatin1());
@@ -270,7 +467,10 @@ QSqlQuery *DB::newTableQuery(const QString &table, int id) const {
                    .arg(id);
   QSqlQuery *query = new QSqlQuery(sqlStr, db_);
   query->setForwardOnly(true);
+  QElapsedTimer timer;
+  timer.start();
   query->exec();
+  logSlowQuery(sqlStr, QVariantList(), timer.elapsed());
 
   Q_ASSERT_X(query->isActive(), ("DB::newQuery: " + sqlStr).toLatin1(),
              query->lastError().text().toLatin1());
@@ -285,7 +485,10 @@ QSqlQuery *DB::newTableQuery(const QString &table, const QString &refField,
 
   QSqlQuery *query = new QSqlQuery(sqlStr, db_);
   query->setForwardOnly(true);
+  QElapsedTimer timer;
+  timer.start();
   query->exec();
+  logSlowQuery(sqlStr, QVariantList(), timer.elapsed());
 
   Q_ASSERT_X(query->isActive(), ("DB::newQuery: " + sqlStr).toLatin1(),
              query->lastError().text().toLatin1());
@@ -300,7 +503,10 @@ QSqlQuery *DB::newTableQuery(const QString &table, const QString &refField,
 
   QSqlQuery *query = new QSqlQuery(sqlStr, db_);
   query->setForwardOnly(true);
+  QElapsedTimer timer;
+  timer.start();
   query->exec();
+  logSlowQuery(sqlStr, QVariantList(), timer.elapsed());
 
   Q_ASSERT_X(query->isActive(), ("DB::newQuery: " + sqlStr).toLatin1(),
              query->lastError().text().toLatin1());
@@ -498,19 +704,25 @@ int DB::getModelIdRow(QSqlQueryModel *model, int id) const {
 
 int DB::insertRow(const QString &table, const QHash<QString, QVariant> &values,
                   bool ignore) {
+  if (recording_) {
+    RowChange change;
+    change.type = ignore ? RowChange::InsertIgnore : RowChange::Insert;
+    change.table = table;
+    change.id = reserveIds(table, 1);
+    change.values = values;
+    change.values.insert("Id", change.id);
+    recorded_.append(change);
+
+    return change.id;
+  }
+
   bool ok;
-  QSqlQuery query(NULL, db_);
+  int id;
 
   if (!values.isEmpty()) {
-    QString columnsStr(" (");
-    QString valuesStr(" (");
-    for (QHash<QString, QVariant>::const_iterator i = values.constBegin();
-         i!=values.constEnd(); ++i) {
-      columnsStr.append(i.key() + ", ");
-      valuesStr.append("?, ");
-    }
-    columnsStr.replace(columnsStr.length()-2, 1, ')');
-    valuesStr.replace(valuesStr.length()-2, 1, ')');
+    QStringList columns = values.keys();
+    columns.sort();
+    int nColumns = columns.size();
 
     QString insertStr;
     if (ignore)
@@ -518,65 +730,365 @@ int DB::insertRow(const QString &table, const QHash<QString, QVariant> &values,
     else
       insertStr = "INSERT INTO ";
 
-    ok = query.prepare(insertStr + table + columnsStr + "VALUES" +
-                       valuesStr);
+    QString valuesStr("?");
+    for (int i = 1; i < nColumns; ++i)
+      valuesStr.append(", ?");
+
+    QSqlQuery *query = cachedQuery(insertStr + table + " (" + 
+      columns.join(", ") + ") VALUES (" + valuesStr + ")");
+
+    if (query) {
+      for (int i = 0; i < nColumns; ++i)
+        query->bindValue(i, values.value(columns.at(i)));
+
+      ok = query->exec();
+
+      Q_ASSERT_X(ok, QString("DB::insertRow: %1")
+                 .arg(table).toLatin1(), query->lastError().text().toLatin1());
+
+      id = query->lastInsertId().toInt();
+      query->finish();
+    } else {
+      ok = false;
+      id = 0;
+    }
+  } else {
+    QSqlQuery query(NULL, db_);
+    ok = query.exec("INSERT INTO " + table + " DEFAULT VALUES");
 
     Q_ASSERT_X(ok, QString("DB::insertRow: %1")
                .arg(table).toLatin1(), query.lastError().text().toLatin1());
 
-    for (QHash<QString, QVariant>::const_iterator i = values.constBegin();
-         i!=values.constEnd(); ++i)
-      query.addBindValue(i.value());
+    id = query.lastInsertId().toInt();
+  }
 
-    ok &= query.exec();
-  } else
-    ok = query.exec("INSERT INTO " + table + " DEFAULT VALUES");
+  if (ok && id > 0 && tempDbUsed_) { // Ignored rows have no id
+    QHash<QString, QVariant> mirrorValues = values;
+    mirrorValues.insert("Id", id);
+    mirrorChange(ignore ? RowChange::InsertIgnore : RowChange::Insert, table, 
+                 id, mirrorValues);
+  }
+
+  return ok ? id : 0;
+}
+
+QList<int> DB::insertRows(const QString &table,
+                          const QList<QHash<QString, QVariant> > &rows) {
+  QList<int> ids;
+  int n = rows.size();
+
+  if (recording_) {
+    for (int i = 0; i < n; ++i)
+      ids.append(insertRow(table, rows.at(i)));
+
+    return ids;
+  }
+
+  bool ok = beginTransaction();
+  int nextId = reserveIds(table, n);
+
+  QList<QHash<QString, QVariant> > rowsWithIds = rows;
+  QList<const QHash<QString, QVariant>*> rowPointers;
+  for (int i = 0; i < n; ++i) {
+    rowsWithIds[i].insert("Id", nextId);
+    rowPointers.append(&rowsWithIds.at(i));
+    ids.append(nextId++);
+  }
+
+  ok &= insertRowsWithIds(table, rowPointers);
+
+  if (ok)
+    ok = endTransaction();
+  else {
+    Log::write() << "DB::insertRows: error: " << lastError().text() << endl;
+    rollbackTransaction();
+    ids.clear();
+  }
 
-  Q_ASSERT_X(ok, QString("DB::insertRow: %1")
-             .arg(table).toLatin1(), query.lastError().text().toLatin1());
+  return ids;
+}
+
+// The consecutive rows with the same columns are inserted in chunks of a
+// power of two rows, so that only a few statements are prepared per table and
+// set of columns.
+bool DB::insertRowsWithIds(const QString &table, 
+    const QList<const QHash<QString, QVariant>*> &rows) {
+  bool ok = true;
+  int n = rows.size();
+  int i = 0;
+  while (ok && i < n) {
+    QStringList columns = rows.at(i)->keys();
+    columns.sort();
+    int nColumns = columns.size();
+
+    int nMaxRows = MaxRowsPerInsert;
+    while (nMaxRows > 1 && nMaxRows * nColumns > MaxBoundValues)
+      nMaxRows /= 2;
+
+    int nSameRows = 1;
+    bool same = true;
+    while (same && i + nSameRows < n) {
+      const QHash<QString, QVariant> *row = rows.at(i + nSameRows);
+      same = row->size() == nColumns;
+      for (int k = 0; same && k < nColumns; ++k)
+        same = row->contains(columns.at(k));
+
+      if (same)
+        ++nSameRows;
+    }
+
+    while (ok && nSameRows > 0) {
+      int nRows = nMaxRows;
+      while (nRows > nSameRows)
+        nRows /= 2;
+
+      if (nRows == 1)
+        ok &= insertRow(table, *rows.at(i)) > 0;
+      else {
+        QString rowStr = "(?" + QString(", ?").repeated(nColumns - 1) + ")";
+        QString valuesStr = rowStr;
+        for (int j = 1; j < nRows; ++j)
+          valuesStr += ", " + rowStr;
+
+        QSqlQuery *query = cachedQuery("INSERT INTO " + table + " (" + 
+          columns.join(", ") + ") VALUES " + valuesStr);
+
+        if (query) {
+          int iValue = 0;
+          for (int j = 0; j < nRows; ++j) {
+            const QHash<QString, QVariant> &row = *rows.at(i + j);
+            for (int k = 0; k < nColumns; ++k)
+              query->bindValue(iValue++, row.value(columns.at(k)));
+          }
+
+          ok = query->exec();
+
+          Q_ASSERT_X(ok, QString("DB::insertRowsWithIds: %1").arg(table)
+                     .toLatin1(), query->lastError().text().toLatin1());
+
+          query->finish();
+
+          for (int j = 0; ok && j < nRows; ++j)
+            mirrorChange(RowChange::Insert, table, 
+                         rows.at(i + j)->value("Id").toInt(), *rows.at(i + j));
+        } else
+          ok = false;
+      }
+
+      i += nRows;
+      nSameRows -= nRows;
+    }
+  }
+
+  return ok;
+}
+
+int DB::maxRowId(const QString &table) const {
+  QSqlQuery query(db_);
+  bool ok = query.exec(QString("SELECT MAX(Id) FROM %1").arg(table)) && 
+            query.next();
 
-  return query.lastInsertId().toInt();
+  Q_ASSERT_X(ok, ("DB::maxRowId: " + table).toLatin1(),
+             query.lastError().text().toLatin1());
+
+  return query.value(0).toInt();
 }
 
 bool DB::updateRow(const QString &table, int id,
                    const QHash<QString, QVariant> &values) const {
+  if (recording_) {
+    RowChange change;
+    change.type = RowChange::Update;
+    change.table = table;
+    change.id = id;
+    change.values = values;
+    recorded_.append(change);
+
+    return true;
+  }
+
   bool ok;
-  QSqlQuery query(NULL, db_);
 
   if (!values.isEmpty()) {
-    QString sql = "UPDATE " + table + " SET ";
-    for (QHash<QString, QVariant>::const_iterator i = values.constBegin();
-         i!=values.constEnd(); ++i)
-      sql += i.key() + "=?, ";
+    QStringList columns = values.keys();
+    columns.sort();
+    int nColumns = columns.size();
 
-    sql.remove(sql.length()-2, 2);
-    sql += QString(" WHERE Id=%1").arg(id);
+    QSqlQuery *query = cachedQuery("UPDATE " + table + " SET " + 
+      columns.join("=?, ") + "=? WHERE Id=?");
 
-    ok = query.prepare(sql);
+    if (query) {
+      for (int i = 0; i < nColumns; ++i)
+        query->bindValue(i, values.value(columns.at(i)));
+      query->bindValue(nColumns, id);
 
-    for (QHash<QString, QVariant>::const_iterator i = values.constBegin();
-         i!=values.constEnd(); ++i)
-      query.addBindValue(i.value());
+      ok = query->exec();
 
-    ok &= query.exec();
+      Q_ASSERT_X(ok, QString("DB::updateRow: %1")
+                 .arg(table).toLatin1(), query->lastError().text().toLatin1());
+
+      query->finish();
+
+      if (ok)
+        mirrorChange(RowChange::Update, table, id, values);
+    } else
+      ok = false;
   } else
     ok = true;
 
-  Q_ASSERT_X(ok, QString("DB::updateRow: %1")
-             .arg(table).toLatin1(), query.lastError().text().toLatin1());
-
   return ok;
 }
 
 bool DB::removeRow(const QString &table, int id) {
+  if (recording_) {
+    RowChange change;
+    change.type = RowChange::Remove;
+    change.table = table;
+    change.id = id;
+    recorded_.append(change);
+
+    return true;
+  }
+
   bool ok;
-  QString sql = QString("DELETE FROM %1 WHERE Id=%2").arg(table).arg(id);
-  QSqlQuery query(sql, db_);
+  QSqlQuery *query = cachedQuery("DELETE FROM " + table + " WHERE Id=?");
 
-  ok = query.exec();
+  if (query) {
+    query->bindValue(0, id);
+    ok = query->exec();
+
+    Q_ASSERT_X(ok, QString("DB::removeRow: %1")
+               .arg(table).toLatin1(), query->lastError().text().toLatin1());
+
+    query->finish();
+
+    if (ok)
+      mirrorChange(RowChange::Remove, table, id, QHash<QString, QVariant>());
+  } else
+    ok = false;
+
+  return ok;
+}
+
+// The statement stays prepared in the connection, so only its values have to
+// be bound again
+QSqlQuery *DB::cachedQuery(const QString &sqlStr) const {
+  QSqlQuery *query = queries_.value(sqlStr);
+
+  if (!query) {
+    query = new QSqlQuery(NULL, db_);
+    bool ok = query->prepare(sqlStr);
+
+    Q_ASSERT_X(ok, ("DB::cachedQuery: " + sqlStr).toLatin1(),
+               query->lastError().text().toLatin1());
+
+    if (ok)
+      queries_.insert(sqlStr, query);
+    else {
+      delete query;
+      query = NULL;
+    }
+  }
+
+  return query;
+}
+
+void DB::clearCachedQueries() {
+  qDeleteAll(queries_);
+  queries_.clear();
+}
+
+void DB::startRecording() {
+  Q_ASSERT(nNestedTrans_ == 0 && !recording_);
+  recording_ = true;
+
+  QMutexLocker locker(&idsMutex_);
+  ++nRecordingUsers_[fileName()];
+}
+
+QList<DB::RowChange> DB::takeRecorded() {
+  QList<RowChange> changes = recorded_;
+  recorded_.clear();
+
+  return changes;
+}
+
+// The changes not taken are discarded. The ids are read again from the 
+// database when the file is recorded again, once the changes are written.
+void DB::stopRecording() {
+  if (!recording_)
+    return;
+
+  recording_ = false;
+  recorded_.clear();
+
+  QMutexLocker locker(&idsMutex_);
+  QString dbFileName = fileName();
+  if (--nRecordingUsers_[dbFileName] == 0) {
+    nRecordingUsers_.remove(dbFileName);
+    nextIds_.remove(dbFileName);
+  }
+}
+
+// Returns the first of n consecutive new ids. While any connection records 
+// the file, the ids are read from the database only once per table, since 
+// the recorded rows may not be written yet, and then taken from the ids 
+// shared by the connections.
+int DB::reserveIds(const QString &table, int n) {
+  QMutexLocker locker(&idsMutex_);
+  QString dbFileName = fileName();
+  if (!nRecordingUsers_.contains(dbFileName))
+    return maxRowId(table) + 1;
+
+  QHash<QString, int> &nextIds = nextIds_[dbFileName];
+  QHash<QString, int>::iterator i = nextIds.find(table);
+  if (i == nextIds.end())
+    i = nextIds.insert(table, maxRowId(table) + 1);
+
+  int id = *i;
+  *i += n;
+
+  return id;
+}
+
+// The consecutive inserts in the same table, which already carry their ids,
+// are written together with multi-row statements
+bool DB::executeChanges(const QList<RowChange> &changes) {
+  bool ok = beginTransaction();
+
+  int n = changes.size();
+  for (int i = 0; i < n; ++i) {
+    const RowChange &change = changes.at(i);
+    switch (change.type) {
+      case RowChange::Insert: {
+        QList<const QHash<QString, QVariant>*> rows;
+        rows.append(&change.values);
+        while (i + 1 < n && changes.at(i + 1).type == RowChange::Insert &&
+               changes.at(i + 1).table == change.table)
+          rows.append(&changes.at(++i).values);
+
+        ok &= insertRowsWithIds(change.table, rows);
+        break;
+      }
+      case RowChange::InsertIgnore:
+        insertRow(change.table, change.values, true);
+        break;
+      case RowChange::Update:
+        ok &= updateRow(change.table, change.id, change.values);
+        break;
+      case RowChange::Remove:
+        ok &= removeRow(change.table, change.id);
+        break;
+    }
+  }
 
-  Q_ASSERT_X(ok, QString("DB::removeRow: %1")
-             .arg(table).toLatin1(), query.lastError().text().toLatin1());
+  if (ok)
+    ok = endTransaction();
+  else {
+    Log::write() << "DB::executeChanges: error: " << lastError().text() << 
+      endl;
+    rollbackTransaction();
+  }
 
   return ok;
 }
@@ -659,6 +1171,58 @@ int DB::existId(const QString &table, const QString &field,
   return id;
 }
 
+bool DB::existColumn(const QString &table, const QString &field) const {
+  QSqlQuery query(NULL, db_);
+  bool ok = query.exec(QString("PRAGMA table_info(%1)").arg(table));
+
+  Q_ASSERT_X(ok, QString("DB::existColumn table=%1 field=%2")
+             .arg(table).arg(field).toLatin1(),
+             query.lastError().text().toLatin1());
+
+  bool found = false;
+  while (!found && query.next())
+    found = query.value(1).toString().compare(field, Qt::CaseInsensitive) == 0;
+
+  return found;
+}
+
+// In debug builds, the plan of the queries slower than SlowQueryMsecs is
+// logged, to find the access paths without index
+void DB::logSlowQuery(const QString &sqlStr, const QVariantList &values,
+                      qint64 msecs) const {
+#ifdef QT_DEBUG
+  if (msecs >= SlowQueryMsecs) {
+    Log::write() << "DB: slow query (" << msecs << " ms): " << sqlStr << 
+      endl;
+
+    QSqlQuery query(NULL, db_);
+    bool ok = query.prepare("EXPLAIN QUERY PLAN " + sqlStr);
+    int nValues = values.size();
+    for (int i = 0; i < nValues; ++i)
+      query.addBindValue(values.at(i));
+
+    if (ok && query.exec()) {
+      while (query.next())
+        Log::write() << "DB:   " << query.value(3).toString() << endl;
+    }
+  }
+#else
+  Q_UNUSED(sqlStr);
+  Q_UNUSED(values);
+  Q_UNUSED(msecs);
+#endif
+}
+
+bool DB::execute(const QString &sqlStr) const {
+  QSqlQuery query(NULL, db_);
+  bool ok = query.exec(sqlStr);
+
+  Q_ASSERT_X(ok, ("DB::execute: " + sqlStr).toLatin1(),
+             query.lastError().text().toLatin1());
+
+  return ok;
+}
+
 int DB::getNumRows(const QString &table) const {
   QSqlQuery query(QString("SELECT COUNT(*) FROM %1").arg(table), db_);
   query.exec();
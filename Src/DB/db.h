@@ -10,17 +10,50 @@
 #include <QSqlQueryModel>
 #include <QSqlDatabase>
 #include <QSqlError>
+#include <QElapsedTimer>
+#include <QMutex>
 
 namespace LoboLab {
 
 class DB {
  public:
+  struct RowChange {
+    enum Type {Insert, InsertIgnore, Update, Remove};
+    Type type;
+    QString table;
+    int id;
+    QHash<QString, QVariant> values;
+  };
+
   DB();
   virtual ~DB();
 
+  // The connections that can write use write-ahead logging when the file is
+  // local, so read-only connections can read the file while it is written.
+  // They see the last committed state when each of their queries start.
   int connect(const QString &fileName, bool inFastMode = false);
+  int connectReadOnly(const QString &fileName);
   void disconnect();
   bool isConnected();
+  inline bool isReadOnly() const { return readOnly_; }
+
+  // Disabling the automatic checkpoints of the log leaves them to 
+  // checkpointWal(), which copies the log into the database file as far as the
+  // readers allow it, without waiting for them
+  bool setWalAutoCheckpoint(bool enabled);
+  bool checkpointWal();
+
+  // With a scratch directory, the connections that can write work on a local
+  // copy of the database file, shared by the connections of the process to 
+  // the same file. Their row changes are copied to the original file after a
+  // commit, at most every MirrorPeriodMsecs, and when flushMirror() is called
+  // or the connection is closed. The changes not copied are kept if copying
+  // fails, and copied in the next attempt. Only the row changes made with 
+  // insertRow(), insertRows(), updateRow(), removeRow() and executeChanges()
+  // are copied, so the schema must not be changed while using a scratch copy,
+  // nor the original file written by other processes.
+  static void setScratchDir(const QString &dir);
+  bool flushMirror();
   bool createEmptyDB(const QString &fileName);
   bool vacuum();
 
@@ -76,15 +109,35 @@ class DB {
              const QVariant &content) const;
   int existId(const QString &table, const QString &field,
               const QVariant &content) const;
+  bool existColumn(const QString &table, const QString &field) const;
+
+  bool execute(const QString &sqlStr) const;
 
 
   int getNumRows(const QString &table) const;
+  int maxRowId(const QString &table) const;
   int insertRow(const QString &table, const QHash<QString, QVariant> &values,
                 bool ignore = false);
+  // Inserts the rows with multi-row statements in one transaction, and 
+  // returns their ids, assigned consecutively as in recording mode
+  QList<int> insertRows(const QString &table, 
+                        const QList<QHash<QString, QVariant> > &rows);
   bool updateRow(const QString &table, int id,
                  const QHash<QString, QVariant> &values) const;
   bool removeRow(const QString &table, int id);
 
+  // In recording mode the row changes are not executed but recorded, and the
+  // new rows get consecutive ids after the largest id of each table. The ids
+  // are shared by all the connections of the process recording the same 
+  // file, so they never repeat. The recorded changes can be executed later by
+  // other connections to the same file, which must not insert rows with 
+  // other ids meanwhile.
+  void startRecording();
+  QList<RowChange> takeRecorded();
+  void stopRecording();
+  inline bool isRecording() const { return recording_; }
+  bool executeChanges(const QList<RowChange> &changes);
+
   void emptyTables(const QList<QString> &tables) const;
   void emptyTablesNoKeys(const QList<QString> &tables) const;
 
@@ -97,14 +150,58 @@ class DB {
  private:
   Q_DISABLE_COPY(DB);
 
+  int openConnection(const QString &fileName, bool inFastMode, bool readOnly);
+  bool setPragma(const QString &pragmaStr);
+  void mirrorChange(RowChange::Type type, const QString &table, int id,
+                    const QHash<QString, QVariant> &values) const;
+  static QString openScratch(const QString &fileName);
+  static void closeScratch(const QString &fileName, 
+                           const QString &scratchFileName);
   int openImportDB(const QString &fileName, QSqlDatabase *db);
+  void logSlowQuery(const QString &sqlStr, const QVariantList &values,
+                    qint64 msecs) const;
   void fetchAllData(QSqlQueryModel *model) const;
+  int reserveIds(const QString &table, int n);
+  QSqlQuery *cachedQuery(const QString &sqlStr) const;
+  void clearCachedQueries();
+  bool insertRowsWithIds(const QString &table,
+                         const QList<const QHash<QString, QVariant>*> &rows);
+
+  static const int MaxRowsPerInsert;
+  static const int MaxBoundValues;
+  static const int BusyTimeoutMsecs;
+  static const int WalAutoCheckpointPages;
+  static const int WalSizeLimit;
+  static const int MirrorPeriodMsecs;
+  static const int SlowQueryMsecs;
 
   QSqlDatabase db_;
   int nNestedTrans_;
+  bool readOnly_;
+
+  // Prepared statements of insertRow(), updateRow() and removeRow(), by SQL.
+  // The columns are sorted, so the SQL only depends on the table and the set
+  // of columns.
+  mutable QHash<QString, QSqlQuery*> queries_;
+
+  bool recording_;
+  mutable QList<RowChange> recorded_; // updateRow() is const
 
   bool tempDbUsed_;
   QString originalFileName_;
+  mutable QList<RowChange> mirrorPending_; // updateRow() is const
+  int mirrorTransStart_; // Size of mirrorPending_ when the transaction began
+  bool flushingMirror_;
+  QElapsedTimer mirrorTimer_;
+
+  static QString scratchDir_;
+  static QHash<QString, int> nScratchUsers_; // By original file name
+  static QMutex scratchMutex_;
+
+  // Next id of each table, by file name, while any connection records
+  static QHash<QString, QHash<QString, int> > nextIds_;
+  static QHash<QString, int> nRecordingUsers_;
+  static QMutex idsMutex_;
 };
 
 } // namespace LoboLab
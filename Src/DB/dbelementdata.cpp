@@ -105,10 +105,11 @@ void DBElementData::loadReferencesIndirect(const QString &refName1,
   if (queryReferences_)
     delete queryReferences_;
 
-  QString sql = QString("SELECT DISTINCT %1.* FROM %1 "
-                        "INNER JOIN %2 ON %2.%1 = %1.Id "
+  // The subquery avoids comparing whole rows to remove the duplicates
+  QString sql = QString("SELECT %1.* FROM %1 WHERE %1.Id IN ("
+                        "SELECT %2.%1 FROM %2 "
                         "INNER JOIN %3 ON %3.Id = %2.%3 "
-                        "WHERE %3.%4 = %5;").arg(refName1).arg(refName2).
+                        "WHERE %3.%4 = %5);").arg(refName1).arg(refName2).
                         arg(refName3).arg(elementName_).arg(id_);
 
   queryReferences_ = db_->newQuery(sql);
@@ -119,16 +120,45 @@ void DBElementData::loadReferencesIndirect(const QString &refName1,
   if (queryReferences_)
     delete queryReferences_;
 
-  QString sql = QString("SELECT DISTINCT %1.* FROM %1 "
-                        "INNER JOIN %2 ON %2.%1 = %1.Id "
+  QString sql = QString("SELECT %1.* FROM %1 WHERE %1.Id IN ("
+                        "SELECT %2.%1 FROM %2 "
                         "INNER JOIN %3 ON %3.Id = %2.%3 "
                         "INNER JOIN %4 ON %4.Id = %3.%4 "
-                        "WHERE %4.%5 = %6;").arg(refName1).arg(refName2).
+                        "WHERE %4.%5 = %6);").arg(refName1).arg(refName2).
                         arg(refName3).arg(refName4).arg(elementName_).arg(id_);
 
   queryReferences_ = db_->newQuery(sql);
 }
 
+void DBElementData::loadNestedReferences(const QString &refName1,
+                                         const QString &refName2) {
+  if (queryReferences_)
+    delete queryReferences_;
+
+  QString sql = QString("SELECT %1.* FROM %1 "
+                        "INNER JOIN %2 ON %2.Id = %1.%2 "
+                        "WHERE %2.%3 = %4 ORDER BY %1.%2, %1.Id;")
+                        .arg(refName1).arg(refName2).arg(elementName_)
+                        .arg(id_);
+
+  queryReferences_ = db_->newQuery(sql);
+}
+
+void DBElementData::loadNestedReferences(const QString &refName1,
+    const QString &refName2, const QString &refName3) {
+  if (queryReferences_)
+    delete queryReferences_;
+
+  QString sql = QString("SELECT %1.* FROM %1 "
+                        "INNER JOIN %2 ON %2.Id = %1.%2 "
+                        "INNER JOIN %3 ON %3.Id = %2.%3 "
+                        "WHERE %3.%4 = %5 ORDER BY %1.%2, %1.Id;")
+                        .arg(refName1).arg(refName2).arg(refName3)
+                        .arg(elementName_).arg(id_);
+
+  queryReferences_ = db_->newQuery(sql);
+}
+
 bool DBElementData::nextReference() {
   if (queryReferences_)
     return queryReferences_->next();
@@ -198,6 +228,29 @@ int DBElementData::submit(DB *dbin, const QPair<QString, DBElement*> &refMember,
   return id_;
 }
 
+bool DBElementData::submitNew(DB *db, const QList<DBElementData*> &elements,
+    const QList<QHash<QString, QVariant> > &values) {
+  Q_ASSERT(elements.size() == values.size());
+
+  int n = elements.size();
+  if (n == 0)
+    return true;
+
+  QList<int> ids = db->insertRows(elements.first()->elementName_, values);
+  bool ok = ids.size() == n;
+
+  if (ok) {
+    for (int i = 0; i < n; ++i) {
+      DBElementData *ed = elements.at(i);
+      Q_ASSERT(ed->id_ == 0 || ed->db_ != db);
+      ed->db_ = db;
+      ed->id_ = ids.at(i);
+    }
+  }
+
+  return ok;
+}
+
 bool DBElementData::submit(const QHash<QString, QVariant> &values) {
   bool ok;
 
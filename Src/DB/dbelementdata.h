@@ -37,6 +37,11 @@ class DBElementData {
                               const QString &refName3);
   void loadReferencesIndirect(const QString &refName1, const QString &refName2, 
                               const QString &refName3, const QString &refName4);
+  // The references of the references, sorted by the reference they refer to,
+  // so the references of all of them are read with one query
+  void loadNestedReferences(const QString &refName1, const QString &refName2);
+  void loadNestedReferences(const QString &refName1, const QString &refName2,
+                            const QString &refName3);
   bool nextReference();
   QVariant loadRefValue(int index);
   void loadExtElement(const QString &elementName, int id);
@@ -45,6 +50,11 @@ class DBElementData {
 
   int submit(DB *db, const QHash<QString, QVariant> &values);
 
+  // Inserts new elements of the same table in one batch, with their values,
+  // and assigns them their ids
+  static bool submitNew(DB *db, const QList<DBElementData*> &elements,
+                        const QList<QHash<QString, QVariant> > &values);
+
   int submit(DB *db, const QHash<QString, DBElement*> &members,
              const QHash<QString, QVariant> &values = (QHash<QString, QVariant>()));
 
@@ -0,0 +1,234 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "dbpagedmodel.h"
+#include "db.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+namespace LoboLab {
+
+const int DBPagedModel::PageSize = 256;
+const int DBPagedModel::MaxCachedPages = 64;
+
+DBPagedModel::DBPagedModel(const DB *db, const QString &sqlStr,
+                           int keyColumn, QObject *parent)
+  : QAbstractTableModel(parent), db_(db),
+    sqlStr_("SELECT * FROM (" + sqlStr + ") AS PagedRows"),
+    keyColumn_(keyColumn), sortColumn_(-1),
+    sortOrder_(Qt::AscendingOrder), nRows_(0), pages_(MaxCachedPages) {
+  // With the QVariantList overload, since the one without values executes
+  // the query twice
+  QSqlQuery *query = db_->newQuery(sqlStr_ + " LIMIT 0", QVariantList());
+  QSqlRecord record = query->record();
+  int n = record.count();
+  for (int i = 0; i < n; ++i)
+    columns_.append(record.fieldName(i));
+  delete query;
+
+  query = db_->newQuery("SELECT COUNT(*) FROM (" + sqlStr_ + ")",
+                        QVariantList());
+  if (query->next())
+    nRows_ = query->value(0).toInt();
+  delete query;
+
+  Q_ASSERT(keyColumn_ >= 0 && keyColumn_ < columns_.size());
+}
+
+DBPagedModel::~DBPagedModel() {
+}
+
+int DBPagedModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : nRows_;
+}
+
+int DBPagedModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : columns_.size();
+}
+
+QVariant DBPagedModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+    return QVariant();
+
+  const Page *p = page(index.row() / PageSize);
+  int iRow = index.row() % PageSize;
+  if (p && iRow < p->size())
+    return p->at(iRow).at(index.column());
+  else
+    return QVariant();
+}
+
+QVariant DBPagedModel::headerData(int section, Qt::Orientation orientation,
+                                  int role) const {
+  if (orientation == Qt::Horizontal && role == Qt::DisplayRole &&
+      section < columns_.size())
+    return columns_.at(section);
+  else
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+// The rows are read again in the new order when shown
+void DBPagedModel::sort(int column, Qt::SortOrder order) {
+  beginResetModel();
+  sortColumn_ = column;
+  sortOrder_ = order;
+  pages_.clear();
+  pageStarts_.clear();
+  endResetModel();
+}
+
+void DBPagedModel::setTieColumns(const QList<int> &columns) {
+  beginResetModel();
+  tieColumns_ = columns;
+  pages_.clear();
+  pageStarts_.clear();
+  endResetModel();
+}
+
+// The page is read after the last row of the page before. The last row of
+// the page read is the start of the next one.
+const DBPagedModel::Page *DBPagedModel::page(int iPage) const {
+  Page *p = pages_.object(iPage);
+  if (p)
+    return p;
+
+  QList<int> order = orderColumns();
+  QString sqlStr = "SELECT *, " + orderExprsStr(order) + " FROM (" + 
+    sqlStr_ + ")";
+  QVariantList values;
+  if (iPage > 0) {
+    PageKey start;
+    if (!readPageStart(iPage, &start))
+      return NULL;
+
+    sqlStr += " WHERE " + afterStartStr(order, start, &values);
+  }
+  sqlStr += orderStr(order) + QString(" LIMIT %1").arg(PageSize);
+
+  QSqlQuery *query = db_->newQuery(sqlStr, values);
+  int nColumns = columns_.size();
+  int nOrder = order.size();
+  p = new Page();
+  p->reserve(PageSize);
+  while (query->next()) {
+    QVector<QVariant> row(nColumns);
+    for (int i = 0; i < nColumns; ++i)
+      row[i] = query->value(i);
+    p->append(row);
+
+    if (p->size() == PageSize) {
+      PageKey end(nOrder);
+      for (int i = 0; i < nOrder; ++i)
+        end[i] = query->value(nColumns + i);
+      pageStarts_.insert(iPage + 1, end);
+    }
+  }
+  delete query;
+
+  pages_.insert(iPage, p);
+
+  return p;
+}
+
+// The start of a page not reached yet is the row before it, read with an
+// offset. Only the order values are selected, so it is a fast read even far
+// from the first row.
+bool DBPagedModel::readPageStart(int iPage, PageKey *start) const {
+  QHash<int, PageKey>::const_iterator i = pageStarts_.constFind(iPage);
+  if (i != pageStarts_.constEnd()) {
+    *start = i.value();
+    return true;
+  }
+
+  QList<int> order = orderColumns();
+  QSqlQuery *query = db_->newQuery("SELECT " + orderExprsStr(order) + 
+    " FROM (" + sqlStr_ + ")" + orderStr(order) + " LIMIT 1 OFFSET ?",
+    QVariantList() << iPage * PageSize - 1);
+
+  bool ok = query->next();
+  if (ok) {
+    int n = order.size();
+    start->resize(n);
+    for (int i = 0; i < n; ++i)
+      (*start)[i] = query->value(i);
+    pageStarts_.insert(iPage, *start);
+  }
+  delete query;
+
+  return ok;
+}
+
+// The sort column, then the tie columns, and last the key column, which 
+// breaks all the ties
+QList<int> DBPagedModel::orderColumns() const {
+  int sortColumn = sortColumn_ >= 0 && sortColumn_ < columns_.size() ?
+                   sortColumn_ : keyColumn_;
+
+  QList<int> order;
+  order.append(sortColumn);
+  if (sortColumn != keyColumn_) {
+    int n = tieColumns_.size();
+    for (int i = 0; i < n; ++i) {
+      int column = tieColumns_.at(i);
+      if (column != sortColumn && column != keyColumn_ && 
+          column >= 0 && column < columns_.size())
+        order.append(column);
+    }
+    order.append(keyColumn_);
+  }
+
+  return order;
+}
+
+// Null values are replaced by the lowest number, since they do not compare
+QString DBPagedModel::orderExpr(int column) const {
+  return "IFNULL(\"" + columns_.at(column) + "\", -1e308)";
+}
+
+QString DBPagedModel::orderExprsStr(const QList<int> &columns) const {
+  QStringList exprs;
+  int n = columns.size();
+  for (int i = 0; i < n; ++i)
+    exprs.append(orderExpr(columns.at(i)));
+
+  return exprs.join(", ");
+}
+
+QString DBPagedModel::orderStr(const QList<int> &columns) const {
+  QStringList exprs;
+  int n = columns.size();
+  for (int i = 0; i < n; ++i)
+    exprs.append(orderExpr(columns.at(i)) + 
+                 (isDescending(i, n) ? " DESC" : " ASC"));
+
+  return " ORDER BY " + exprs.join(", ");
+}
+
+// The rows after the start are after it in one of the order columns, and 
+// equal to it in the columns before that one
+QString DBPagedModel::afterStartStr(const QList<int> &columns,
+                                    const PageKey &start,
+                                    QVariantList *values) const {
+  QStringList conds;
+  int n = columns.size();
+  for (int i = 0; i < n; ++i) {
+    QString cond;
+    for (int j = 0; j < i; ++j) {
+      cond += orderExpr(columns.at(j)) + " = ? AND ";
+      *values << start.at(j);
+    }
+    cond += orderExpr(columns.at(i)) + (isDescending(i, n) ? " < ?" : " > ?");
+    *values << start.at(i);
+    conds.append('(' + cond + ')');
+  }
+
+  return '(' + conds.join(" OR ") + ')';
+}
+
+// The tie columns are always ascending
+bool DBPagedModel::isDescending(int i, int nColumns) const {
+  return sortOrder_ == Qt::DescendingOrder && (i == 0 || i == nColumns - 1);
+}
+
+}
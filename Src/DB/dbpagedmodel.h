@@ -0,0 +1,76 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QStringList>
+#include <QVector>
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QVariant>
+
+namespace LoboLab {
+
+class DB;
+
+// Read-only model of the rows of a query, read in pages as they are shown.
+// The pages are read by keyset pagination: sorted by the sort column, the tie
+// columns and a key column with unique values, each page starts after the 
+// last row of the page before, so it is read without skipping the rows before
+// it. The start of a page not reached yet is read with an offset, selecting
+// only the values of the order columns. At most MaxCachedPages pages are kept
+// in memory. The sort and tie columns should be numeric; null values are 
+// sorted first.
+class DBPagedModel : public QAbstractTableModel {
+ public:
+  DBPagedModel(const DB *db, const QString &sqlStr, int keyColumn,
+               QObject *parent = NULL);
+  virtual ~DBPagedModel();
+
+  virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+  virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+  virtual QVariant data(const QModelIndex &index,
+                        int role = Qt::DisplayRole) const;
+  virtual QVariant headerData(int section, Qt::Orientation orientation,
+                              int role = Qt::DisplayRole) const;
+  virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+  // Order the rows with the same sort value, always ascending, before the key
+  void setTieColumns(const QList<int> &columns);
+
+ private:
+  typedef QVector<QVector<QVariant> > Page;
+  typedef QVector<QVariant> PageKey; // Values of the order columns
+
+  Q_DISABLE_COPY(DBPagedModel);
+
+  const Page *page(int iPage) const;
+  bool readPageStart(int iPage, PageKey *start) const;
+  QList<int> orderColumns() const;
+  QString orderExpr(int column) const;
+  QString orderExprsStr(const QList<int> &columns) const;
+  QString orderStr(const QList<int> &columns) const;
+  QString afterStartStr(const QList<int> &columns, const PageKey &start,
+                        QVariantList *values) const;
+  bool isDescending(int i, int nColumns) const;
+
+  static const int PageSize;
+  static const int MaxCachedPages;
+
+  const DB *db_;
+  QString sqlStr_;
+  QStringList columns_;
+  int keyColumn_;
+  QList<int> tieColumns_;
+  int sortColumn_;
+  Qt::SortOrder sortOrder_;
+  int nRows_;
+
+  mutable QCache<int, Page> pages_;
+  // Order values of the last row of the page before, by page. Only pages
+  // read or reached are stored.
+  mutable QHash<int, PageKey> pageStarts_;
+};
+
+} // namespace LoboLab
@@ -2,11 +2,30 @@
 // All rights reserved.
 
 #include "dbsea.h"
+#include "db.h"
 
+#include <QStringList>
 #include <QDebug>
 
 namespace LoboLab {
 
+// The reference fields looked up by DBElementData when loading the elements,
+// and the columns read by the viewer, so the indexes cover its plots
+const DBSea::Index DBSea::Indexes[] = {
+  {"SearchExperiment", "Search"},
+  {"Deme", "Search"},
+  {"Generation", "Deme, Time, MinError, BestComp"},
+  {"Generation", "Ind, MinError"},
+  {"GenerationIndividual", "Generation, Individual"},
+  {"GenerationIndividual", "Individual, Generation"},
+  {"Individual", "Error, Complexity, SimTime"},
+  {"IndividualExperimentError", "Individual"},
+  {"Phenotype", "Experiment, Time"},
+  {"CrossValidation", "Search"},
+  {"CrossValidationScore", "CrossValidation"},
+  {NULL, NULL}
+};
+
 DBSea::DBSea() {
 }
 
@@ -35,4 +54,114 @@ bool DBSea::buildDB(DB *db) {
   //return ok;
 }
 
-}
\ No newline at end of file
+bool DBSea::upgradeDB(DB *db) {
+  bool ok = db->beginTransaction();
+  ok &= createCrossValidationTables(db);
+  ok &= createExperimentErrorTable(db);
+  ok &= addGenerationTimeouts(db);
+  ok &= addIndividualModelBin(db);
+  ok &= addIndividualTimedOut(db);
+  ok &= createIndexes(db);
+
+  if (ok)
+    ok &= db->endTransaction();
+  else
+    db->rollbackTransaction();
+
+  return ok;
+}
+
+bool DBSea::createCrossValidationTables(DB *db) {
+  bool ok = true;
+
+  if (!db->exist("CrossValidation"))
+    ok &= db->execute("CREATE TABLE CrossValidation ("
+      "Id INTEGER PRIMARY KEY AUTOINCREMENT, "
+      "Search INTEGER REFERENCES Search(Id) ON DELETE CASCADE, "
+      "NumFolds INTEGER, "
+      "RandSeed INTEGER, "
+      "Datetime TEXT)");
+
+  if (!db->exist("CrossValidationScore"))
+    ok &= db->execute("CREATE TABLE CrossValidationScore ("
+      "Id INTEGER PRIMARY KEY AUTOINCREMENT, "
+      "CrossValidation INTEGER REFERENCES CrossValidation(Id) "
+      "ON DELETE CASCADE, "
+      "Individual INTEGER REFERENCES Individual(Id) ON DELETE CASCADE, "
+      "Fold INTEGER, "
+      "TrainError REAL, "
+      "TestError REAL)");
+
+  return ok;
+}
+
+bool DBSea::createExperimentErrorTable(DB *db) {
+  bool ok = true;
+
+  if (!db->exist("IndividualExperimentError"))
+    ok &= db->execute("CREATE TABLE IndividualExperimentError ("
+      "Id INTEGER PRIMARY KEY AUTOINCREMENT, "
+      "Individual INTEGER REFERENCES Individual(Id) ON DELETE CASCADE, "
+      "Experiment INTEGER REFERENCES Experiment(Id) ON DELETE CASCADE, "
+      "Checksum TEXT, "
+      "Error REAL)");
+
+  return ok;
+}
+
+bool DBSea::addGenerationTimeouts(DB *db) {
+  bool ok = true;
+
+  if (!db->existColumn("Generation", "NTimeouts"))
+    ok &= db->execute("ALTER TABLE Generation "
+      "ADD COLUMN NTimeouts INTEGER DEFAULT 0");
+
+  return ok;
+}
+
+bool DBSea::addIndividualModelBin(DB *db) {
+  bool ok = true;
+
+  if (!db->existColumn("Individual", "ModelBin"))
+    ok &= db->execute("ALTER TABLE Individual "
+      "ADD COLUMN ModelBin BLOB");
+
+  return ok;
+}
+
+bool DBSea::addIndividualTimedOut(DB *db) {
+  bool ok = true;
+
+  if (!db->existColumn("Individual", "TimedOut"))
+    ok &= db->execute("ALTER TABLE Individual "
+      "ADD COLUMN TimedOut INTEGER DEFAULT 0");
+
+  return ok;
+}
+
+bool DBSea::createIndexes(DB *db) {
+  bool ok = db->beginTransaction();
+
+  for (int i = 0; Indexes[i].table; ++i) {
+    QString table = Indexes[i].table;
+    QStringList columns = QString(Indexes[i].columns).split(", ");
+
+    bool exist = db->exist(table);
+    int nColumns = columns.size();
+    for (int j = 0; exist && j < nColumns; ++j)
+      exist = db->existColumn(table, columns.at(j));
+
+    if (exist)
+      ok &= db->execute(QString("CREATE INDEX IF NOT EXISTS Idx%1_%2 "
+        "ON %1 (%3)").arg(table).arg(columns.join("")).arg(Indexes[i].columns));
+  }
+
+  if (ok)
+    ok &= db->endTransaction();
+  else
+    db->rollbackTransaction();
+
+  return ok;
+}
+
+}
@@ -11,10 +11,31 @@ class DBSea {
  public:
   static bool buildDB(DB *db);
 
+  // Creates the tables and columns added after the original schema, if they
+  // are missing. Safe to call on every connection.
+  static bool upgradeDB(DB *db);
+
+  // Creates the indexes of the access paths of the queries, if they are 
+  // missing and their table and columns exist. Safe to call on every
+  // connection.
+  static bool createIndexes(DB *db);
+
  private:
+  struct Index {
+    const char *table;
+    const char *columns;
+  };
+
   DBSea();
   virtual ~DBSea();
 
+  static bool createCrossValidationTables(DB *db);
+  static bool createExperimentErrorTable(DB *db);
+  static bool addGenerationTimeouts(DB *db);
+  static bool addIndividualModelBin(DB *db);
+  static bool addIndividualTimedOut(DB *db);
+
+  static const Index Indexes[];
 };
 
 } // namespace LoboLab
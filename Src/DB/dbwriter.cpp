@@ -0,0 +1,101 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "dbwriter.h"
+#include "Common/log.h"
+
+namespace LoboLab {
+
+const int DBWriter::MaxWriteAttempts = 5;
+const int DBWriter::RetryWaitMsecs = 1000;
+
+DBWriter::DBWriter(const QString &fileName, bool inFastMode, int maxPending)
+  : fileName_(fileName),
+    inFastMode_(inFastMode),
+    maxPending_(maxPending),
+    end_(false) {
+}
+
+// The queued changes are written before finishing
+DBWriter::~DBWriter() {
+  mutex_.lock();
+  end_ = true;
+  changesQueued_.wakeAll();
+  mutex_.unlock();
+
+  wait();
+}
+
+void DBWriter::write(const QList<DB::RowChange> &changes) {
+  if (changes.isEmpty())
+    return;
+
+  mutex_.lock();
+  while (pendChanges_.size() >= maxPending_)
+    changesWritten_.wait(&mutex_);
+
+  pendChanges_.enqueue(changes);
+  changesQueued_.wakeAll();
+  mutex_.unlock();
+}
+
+void DBWriter::flush() {
+  mutex_.lock();
+  while (!pendChanges_.isEmpty())
+    changesWritten_.wait(&mutex_);
+  mutex_.unlock();
+}
+
+// The connection is created here because it can only be used by the thread
+// that creates it. The log is checkpointed when the queue empties instead of
+// while writing, so the saves are not slowed and the readers see them soon.
+void DBWriter::run() {
+  DB db;
+  if (db.connect(fileName_, inFastMode_)) {
+    Log::write() << "DBWriter::run: unable to open the database file (" << 
+      fileName_ << ")." << endl;
+    qFatal("DBWriter::run: unable to open the database file");
+  }
+  db.setWalAutoCheckpoint(false);
+
+  mutex_.lock();
+  forever {
+    while (pendChanges_.isEmpty() && !end_)
+      changesQueued_.wait(&mutex_);
+
+    if (pendChanges_.isEmpty())
+      break;
+
+    QList<DB::RowChange> changes = pendChanges_.head();
+    mutex_.unlock();
+
+    // executeChanges() rolls back the changes when it fails
+    int nAttempts = 1;
+    while (!db.executeChanges(changes)) {
+      Log::write() << "DBWriter::run: error writing " << changes.size() << 
+        " row changes (attempt " << nAttempts << "): " << 
+        db.lastError().text() << endl;
+      if (nAttempts == MaxWriteAttempts)
+        qFatal("DBWriter::run: unable to write the row changes");
+
+      msleep(RetryWaitMsecs * nAttempts);
+      ++nAttempts;
+    }
+
+    // With a scratch copy, flush() also waits for the original file
+    db.flushMirror();
+
+    mutex_.lock();
+    pendChanges_.dequeue();
+    changesWritten_.wakeAll();
+
+    if (pendChanges_.isEmpty()) {
+      mutex_.unlock();
+      db.checkpointWal();
+      mutex_.lock();
+    }
+  }
+  mutex_.unlock();
+}
+
+}
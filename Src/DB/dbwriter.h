@@ -0,0 +1,47 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "db.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+
+namespace LoboLab {
+
+// Thread that executes in its own connection the row changes recorded by 
+// another connection to the same database file, so the recording thread does
+// not wait for the disk. The changes are immutable copies of the values. At 
+// most maxPending sets of changes are queued, and write() blocks while the 
+// queue is full. A set of changes that cannot be written is retried, and the 
+// process is aborted if it still fails, since the evolution saved would be 
+// incomplete.
+class DBWriter : public QThread {
+ public:
+  DBWriter(const QString &fileName, bool inFastMode, int maxPending = 4);
+  ~DBWriter();
+
+  void write(const QList<DB::RowChange> &changes);
+  void flush(); // Waits until all the queued changes are written
+
+ protected:
+  void run();
+
+ private:
+  static const int MaxWriteAttempts;
+  static const int RetryWaitMsecs;
+
+  QString fileName_;
+  bool inFastMode_;
+  int maxPending_;
+  bool end_;
+
+  QQueue<QList<DB::RowChange> > pendChanges_; // Removed once written
+  QMutex mutex_;
+  QWaitCondition changesQueued_;
+  QWaitCondition changesWritten_;
+};
+
+} // namespace LoboLab
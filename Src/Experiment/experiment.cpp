@@ -6,6 +6,8 @@
 #include "product.h"
 
 #include <QSet>
+#include <QDataStream>
+#include <QCryptographicHash>
 #include <algorithm>
 
 namespace LoboLab {
@@ -146,6 +148,22 @@ QSet<int> Experiment::calcnProducts() const {
   return productIds;
 }
 
+// Hash of the phenotypes that define the experiment, used to detect whether
+// an experiment has changed since an error was calculated for it.
+QByteArray Experiment::checksum() const {
+  QByteArray data;
+  QDataStream stream(&data, QIODevice::WriteOnly);
+
+  int n = phenotypes_.size();
+  for (int i = 0; i < n; ++i) {
+    Phenotype *phenotype = phenotypes_.at(i);
+    stream << phenotype->product()->id() << phenotype->time() << 
+      phenotype->concentration();
+  }
+
+  return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
 bool Experiment::operator==(const Experiment& other) const {
   
   bool equal = phenotypes_.size() == other.phenotypes_.size();
@@ -33,6 +33,7 @@ class Experiment : public DBElement {
   double calcTimePeriod() const;
   QSet<int> calcnProducts() const;
   void setProdConcsLinear() const;
+  QByteArray checksum() const;
 
   bool operator==(const Experiment& other) const;
   inline bool operator!=(const Experiment& other) const {
@@ -8,15 +8,20 @@
 #include "Common/mathalgo.h"
 #include "Common/log.h"
 #include "Experiment/product.h"
+#include <QAtomicInt>
+#include <QLocale>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
 
 namespace LoboLab {
 
-Model::Model() {}
-
-Model::~Model() {
-  clear();
+Model::Model() 
+  : prods_(new ProdBlock()), links_(new LinkBlock()) {
 }
 
+Model::~Model() {}
+
 // Product-based uniform cross, including exclusive products.
 // Child1 is more similar to parent1 and child2 is more similar to parent2.
 void Model::cross(const Model *parent1, const Model *parent2,
@@ -61,18 +66,20 @@ void Model::cross(const Model *parent1, const Model *parent2,
 
 #ifdef QT_DEBUG
     // Check that the models are coherent
-    QSet<int> labels = child1->calcProductLabels();
-    int n = child1->nLinks();
+    const Model *checked = child1;
+    QSet<int> labels = checked->calcProductLabels();
+    int n = checked->nLinks();
     for (int i = 0; i < n; ++i) {
-      ModelLink * link = child1->link(i);
+      const ModelLink *link = checked->link(i);
       Q_ASSERT(labels.contains(link->regulatedProdLabel()) &&
         labels.contains(link->regulatedProdLabel()));
     }
 
-    labels = child2->calcProductLabels();
-    n = child2->nLinks();
+    checked = child2;
+    labels = checked->calcProductLabels();
+    n = checked->nLinks();
     for (int i = 0; i < n; ++i) {
-      ModelLink * link = child2->link(i);
+      const ModelLink *link = checked->link(i);
       Q_ASSERT(labels.contains(link->regulatedProdLabel()) &&
         labels.contains(link->regulatedProdLabel()));
     }
@@ -106,9 +113,9 @@ void Model::copyProducts(Model *to,
                          const Model *from, const QSet<int> &products) {
   int n = from->nProducts();
   for (int i = 0; i<n; ++i) {
-    ModelProd *prod = from->product(i);
+    const ModelProd *prod = from->product(i);
     if (products.contains(prod->label()))
-      to->products_.append(new ModelProd(*prod));
+      to->appendProduct(*prod);
   }
 }
 
@@ -131,20 +138,20 @@ void Model::copyLinks(Model *to, const Model *from1, const QSet<int> &products1,
 
   int n = from1->nLinks();
   for (int i = 0; i < n; ++i) {
-    ModelLink *link = from1->link(i);
+    const ModelLink *link = from1->link(i);
     int regulated = link->regulatedProdLabel();
 
     if (products1.contains(regulated)) {
       int regulator = link->regulatorProdLabel();
       if (products1.contains(regulator) || // Use the original regulator
           products2.contains(regulator)) {
-        to->links_.append(new ModelLink(*link));
+        to->appendLink(*link);
       } else if (!regulators2.isEmpty()) { // Substitute the regulator
         int newRegulator = regulators2[MathAlgo::randInt(regulators2.size())];
         if (!from1->findLink(newRegulator, regulated)) {
-          ModelLink *newLink = new ModelLink(*link);
-          newLink->setRegulator(newRegulator);
-          to->links_.append(newLink);
+          ModelLink newLink = *link;
+          newLink.setRegulator(newRegulator);
+          to->appendLink(newLink);
         }
       }
     }
@@ -152,105 +159,164 @@ void Model::copyLinks(Model *to, const Model *from1, const QSet<int> &products1,
   
   n = from2->nLinks();
   for (int i = 0; i < n; ++i) {
-    ModelLink *link = from2->link(i);
+    const ModelLink *link = from2->link(i);
     int regulated = link->regulatedProdLabel();
 
     if (products2.contains(regulated)) {
       int regulator = link->regulatorProdLabel();
       if (products2.contains(regulator) || // Use the original regulator
           products1.contains(regulator)) {
-        to->links_.append(new ModelLink(*link));
+        to->appendLink(*link);
       } else if (!regulators1.isEmpty()) { // Substitute the regulator
         int newRegulator = regulators1[MathAlgo::randInt(regulators1.size())];
         if (!from2->findLink(newRegulator, regulated)) {
-          ModelLink *newLink = new ModelLink(*link);
-          newLink->setRegulator(newRegulator);
-          to->links_.append(newLink);
+          ModelLink newLink = *link;
+          newLink.setRegulator(newRegulator);
+          to->appendLink(newLink);
         }
       }
     }
   }
 }
 
-Model::Model(const Model &source) {
-  *this = source;
+// The blocks are shared, and copied only when one of the models changes them.
+// The source can be filling its topology in another thread.
+Model::Model(const Model &source)
+  : prods_(source.prods_), links_(source.links_) {
+  QMutexLocker locker(&source.topologyMutex_);
+  topology_ = source.topology_;
+  topologyAllFeatures_ = source.topologyAllFeatures_;
 }
 
 Model &Model::operator=(const Model &source) {
-  clear();
-  int n = source.nProducts();
-  for (int i = 0; i<n; ++i)
-    products_.append(new ModelProd(*source.product(i)));
+  if (this == &source)
+    return *this;
 
-  n = source.nLinks();
-  for (int i = 0; i<n; ++i)
-    links_.append(new ModelLink(*source.link(i)));
+  prods_ = source.prods_;
+  links_ = source.links_;
+  QMutexLocker locker(&source.topologyMutex_);
+  topology_ = source.topology_;
+  topologyAllFeatures_ = source.topologyAllFeatures_;
 
   return *this;
 }
 
 void Model::clear() {
-  int n = products_.size();
-  for (int i=0; i<n; ++i)
-    delete products_.at(i);
+  prods_ = new ProdBlock();
+  links_ = new LinkBlock();
+  resetTopology();
+}
+
+void Model::appendProduct(const ModelProd &prod) {
+  // As in a linear search, a repeated label resolves to the first product
+  if (!prods_->indexes.contains(prod.label()))
+    prods_->indexes.insert(prod.label(), (int) prods_->records.size());
+
+  prods_->records.push_back(prod);
+  resetTopology();
+}
 
-  products_.clear();
+void Model::appendLink(const ModelLink &link) {
+  links_->toProd[link.regulatedProdLabel()].append((int) links_->records.size());
+  links_->records.push_back(link);
+  resetTopology();
+}
+
+void Model::indexProducts() {
+  prods_->indexes.clear();
+  int n = (int) prods_->records.size();
+  for (int i = n - 1; i >= 0; --i)
+    prods_->indexes.insert(prods_->records[i].label(), i);
+
+  resetTopology();
+}
 
-  n = links_.size();
-  for (int i=0; i<n; ++i)
-    delete links_.at(i);
+void Model::indexLinks() {
+  links_->toProd.clear();
+  int n = (int) links_->records.size();
+  for (int i = 0; i < n; ++i)
+    links_->toProd[links_->records[i].regulatedProdLabel()].append(i);
 
-  links_.clear();
+  resetTopology();
 }
 
 QSet<int> Model::calcProductLabels() const {
   QSet<int> labels;
-  int n = products_.size();
+  int n = (int) prods_->records.size();
   for (int i = 0; i < n; ++i)
-    labels += products_.at(i)->label();
+    labels += prods_->records[i].label();
 
   return labels;
 }
 
-ModelProd *Model::prodWithLabel(int label, int *ind) const {
-  int nProducts = products_.size();
-  int i = 0;
-  while (i < nProducts && products_.at(i)->label() != label)
-    ++i;
+const ModelProd *Model::prodWithLabel(int label, int *ind) const {
+  int i = prods_->indexes.value(label, -1);
 
-  if (i < nProducts) {
+  if (i >= 0) {
     if (ind)
       *ind = i;
-    return products_.at(i);
+    return product(i);
+  } else {
+    return NULL;
+  }
+}  
+
+ModelProd *Model::prodWithLabel(int label, int *ind) {
+  int i = prods_.constData()->indexes.value(label, -1);
+
+  if (i >= 0) {
+    if (ind)
+      *ind = i;
+    return product(i);
   } else {
     return NULL;
   }
 }  
 
-// The products in use are those with a path ending in a structural product.
 QSet<int> Model::calcProductLabelsInUse(bool includeAllFeatures) const {
-  // int numStrucProd = products_.length();
-  QSet<int> productsInUse;
+  return topology(includeAllFeatures).labelsInUse;
+}
+
+QList<int> Model::calcSortedProductLabelsInUse(bool includeAllFeatures) const {
+  return topology(includeAllFeatures).sortedLabelsInUse;
+}
+
+// The threads reading the model wait for the first one to fill the cache. 
+// The topology returned is valid until the next non-const access, which 
+// cannot happen while other threads read the model.
+const Model::Topology &Model::topology(bool includeAllFeatures) const {
+  QMutexLocker locker(&topologyMutex_);
+  QSharedPointer<const Topology> &cached = 
+    includeAllFeatures ? topologyAllFeatures_ : topology_;
+
+  if (!cached)
+    cached = QSharedPointer<const Topology>(calcTopology(includeAllFeatures));
+
+  return *cached;
+}
+
+// The products in use are those with a path ending in a structural product.
+Model::Topology *Model::calcTopology(bool includeAllFeatures) const {
+  Topology *topology = new Topology();
+  QSet<int> &productsInUse = topology->labelsInUse;
 
-  for (int i = 0; i < products_.length(); i++)
+  for (int i = 0; i < nProducts(); i++)
   {
-    if (products_[i]->type() == 2)
-      productsInUse.insert(products_[i]->label());
-    else if (includeAllFeatures && products_[i]->type() < 3)
-      productsInUse.insert(products_[i]->label());
+    if (prods_->records[i].type() == 2)
+      productsInUse.insert(prods_->records[i].label());
+    else if (includeAllFeatures && prods_->records[i].type() < 3)
+      productsInUse.insert(prods_->records[i].label());
   }
   
-  // Pre-calculate the links in the model
-  QMap<int, QList<int> > productRegulators = calcProductRegulators();
-
   QList<int> productsToVisit = productsInUse.toList();
 
   // Products regulating a product in use are in use
   while (!productsToVisit.isEmpty()) {
-    const QList<int> &regulators = productRegulators[productsToVisit.takeFirst()];
-    int nRegulators = regulators.size();
+    const QVector<int> regulatorLinks = 
+      links_->toProd.value(productsToVisit.takeFirst());
+    int nRegulators = regulatorLinks.size();
     for (int j = 0; j < nRegulators; ++j) {
-      int r = regulators[j];
+      int r = links_->records[regulatorLinks[j]].regulatorProdLabel();
       if (!productsInUse.contains(r)) {
         productsInUse.insert(r);
         productsToVisit.append(r);
@@ -258,20 +324,36 @@ QSet<int> Model::calcProductLabelsInUse(bool includeAllFeatures) const {
     }
   }
 
-  return productsInUse;
-}
+  // Products ordered by type, as the simulator expects them
+  const ProdBlock *prods = prods_.constData();
+  topology->sortedLabelsInUse = productsInUse.toList();
+  std::sort(topology->sortedLabelsInUse.begin(), 
+            topology->sortedLabelsInUse.end(), [prods](int a, int b) {
+    double typeA = prods->records[prods->indexes.value(a)].type();
+    double typeB = prods->records[prods->indexes.value(b)].type();
+    return typeA < typeB || (typeA == typeB && a < b);
+  });
 
-QMap<int, QList<int> > Model::calcProductRegulators() const {
-  QMap<int, QList<int> > productRegulators;
+  int complexity = 0;
+  int n = nProducts();
+  for (int i = 0; i < n; ++i) {
+    const ModelProd *prod = &prods->records[i];
+    if (productsInUse.contains(prod->label()))
+      complexity += prod->complexity();
+  }
 
-  int n = links_.size();
+  n = nLinks();
   for (int i = 0; i < n; ++i) {
-    ModelLink *link = links_.at(i);
-    productRegulators[link->regulatedProdLabel()].append(
-      link->regulatorProdLabel());
+    const ModelLink *link = &links_->records[i];
+    if (productsInUse.contains(link->regulatorProdLabel()) &&
+        productsInUse.contains(link->regulatedProdLabel())) {
+      topology->linksInUse.append(i);
+      complexity += link->complexity();
+    }
   }
+  topology->complexityInUse = complexity;
 
-  return productRegulators;
+  return topology;
 }
 
 Model *Model::createRandom(const QList<Product*> products, const QList<int> outputLabels) {
@@ -298,10 +380,11 @@ Model *Model::createRandom(const QList<Product*> products, const QList<int> outp
 
 #ifdef QT_DEBUG
   // Check that the model is coherent
-  QSet<int> labels = model->calcProductLabels();
-  int n = model->nLinks();
+  const Model *checked = model;
+  QSet<int> labels = checked->calcProductLabels();
+  int n = checked->nLinks();
   for (int i = 0; i < n; ++i) {
-    ModelLink * link = model->link(i);
+    const ModelLink *link = checked->link(i);
     Q_ASSERT(labels.contains(link->regulatedProdLabel()) &&
              labels.contains(link->regulatedProdLabel()));
   }
@@ -312,11 +395,11 @@ Model *Model::createRandom(const QList<Product*> products, const QList<int> outp
 
 
 ModelProd* Model::duplicateProduct(int i, const QList<int> inputLabels, const QList<int> outputLabels) {
-  ModelProd *newProd = new ModelProd(*products_[i]);
+  ModelProd newProd = prods_.constData()->records[i];
   int newLabel = createNewLabel();
-  newProd->setLabel(newLabel);
-  newProd->setType(3);
-  products_.append(newProd);
+  newProd.setLabel(newLabel);
+  newProd.setType(3);
+  appendProduct(newProd);
 
   // Create two random links using linkable products
   //int fromLabel = newLabel;
@@ -331,12 +414,12 @@ ModelProd* Model::duplicateProduct(int i, const QList<int> inputLabels, const QL
   //addOrReplaceRandomLink(findRandomLinkableFromProduct(targetModel)->label(), 
   //                       newLabel);
 
-  return newProd;
+  return &prods_->records.back();
 }
 
-ModelProd *Model::findRandomLinkableFromProduct() const {
-  ModelProd *prod;
-  prod = products_[MathAlgo::randInt(nProducts())];
+const ModelProd *Model::findRandomLinkableFromProduct() const {
+  const ModelProd *prod;
+  prod = product(MathAlgo::randInt(nProducts()));
 
   return prod;
 }
@@ -345,124 +428,148 @@ int Model::findRandomLinkableToLabel(const QList<int> inputLabels) const {
   QList<int> linkableLabels;
   linkableLabels.reserve(nProducts());
   for (int i = 0; i < nProducts(); ++i) {
-    if (products_[i]->label() > inputLabels.size())
-      linkableLabels.append(products_[i]->label());
+    if (prods_->records[i].label() > inputLabels.size())
+      linkableLabels.append(prods_->records[i].label());
   }
   return linkableLabels[MathAlgo::randInt(linkableLabels.size())];
 }
 
 void Model::removeProduct(int i) {
-  ModelProd *prod = products_.takeAt(i);
-  int label = prod->label();
-  delete prod;
-
-  int n = links_.size();
-  for (int i = n-1; i >= 0; --i) {
-    ModelLink *link = links_.at(i);
-    if (link->regulatorProdLabel() == label ||
-        link->regulatedProdLabel() == label) {
-      links_.removeAt(i);
-      delete link;
-    }
-  }
+  int label = prods_->records[i].label();
+  prods_->records.erase(prods_->records.begin() + i);
+  indexProducts();
+  removeLinksOfProduct(label);
 }
 
 void Model::removeProductWithLabel(int label) {
-  int i;
-  ModelProd *prod = prodWithLabel(label, &i);
-
-  if (prod) {
-    products_.takeAt(i);
-    int label = prod->label();
-    delete prod;
-
-    int n = links_.size();
-    for (int i = n-1; i >= 0; --i) {
-      ModelLink *link = links_.at(i);
-      if (link->regulatorProdLabel() == label ||
-          link->regulatedProdLabel() == label) {
-        links_.removeAt(i);
-        delete link;
-      }
-    }
+  int i = prods_.constData()->indexes.value(label, -1);
+  if (i >= 0)
+    removeProduct(i);
+}
+
+void Model::removeLinksOfProduct(int label) {
+  auto isOfProduct = [label](const ModelLink &link) {
+    return link.regulatorProdLabel() == label ||
+           link.regulatedProdLabel() == label;
+  };
+
+  const std::vector<ModelLink> &links = links_.constData()->records;
+  if (std::find_if(links.begin(), links.end(), isOfProduct) != links.end()) {
+    std::vector<ModelLink> &records = links_->records;
+    records.erase(std::remove_if(records.begin(), records.end(), isOfProduct),
+                  records.end());
+    indexLinks();
   }
 }
 
 int Model::createNewLabel() {
-    // Select always a new label
-  static int newLabel = 200;
-  newLabel++;
+    // Select always a new label, also among concurrent searches
+  static QAtomicInt newLabel(200);
 
-  return newLabel;
+  return newLabel.fetchAndAddRelaxed(1) + 1;
 }
 
 void Model::addRandomProduct(int label, int type) {
-  if (ModelProd *oldProd = prodWithLabel(label)) {
-    products_.removeOne(oldProd);
-    delete oldProd;
+  int i = prods_->indexes.value(label, -1);
+  if (i >= 0) {
+    prods_->records.erase(prods_->records.begin() + i);
+    indexProducts();
   }
 
-  ModelProd *newProd = new ModelProd(label, type);
-  products_.append(newProd);
+  appendProduct(ModelProd(label, type));
+}
+
+QList<const ModelLink*> Model::links() const {
+  QList<const ModelLink*> links;
+  int nLinks = this->nLinks();
+  links.reserve(nLinks);
+  for (int i = 0; i < nLinks; ++i)
+    links.append(link(i));
+
+  return links;
+}
+
+QList<ModelLink*> Model::links() {
+  QList<ModelLink*> links;
+  int nLinks = this->nLinks();
+  links.reserve(nLinks);
+  for (int i = 0; i < nLinks; ++i)
+    links.append(link(i));
+
+  return links;
+}
+
+QList<const ModelLink*> Model::linksToLabel(int label) const {
+  QList<const ModelLink*> linksToLabel;
+  const QVector<int> linkInds = links_->toProd.value(label);
+  int nLinks = linkInds.size();
+  for (int i = 0; i < nLinks; ++i)
+    linksToLabel.append(link(linkInds[i]));
+
+  return linksToLabel;
 }
 
-QList<ModelLink*> Model::linksToLabel(int label) const {
+QList<ModelLink*> Model::linksToLabel(int label) {
   QList<ModelLink*> linksToLabel;
-  int nLinks = links_.size();
+  const QVector<int> linkInds = links_.constData()->toProd.value(label);
+  int nLinks = linkInds.size();
   for (int i = 0; i < nLinks; ++i)
-    if (links_.at(i)->regulatedProdLabel() == label)
-      linksToLabel.append(links_.at(i));
+    linksToLabel.append(link(linkInds[i]));
 
   return linksToLabel;
 }
 
-QList<ModelLink*> Model::calcLinksInUse() const {
-  QList<ModelLink*> linksInUse;
-  QSet<int> labelsInUse = calcProductLabelsInUse();
-  int nLinks = links_.size();
-  for (int i = 0; i < nLinks; ++i) {
-    ModelLink *link = links_.at(i);
-    if (labelsInUse.contains(link->regulatorProdLabel()) &&
-        labelsInUse.contains(link->regulatedProdLabel()))
-      linksInUse.append(link);
-  }
+QList<const ModelLink*> Model::calcLinksInUse() const {
+  QList<const ModelLink*> linksInUse;
+  const QVector<int> &linkInds = topology(false).linksInUse;
+  int nLinks = linkInds.size();
+  for (int i = 0; i < nLinks; ++i)
+    linksInUse.append(link(linkInds[i]));
 
   return linksInUse;
 }
 
 int Model::calcNLinksFromProd(int prodLabel) const {
   int n = 0;
-  int nLinks = links_.size();
+  int nLinks = (int) links_->records.size();
   for (int i = 0; i < nLinks; ++i)
-    if (prodLabel == links_[i]->regulatorProdLabel())
+    if (prodLabel == links_->records[i].regulatorProdLabel())
       ++n;
 
   return n;
 }
 
-ModelLink *Model::findLink(int regulator, int regulated) const {
-  int nLinks = links_.size();
-  int i = 0;
-  while (i < nLinks) {
-    ModelLink *link = links_[i];
-    if (link->regulatorProdLabel() == regulator && 
-        link->regulatedProdLabel() == regulated)
-      return link;
-    else
-      ++i;
+const ModelLink *Model::findLink(int regulator, int regulated) const {
+  int i = findLinkInd(regulator, regulated);
+  if (i >= 0)
+    return link(i);
+  else
+    return NULL;
+}
+
+int Model::findLinkInd(int regulator, int regulated) const {
+  QHash<int, QVector<int> >::const_iterator ite = 
+    links_->toProd.constFind(regulated);
+  if (ite != links_->toProd.constEnd()) {
+    const QVector<int> &linkInds = ite.value();
+    int n = linkInds.size();
+    for (int i = 0; i < n; ++i)
+      if (links_->records[linkInds[i]].regulatorProdLabel() == regulator)
+        return linkInds[i];
   }
 
-  return NULL;
+  return -1;
 }
 
 
 void Model::addOrReplaceRandomLink() {
-  int nProducts = products_.size();
+  const std::vector<ModelProd> &prods = prods_.constData()->records;
+  int nProducts = (int) prods.size();
   int regulatorLabel = 0;
   int regulatedLabel = 0;
   while (regulatorLabel == regulatedLabel) {
-    regulatorLabel = products_.at(MathAlgo::randInt(nProducts))->label();
-    regulatedLabel = products_.at(MathAlgo::randInt(nProducts))->label();
+    regulatorLabel = prods[MathAlgo::randInt(nProducts)].label();
+    regulatedLabel = prods[MathAlgo::randInt(nProducts)].label();
   }
   addOrReplaceRandomLink(regulatorLabel, regulatedLabel);
 }
@@ -471,30 +578,20 @@ void Model::addOrReplaceRandomLink(int regulatorLabel, int regulatedLabel) {
   removeLink(regulatorLabel, regulatedLabel);
 
   // new ModelLink will check if regulatedLabel is a metabolite
-  ModelLink *newLink = new ModelLink(regulatorLabel, regulatedLabel);
-  links_.append(newLink);
+  appendLink(ModelLink(regulatorLabel, regulatedLabel));
 }
 
 //If the link exists, delete it
 void Model::removeLink(int regulatorLabel, int regulatedLabel) {
-  int nLinks = links_.size();
-  bool found = false;
-  int i = 0;
-  while (!found && i < nLinks) {
-    ModelLink *link = links_.at(i);
-    if (regulatorLabel == link->regulatorProdLabel() &&
-        regulatedLabel == link->regulatedProdLabel()) {
-      found = true;
-      links_.removeAt(i);
-      delete link;
-    } else
-      ++i;
-  }
+  int i = findLinkInd(regulatorLabel, regulatedLabel);
+  if (i >= 0)
+    removeLink(i);
 }
 
 ModelLink *Model::duplicateLink(int i, int toProductId, 
-  const QList<int> inputLabels, const QList<int> outputLabels) {
-  ModelLink *newLink = new ModelLink(*links_.at(i));
+  const QList<int> inputLabels, const QList<int> outputLabels, 
+  int *iRemoved) {
+  ModelLink newLink = links_.constData()->records[i];
 
   int regulatorLabel = 0;
   int regulatedLabel = 0;
@@ -502,16 +599,22 @@ ModelLink *Model::duplicateLink(int i, int toProductId,
   regulatorLabel = findRandomLinkableFromProduct()->label();
   regulatedLabel = findRandomLinkableToLabel(inputLabels);
 
-  removeLink(regulatorLabel, regulatedLabel);
-  newLink->setRegulator(regulatorLabel);
-  newLink->setRegulated(regulatedLabel);
-  links_.append(newLink);
+  int iOld = findLinkInd(regulatorLabel, regulatedLabel);
+  if (iOld >= 0)
+    removeLink(iOld);
+  if (iRemoved)
+    *iRemoved = iOld;
+
+  newLink.setRegulator(regulatorLabel);
+  newLink.setRegulated(regulatedLabel);
+  appendLink(newLink);
 
-  return newLink;
+  return &links_->records.back();
 }
 
 void Model::removeLink(int i) {
-  delete links_.takeAt(i);
+  links_->records.erase(links_->records.begin() + i);
+  indexLinks();
 }
 
 void Model::mutate(const QList<int> inputLabels, const QList<int> outputLabels, const int maxProductLabel) {
@@ -521,35 +624,48 @@ void Model::mutate(const QList<int> inputLabels, const QList<int> outputLabels,
   // int maxProductLabel = maxProductLabel;
 
   // Product mutations without external factors
+  // The products and links are addressed by index, since adding or removing
+  // them moves the records. The new ones are appended after the current index.
+  // The params are mutated in a copy of the record, which is written back only
+  // if it changed, so that an untouched block stays shared.
   for (int i = nProducts() - 1; i >= 0; --i) {
-    ModelProd *prod = products_[i];
     // Param mutations for target product
 
     if (MathAlgo::rand100() < 1) // Copy product
       duplicateProduct(i, inputLabels, outputLabels);
 
-    if (prod->label() > maxProductLabel && MathAlgo::rand1000() < 15) // Remove product
+    ModelProd prod = prods_.constData()->records[i];
+    if (prod.label() > maxProductLabel && MathAlgo::rand1000() < 15) // Remove product
       removeProduct(i);
-
-    prod->mutateParams(paramMutationProb);
+    else if (prod.mutateParams(paramMutationProb))
+      prods_->records[i] = prod;
 
   }
   
   // Link mutations
   for (int i = nLinks()-1; i >= 0;  --i) {
-    ModelLink *link = links_[i];
-    int toProductId = link->regulatedProdLabel();
+    int toProductId = links_.constData()->records[i].regulatedProdLabel();
  
     // Copy link
-    if (MathAlgo::rand100() < 1) 
-      duplicateLink(i, toProductId, inputLabels, outputLabels)->mutateParams(
-        paramMutationProb, true, true);
+    if (MathAlgo::rand100() < 1) {
+      int iRemoved;
+      duplicateLink(i, toProductId, inputLabels, outputLabels, 
+        &iRemoved)->mutateParams(paramMutationProb, true, true);
+
+      if (iRemoved == i) // The copy replaced this link
+        continue;
+      else if (iRemoved >= 0 && iRemoved < i)
+        --i;
+    }
 
     // Remove link
     if (MathAlgo::rand1000() < 15)
       removeLink(i);
-    else // Param mutations for not target link
-      link->mutateParams(paramMutationProb, true, true);
+    else { // Param mutations for not target link
+      ModelLink link = links_.constData()->records[i];
+      if (link.mutateParams(paramMutationProb, true, true))
+        links_->records[i] = link;
+    }
     // } 
   }
 
@@ -558,7 +674,7 @@ void Model::mutate(const QList<int> inputLabels, const QList<int> outputLabels,
     // Check that the model is coherent
     QSet<int> labels = calcProductLabels();
     for (int i = 0; i < nLinks(); ++i) {
-      ModelLink * link = links_.at(i);
+      const ModelLink *link = &links_.constData()->records[i];
       Q_ASSERT(labels.contains(link->regulatedProdLabel()) &&
                labels.contains(link->regulatedProdLabel()));
     }
@@ -569,44 +685,110 @@ void Model::mutate(const QList<int> inputLabels, const QList<int> outputLabels,
 int Model::calcComplexity() const {
   int complexity = 0;
 
-  int n = products_.size();
+  int n = (int) prods_->records.size();
   for (int i=0; i < n; ++i)
-    complexity += products_.at(i)->complexity();
+    complexity += prods_->records[i].complexity();
 
-  n = links_.size();
+  n = (int) links_->records.size();
   for (int i=0; i < n; ++i)
-    complexity += links_.at(i)->complexity();
+    complexity += links_->records[i].complexity();
 
   return complexity;
 }
 
 int Model::calcComplexityInUse() const {
-  int complexity = 0;
+  return topology(false).complexityInUse;
+}
 
-  const QSet<int> labelsInUse = calcProductLabelsInUse();
+// Text Serialization
+void Model::loadFromString(QString &str) {
+  if (!parseString(str)) {
+    QTextStream stream(&str, QIODevice::ReadOnly);
+    stream >> *this;
+  }
+}
 
-  int n = products_.size();
-  for (int i=0; i < n; ++i) {
-    ModelProd *prod = products_.at(i);
-    if (labelsInUse.contains(prod->label()))
-      complexity += prod->complexity();
+// Single pass parser of the text serialization, which reads the numbers in
+// place instead of through a QTextStream seeking back after each one. As 
+// operator>>, it keeps the params read, even if negative, but it does not 
+// draw random numbers for the records.
+bool Model::parseString(const QString &str) {
+  clear();
+
+  int n = str.size();
+  int pos = 0;
+  while (pos < n && str.at(pos) == ' ')
+    ++pos;
+
+  if (pos == n || str.at(pos) != '(')
+    return false;
+  ++pos;
+
+  double v[8];
+  QChar c = '|';
+  while (c == '|') {
+    for (int i = 0; i < 8; ++i)
+      if (!parseNumber(str, &pos, &v[i]))
+        return false;
+
+    prods_->records.push_back(ModelProd((int) v[0], v[1], v[2], v[3], v[4],
+                                        v[5], v[6], (int) v[7]));
+
+    if (pos == n)
+      return false;
+    c = str.at(pos++);
   }
 
-  n = links_.size();
-  for (int i=0; i < n; ++i) {
-    ModelLink *link = links_.at(i);
-    if (labelsInUse.contains(link->regulatorProdLabel()) &&
-        labelsInUse.contains(link->regulatedProdLabel()))
-      complexity += link->complexity();
+  if (c != '*')
+    return false;
+
+  while (pos < n && str.at(pos) == ' ')
+    ++pos;
+
+  if (pos < n && str.at(pos) != ')') {
+    c = '|';
+    while (c == '|') {
+      for (int i = 0; i < 6; ++i)
+        if (!parseNumber(str, &pos, &v[i]))
+          return false;
+
+      links_->records.push_back(ModelLink((int) v[0], (int) v[1], 0, v[2], 
+                                          v[3], v[4] != 0, v[5] != 0));
+
+      if (pos == n)
+        return false;
+      c = str.at(pos++);
+    }
+  } else {
+    c = pos < n ? str.at(pos++) : QChar();
   }
 
-  return complexity;
+  indexProducts();
+  indexLinks();
+
+  return c == ')' && nProducts() > 0;
 }
 
-// Text Serialization
-void Model::loadFromString(QString &str) {
-  QTextStream stream(&str, QIODevice::ReadOnly);
-  stream >> *this;
+bool Model::parseNumber(const QString &str, int *pos, double *value) {
+  int n = str.size();
+  int i = *pos;
+  while (i < n && str.at(i) == ' ')
+    ++i;
+
+  int start = i;
+  while (i < n) {
+    QChar c = str.at(i);
+    if (c == ' ' || c == '|' || c == '*' || c == ')')
+      break;
+    ++i;
+  }
+
+  bool ok = false;
+  if (i > start)
+    *value = QLocale::c().toDouble(QStringRef(&str, start, i - start), &ok);
+
+  *pos = i;
+  return ok;
 }
 
 QString Model::toString() {
@@ -620,26 +802,26 @@ QString Model::toString() {
 QTextStream &operator<<(QTextStream &stream, const Model &model) {
   stream << '(';
 
-  int n = model.products_.size();
+  int n = (int) model.prods_->records.size();
   if (n > 0) {
     for (int i=0; i<n-1; ++i) {
-      stream << *model.products_.at(i);
+      stream << model.prods_->records[i];
       stream << '|';
     }
 
-    stream << *model.products_.last();
+    stream << model.prods_->records.back();
   }
 
   stream << '*';
 
-  n = model.links_.size();
+  n = (int) model.links_->records.size();
   if (n > 0) {
     for (int i=0; i<n-1; ++i) {
-      stream << *model.links_.at(i);
+      stream << model.links_->records[i];
       stream << '|';
     }
 
-    stream << *model.links_.last();
+    stream << model.links_->records.back();
   }
 
   stream << ')';
@@ -657,9 +839,9 @@ QTextStream &operator>>(QTextStream &stream, Model &model) {
   Q_ASSERT(c == '(');
 
   while (c != '*') {
-    ModelProd *modelProd = new ModelProd();
-    stream >> *modelProd;
-    model.products_.append(modelProd);
+    ModelProd modelProd;
+    stream >> modelProd;
+    model.appendProduct(modelProd);
     stream >> c;
   }
 
@@ -668,9 +850,9 @@ QTextStream &operator>>(QTextStream &stream, Model &model) {
     stream.seek(stream.pos()-1);
 
     while (c != ')') {
-      ModelLink *modelLink = new ModelLink();
-      stream >> *modelLink;
-      model.links_.append(modelLink);
+      ModelLink modelLink;
+      stream >> modelLink;
+      model.appendLink(modelLink);
       stream >> c;
     }
   }
@@ -680,6 +862,128 @@ QTextStream &operator>>(QTextStream &stream, Model &model) {
   return stream;
 }
 
+// Binary Serialization
+// The version, the number of products and of links, and then the fixed size
+// records, all little-endian. A product is its label, init, lim, posLim, 
+// negLim, deg, intrGrow and type, and a link its regulator, regulated, 
+// disConst, hillCoef, isAndReg and isPositive. Unlike the text, the doubles
+// keep all their precision.
+
+QByteArray Model::toBinary() const {
+  int nProds = nProducts();
+  int nLinks = this->nLinks();
+  QByteArray bin(BinHeaderSize + nProds * BinProdSize + 
+                 nLinks * BinLinkSize, 0);
+  uchar *data = (uchar*) bin.data();
+
+  *data++ = BinaryVersion;
+  writeBinInt(nProds, data);
+  writeBinInt(nLinks, data);
+
+  for (int i = 0; i < nProds; ++i) {
+    const ModelProd &prod = prods_->records[i];
+    writeBinInt(prod.label(), data);
+    writeBinDouble(prod.init(), data);
+    writeBinDouble(prod.lim(), data);
+    writeBinDouble(prod.posLim(), data);
+    writeBinDouble(prod.negLim(), data);
+    writeBinDouble(prod.deg(), data);
+    writeBinDouble(prod.intrGrow(), data);
+    writeBinInt((qint32) prod.type(), data);
+  }
+
+  for (int i = 0; i < nLinks; ++i) {
+    const ModelLink &link = links_->records[i];
+    writeBinInt(link.regulatorProdLabel(), data);
+    writeBinInt(link.regulatedProdLabel(), data);
+    writeBinDouble(link.disConst(), data);
+    writeBinDouble(link.hillCoef(), data);
+    *data++ = link.isAndReg();
+    *data++ = link.isPos();
+  }
+
+  return bin;
+}
+
+// The records are decoded straight from the buffer into the arrays
+bool Model::loadFromBinary(const QByteArray &bin) {
+  clear();
+
+  if (bin.size() < BinHeaderSize)
+    return false;
+
+  const uchar *data = (const uchar*) bin.constData();
+  if (*data++ != BinaryVersion)
+    return false;
+
+  int nProds = readBinInt(data);
+  int nLinks = readBinInt(data);
+  if (nProds <= 0 || nLinks < 0 || nProds > bin.size() / BinProdSize || 
+      nLinks > bin.size() / BinLinkSize || bin.size() != BinHeaderSize + 
+      nProds * BinProdSize + nLinks * BinLinkSize)
+    return false;
+
+  std::vector<ModelProd> &prods = prods_->records;
+  prods.reserve(nProds);
+  for (int i = 0; i < nProds; ++i) {
+    int label = readBinInt(data);
+    double init = readBinDouble(data);
+    double lim = readBinDouble(data);
+    double posLim = readBinDouble(data);
+    double negLim = readBinDouble(data);
+    double deg = readBinDouble(data);
+    double intrGrow = readBinDouble(data);
+    int type = readBinInt(data);
+    prods.push_back(ModelProd(label, init, lim, posLim, negLim, deg, intrGrow,
+                              type));
+  }
+
+  std::vector<ModelLink> &links = links_->records;
+  links.reserve(nLinks);
+  for (int i = 0; i < nLinks; ++i) {
+    int regulator = readBinInt(data);
+    int regulated = readBinInt(data);
+    double disConst = readBinDouble(data);
+    double hillCoef = readBinDouble(data);
+    bool isAndReg = data[0] != 0;
+    bool isPositive = data[1] != 0;
+    data += 2;
+    links.push_back(ModelLink(regulator, regulated, 0, disConst, hillCoef, 
+                              isAndReg, isPositive));
+  }
+
+  indexProducts();
+  indexLinks();
+
+  return true;
+}
+
+void Model::writeBinInt(qint32 value, uchar *&data) {
+  qToLittleEndian(value, data);
+  data += 4;
+}
+
+void Model::writeBinDouble(double value, uchar *&data) {
+  quint64 bits;
+  memcpy(&bits, &value, 8);
+  qToLittleEndian(bits, data);
+  data += 8;
+}
+
+qint32 Model::readBinInt(const uchar *&data) {
+  qint32 value = qFromLittleEndian<qint32>(data);
+  data += 4;
+  return value;
+}
+
+double Model::readBinDouble(const uchar *&data) {
+  quint64 bits = qFromLittleEndian<quint64>(data);
+  data += 8;
+  double value;
+  memcpy(&value, &bits, 8);
+  return value;
+}
+
 double Model::parseDouble(QTextStream &stream) {
   QChar c;
   QString str;
@@ -3,15 +3,30 @@
 
 #pragma once
 
+#include "modelprod.h"
+#include "modellink.h"
 #include <QSet>
+#include <QHash>
+#include <QSharedData>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QVector>
 #include <QTextStream>
+#include <vector>
 
 namespace LoboLab {
 
-class ModelProd;
-class ModelLink;
 class Product;
 
+// The products and links are stored by value in contiguous arrays, in two
+// blocks that the copies of a model share until one of them changes the block
+// (copy-on-write). The products are indexed by label, and the links by the
+// label of the product regulated. The pointers to the products and links are
+// valid until the next product or link is added or removed, or the block is
+// unshared by a non-const access, and the labels must not be changed through
+// them. The products and links in use are cached until the next non-const
+// access to them; a mutation of the params only keeps the cache. The cache is
+// filled under a lock, so a model can be read by several threads at once.
 class Model {
 
  public:
@@ -28,10 +43,17 @@ class Model {
 
   QSet<int> calcProductLabels() const;
   QSet<int> calcProductLabelsInUse(bool includeAllFeatures = false) const;
-
-  inline int nProducts() const { return products_.size(); }
-  inline ModelProd *product(int i) const { return products_.at(i); }
-  ModelProd *prodWithLabel(int label, int *i = NULL) const;
+  // Sorted by product type, and then by label
+  QList<int> calcSortedProductLabelsInUse(bool includeAllFeatures = false) const;
+
+  inline int nProducts() const { return (int) prods_->records.size(); }
+  inline const ModelProd *product(int i) const { return &prods_->records[i]; }
+  inline ModelProd *product(int i) { 
+    resetTopology(); 
+    return &prods_->records[i]; 
+  }
+  const ModelProd *prodWithLabel(int label, int *i = NULL) const;
+  ModelProd *prodWithLabel(int label, int *i = NULL);
   
   void addRandomProduct(int label, int type);
   ModelProd * duplicateProduct(int i, const QList<int> inputLabels, const QList<int> outputLabels);
@@ -40,18 +62,25 @@ class Model {
   //void replaceProductWithLabelByRandomLinks(int label);
 
   
-  inline int nLinks() const { return links_.size(); }
-  inline ModelLink *link(int i) const { return links_.at(i); }
-  inline QList<ModelLink*> links() const { return links_; }
-  QList<ModelLink*> linksToLabel(int label) const;
-  QList<ModelLink*> calcLinksInUse() const;
+  inline int nLinks() const { return (int) links_->records.size(); }
+  inline const ModelLink *link(int i) const { return &links_->records[i]; }
+  inline ModelLink *link(int i) { 
+    resetTopology(); 
+    return &links_->records[i]; 
+  }
+  QList<const ModelLink*> links() const;
+  QList<ModelLink*> links();
+  QList<const ModelLink*> linksToLabel(int label) const;
+  QList<ModelLink*> linksToLabel(int label);
+  QList<const ModelLink*> calcLinksInUse() const;
   int calcNLinksFromProd(int label) const;
-  ModelLink *findLink(int regulator, int regulated) const;
+  const ModelLink *findLink(int regulator, int regulated) const;
 
   void addOrReplaceRandomLink();
   void addOrReplaceRandomLink(int regulatorLabel, int regulatedLabel);
   ModelLink *duplicateLink(int i, int toProductId, 
-    const QList<int> inputLabels, const QList<int> outputLabels);
+    const QList<int> inputLabels, const QList<int> outputLabels,
+    int *iRemoved = NULL); // Index of the link replaced, or -1
   void removeLink(int i);
   void removeLink(int regulatorLabel, int regulatedLabel);
 
@@ -65,12 +94,19 @@ class Model {
 
   // Text Serialization
   void loadFromString(QString &str);
+  bool parseString(const QString &str); // Returns false if malformed
   QString toString();
 
   friend QTextStream &operator<<(QTextStream &stream, const Model &model);
   friend QTextStream &operator>>(QTextStream &stream, Model &model);
 
   static double parseDouble(QTextStream &stream);
+
+  // Binary Serialization
+  QByteArray toBinary() const;
+  bool loadFromBinary(const QByteArray &bin); // Returns false if malformed
+
+  static const quint8 BinaryVersion = 1;
   
  private:
   static void distributeProducts(const QSet<int> &fromProds, 
@@ -83,13 +119,60 @@ class Model {
   static void copyLinks(Model *to,
     const Model *from1, const QSet<int> &products1,
     const Model *from2, const QSet<int> &products2);
-  QMap<int, QList<int> > calcProductRegulators() const;
   int createNewLabel();
-  ModelProd *findRandomLinkableFromProduct() const;
+  const ModelProd *findRandomLinkableFromProduct() const;
   int findRandomLinkableToLabel(const QList<int> inputLabels) const;
 
-  QList<ModelProd*> products_;
-  QList<ModelLink*> links_;
+  void appendProduct(const ModelProd &prod);
+  void appendLink(const ModelLink &link);
+  int findLinkInd(int regulator, int regulated) const;
+  void removeLinksOfProduct(int label);
+  void indexProducts();
+  void indexLinks();
+
+  static const int BinHeaderSize = 1 + 2 * 4;
+  static const int BinProdSize = 4 + 6 * 8 + 4;
+  static const int BinLinkSize = 2 * 4 + 2 * 8 + 2;
+
+  static bool parseNumber(const QString &str, int *pos, double *value);
+  static void writeBinInt(qint32 value, uchar *&data);
+  static void writeBinDouble(double value, uchar *&data);
+  static qint32 readBinInt(const uchar *&data);
+  static double readBinDouble(const uchar *&data);
+
+  struct Topology {
+    QSet<int> labelsInUse;
+    QList<int> sortedLabelsInUse;
+    QVector<int> linksInUse; // Indexes
+    int complexityInUse;
+  };
+
+  const Topology &topology(bool includeAllFeatures) const;
+  Topology *calcTopology(bool includeAllFeatures) const;
+  inline void resetTopology() { 
+    topology_.clear(); 
+    topologyAllFeatures_.clear(); 
+  }
+
+  struct ProdBlock : public QSharedData {
+    std::vector<ModelProd> records;
+    QHash<int, int> indexes; // By label
+  };
+
+  struct LinkBlock : public QSharedData {
+    std::vector<ModelLink> records;
+    QHash<int, QVector<int> > toProd; // Indexes, by regulated label
+  };
+
+  // Only a non-const access unshares a block, so the methods that do not
+  // always modify it read it through constData().
+  QSharedDataPointer<ProdBlock> prods_;
+  QSharedDataPointer<LinkBlock> links_;
+
+  // Computed on demand, and shared by the copies
+  mutable QSharedPointer<const Topology> topology_;
+  mutable QSharedPointer<const Topology> topologyAllFeatures_;
+  mutable QMutex topologyMutex_; // Not copied
 
 };
 
@@ -33,23 +33,18 @@ ModelLink::ModelLink(int rtor, int rted, double l, double d, double h, bool i, b
 }
 
 
-ModelLink::~ModelLink() {}
-
-ModelLink::ModelLink(const ModelLink &source)
-  : regulator_(source.regulator_), regulated_(source.regulated_),
-    disConst_(source.disConst_), hillCoef_(source.hillCoef_),
-    isAndReg_(source.isAndReg_),
-    isPositive_(source.isPositive_) {
-}
-
-void ModelLink::mutateParams(int mutationProb, bool mutHillCoefSign, 
+bool ModelLink::mutateParams(int mutationProb, bool mutHillCoefSign, 
                              bool mutIsAndReg) {
+  bool mutated = false;
 
-  if (MathAlgo::rand100() < mutationProb)
+  if (MathAlgo::rand100() < mutationProb) {
     disConst_ = 0.01 + 99.99 * MathAlgo::rand01();
+    mutated = true;
+  }
 
   // mutates hill coefficient
   if (MathAlgo::rand100() < mutationProb) {
+    mutated = true;
     if (mutHillCoefSign) {
       if (MathAlgo::randBool())
         hillCoef_ = MathAlgo::rand110();
@@ -63,12 +58,17 @@ void ModelLink::mutateParams(int mutationProb, bool mutHillCoefSign,
     }
   }
 
-  if (mutIsAndReg && MathAlgo::rand100() < mutationProb)
+  if (mutIsAndReg && MathAlgo::rand100() < mutationProb) {
     isAndReg_ = !isAndReg_;
+    mutated = true;
+  }
 
-  if (MathAlgo::rand100() < mutationProb)
+  if (MathAlgo::rand100() < mutationProb) {
     isPositive_ = !isPositive_;
+    mutated = true;
+  }
 
+  return mutated;
 }
 
 // Serialization
@@ -7,12 +7,11 @@
 
 namespace LoboLab {
 
+// Plain record, copied by value in the arrays of Model
 class ModelLink {
  public:
    ModelLink(int regulator = 0, int regulated = 0, int isAndReg = -1);
    ModelLink(int regulator, int regulated, double lim, double disConst, double hillCoef, bool isAndReg, bool isPositive);
-  virtual ~ModelLink();
-  ModelLink(const ModelLink &source);
 
   inline int regulatorProdLabel() const { return regulator_; }
   inline int regulatedProdLabel() const { return regulated_; }
@@ -30,7 +29,8 @@ class ModelLink {
 
   inline int complexity() const { return 1; }
 
-  void mutateParams(int mutationProb, bool mutHillCoefSign, bool mutIsAndReg);
+  // Returns if any param changed
+  bool mutateParams(int mutationProb, bool mutHillCoefSign, bool mutIsAndReg);
 
   // Text Serialization
   void loadFromString(QString &str);
@@ -50,3 +50,5 @@ class ModelLink {
 };
 
 } // namespace LoboLab
+
+Q_DECLARE_TYPEINFO(LoboLab::ModelLink, Q_MOVABLE_TYPE);
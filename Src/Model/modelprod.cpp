@@ -40,36 +40,43 @@ ModelProd::ModelProd(int label, double init, double lim, double posLim, double n
   }
 }
 
-
-ModelProd::~ModelProd() {
+ModelProd::ModelProd(int label, double init, double lim, double posLim, 
+                     double negLim, double deg, double intrGrow, int type)
+  : label_(label), init_(init), lim_(lim), posLim_(posLim), negLim_(negLim),
+    deg_(deg), intrGrow_(intrGrow), type_(type) {
 }
 
-ModelProd::ModelProd(const ModelProd &source)
-  : label_(source.label_), init_(source.init_), lim_(source.lim_),
-   posLim_(source.posLim_), negLim_(source.negLim_),
-    deg_(source.deg_), intrGrow_(source.intrGrow_), type_(source.type_) {
-}
 
 int ModelProd::complexity() const {
   return 1;
 }
 
-void ModelProd::mutateParams(int mutationProb) {
+bool ModelProd::mutateParams(int mutationProb) {
+  bool mutated = false;
+
   // Change lim
-  if (MathAlgo::rand100() < mutationProb)
+  if (MathAlgo::rand100() < mutationProb) {
     lim_ = 100 * MathAlgo::rand01();
+    mutated = true;
+  }
 
-  if (MathAlgo::rand100() < mutationProb)
+  if (MathAlgo::rand100() < mutationProb) {
     posLim_ = 0.1 * MathAlgo::rand01();
-  if (MathAlgo::rand100() < mutationProb)
+    mutated = true;
+  }
+  if (MathAlgo::rand100() < mutationProb) {
     negLim_ = 0.1 * MathAlgo::rand01();
+    mutated = true;
+  }
 
   // Change deg
   if (MathAlgo::rand100() < mutationProb) {
     deg_ = 0.1 + 0.9 * MathAlgo::rand01();
     intrGrow_ = 0.01 * MathAlgo::rand01();
+    mutated = true;
 }
 
+  return mutated;
 }
 
 // Serialization
@@ -7,14 +7,16 @@
 
 namespace LoboLab {
 
+// Plain record, copied by value in the arrays of Model
 class ModelProd {
  public:
   explicit ModelProd(int label = 0, int type = 0); // Random product
 
   ModelProd(int label, double init, double lim, double posLim, double negLim, double deg, double intrGrow);
+  // Keeps the params as given, without drawing random numbers
+  ModelProd(int label, double init, double lim, double posLim, double negLim,
+            double deg, double intrGrow, int type);
 
-  virtual ~ModelProd();
-  ModelProd(const ModelProd &source);
 
   inline int label() const { return label_; }
   inline double init() const { return init_; }
@@ -35,7 +37,7 @@ class ModelProd {
   
   int complexity() const;
 
-  void mutateParams(int mutationProb);
+  bool mutateParams(int mutationProb); // Returns if any param changed
 
   // Text Serialization
   void loadFromString(QString &str);
@@ -58,3 +60,5 @@ class ModelProd {
 bool prodLabelLessThan(const ModelProd *p1, const ModelProd *p2);
 
 } // namespace LoboLab
+
+Q_DECLARE_TYPEINFO(LoboLab::ModelProd, Q_MOVABLE_TYPE);
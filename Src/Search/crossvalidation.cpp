@@ -0,0 +1,96 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "crossvalidation.h"
+#include "search.h"
+#include "searchexperiment.h"
+#include "individual.h"
+#include "Experiment/experiment.h"
+#include "DB/db.h"
+#include "Common/log.h"
+
+#include <random>
+
+namespace LoboLab {
+
+CrossValidation::CrossValidation(Search *search, int nFolds, 
+                                 unsigned int randSeed)
+  : search_(search), 
+    nFolds_(nFolds), 
+    randSeed_(randSeed),
+    datetime_(QDateTime::currentDateTimeUtc()),
+    ed_("CrossValidation") {
+  createFolds();
+}
+
+CrossValidation::~CrossValidation() {
+  int n = scores_.size();
+  for (int i = 0; i < n; ++i)
+    delete scores_.at(i);
+}
+
+// The experiments are shuffled with their own generator, so the same seed
+// always produces the same folds.
+void CrossValidation::createFolds() {
+  QList<Experiment*> experiments;
+  QList<SearchExperiment*> searchExperiments = search_->getExpList() + 
+    search_->searchExpPreds() + search_->searchExpOthers();
+  
+  int nExperiments = searchExperiments.size();
+  for (int i = 0; i < nExperiments; ++i)
+    experiments.append(searchExperiments.at(i)->experiment());
+
+  std::mt19937_64 randGen(randSeed_);
+  for (int i = nExperiments - 1; i > 0; --i)
+    experiments.swap(i, randGen() % (i + 1));
+
+  if (nFolds_ > nExperiments) {
+    Log::write() << "CrossValidation::createFolds: WARNING: only " << 
+      nExperiments << " experiments available for " << nFolds_ << 
+      " folds." << endl;
+    nFolds_ = nExperiments;
+  }
+
+  for (int iFold = 0; iFold < nFolds_; ++iFold) {
+    QList<Experiment*> train;
+    QList<Experiment*> test;
+    for (int i = 0; i < nExperiments; ++i) {
+      if (i % nFolds_ == iFold)
+        test.append(experiments.at(i));
+      else
+        train.append(experiments.at(i));
+    }
+
+    trainExperiments_.append(train);
+    testExperiments_.append(test);
+  }
+}
+
+void CrossValidation::addScore(Individual *individual, int iFold, 
+                               double trainError, double testError) {
+  scores_.append(new CrossValidationScore(this, individual, iFold, trainError,
+                                          testError));
+}
+
+// Persistence methods
+
+int CrossValidation::submit(DB *db) {
+  QPair<QString, DBElement*> refMember("Search", search_);
+
+  QHash<QString, QVariant> values;
+  values.insert("NumFolds", nFolds_);
+  values.insert("RandSeed", randSeed_);
+  values.insert("Datetime", datetime_.toString(DB::DatetimeFormat));
+
+  QHash<QString, DBElement*> members;
+
+  return ed_.submit(db, refMember, members, values, scores_);
+}
+
+bool CrossValidation::erase() {
+  QList<DBElement*> members;
+
+  return ed_.erase(members, scores_);
+}
+
+}
@@ -0,0 +1,72 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "DB/dbelementdata.h"
+#include "crossvalidationscore.h"
+
+#include <QList>
+#include <QDateTime>
+
+namespace LoboLab {
+
+class Search;
+class Experiment;
+class Individual;
+
+// K-fold partition of all the experiments of a search (training, prediction
+// and others) and the scores of a set of models on every fold.
+class CrossValidation : public DBElement {
+ public:
+  CrossValidation(Search *search, int nFolds, unsigned int randSeed);
+  ~CrossValidation();
+
+  inline Search *search() const { return search_; }
+  inline int nFolds() const { return nFolds_; }
+  inline unsigned int randSeed() const { return randSeed_; }
+  inline const QDateTime &datetime() const { return datetime_; }
+
+  inline const QList<Experiment*> &trainExperiments(int iFold) const {
+    return trainExperiments_.at(iFold);
+  }
+  inline const QList<Experiment*> &testExperiments(int iFold) const {
+    return testExperiments_.at(iFold);
+  }
+
+  inline const QList<CrossValidationScore*> &scores() const { return scores_; }
+  void addScore(Individual *individual, int iFold, double trainError,
+                double testError);
+
+  inline virtual int id() const { return ed_.id(); }
+  virtual int submit(DB *db);
+  virtual bool erase();
+
+ private:
+  CrossValidation(const CrossValidation &source);
+  CrossValidation &operator=(const CrossValidation &source);
+
+  void createFolds();
+
+  Search *search_;
+  int nFolds_;
+  unsigned int randSeed_;
+  QDateTime datetime_;
+
+  QList<QList<Experiment*> > trainExperiments_;
+  QList<QList<Experiment*> > testExperiments_;
+  QList<CrossValidationScore*> scores_;
+
+  DBElementData ed_;
+
+// Persistence fields
+ public:
+  enum {
+    FSearch = 1,
+    FNumFolds,
+    FRandSeed,
+    FDatetime
+  };
+};
+
+} // namespace LoboLab
@@ -0,0 +1,45 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "crossvalidationscore.h"
+#include "crossvalidation.h"
+#include "individual.h"
+
+namespace LoboLab {
+
+CrossValidationScore::CrossValidationScore(CrossValidation *cv, 
+                                           Individual *ind, int fold,
+                                           double trainError, 
+                                           double testError)
+  : crossValidation_(cv), individual_(ind), fold_(fold), 
+    trainError_(trainError), testError_(testError),
+    ed_("CrossValidationScore") {
+  Q_ASSERT(individual_);
+}
+
+CrossValidationScore::~CrossValidationScore() {
+}
+
+// Persistence methods
+
+int CrossValidationScore::submit(DB *db) {
+  QPair<QString, DBElement*> refMember("CrossValidation", crossValidation_);
+
+  int indId = individual_->id();
+  if (!indId)
+    indId = individual_->submit(db);
+
+  QHash<QString, QVariant> values;
+  values.insert("Individual", indId);
+  values.insert("Fold", fold_);
+  values.insert("TrainError", trainError_);
+  values.insert("TestError", testError_);
+
+  return ed_.submit(db, refMember, values);
+}
+
+bool CrossValidationScore::erase() {
+  return ed_.erase();
+}
+
+}
@@ -0,0 +1,55 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "DB/dbelementdata.h"
+
+namespace LoboLab {
+
+class CrossValidation;
+class Individual;
+
+class CrossValidationScore : public DBElement {
+  friend class CrossValidation;
+
+ public:
+  inline CrossValidation *crossValidation() const { return crossValidation_; }
+  inline Individual *individual() const { return individual_; }
+  inline int fold() const { return fold_; }
+  inline double trainError() const { return trainError_; }
+  inline double testError() const { return testError_; }
+
+ protected:
+  inline virtual int id() const { return ed_.id(); };
+  virtual int submit(DB *db);
+  virtual bool erase();
+
+ private:
+  CrossValidationScore(CrossValidation *cv, Individual *ind, int fold,
+                       double trainError, double testError);
+  ~CrossValidationScore();
+
+  CrossValidationScore(const CrossValidationScore &source);
+  CrossValidationScore &operator=(const CrossValidationScore &source);
+
+  CrossValidation *crossValidation_;
+  Individual *individual_;
+  int fold_;
+  double trainError_;
+  double testError_;
+
+  DBElementData ed_;
+
+// Persistence fields
+ public:
+  enum {
+    FCrossValidation = 1,
+    FIndividual,
+    FFold,
+    FTrainError,
+    FTestError
+  };
+};
+
+} // namespace LoboLab
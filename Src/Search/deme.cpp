@@ -15,10 +15,27 @@ Deme::Deme(Search *s)
     generations_.reserve(search_->searchParams()->nGenerations);
 }
 
-Deme::Deme(Search *s, const QHash<int, Individual*> &individualsIdMap, 
-           const DBElementData &ref)
+// The generations are loaded by the search, for all the demes at once
+Deme::Deme(Search *s, const DBElementData &ref)
     : search_(s), ed_("Deme", ref) {
-  load(individualsIdMap);
+  ed_.loadFinished();
+}
+
+// Restored from a checkpoint
+Deme::Deme(Search *s, QDataStream &stream, 
+           const QList<Individual*> &individuals,
+           QList<Generation*> *allGenerations, DB *db)
+    : search_(s), ed_("Deme", readId(stream), db) {
+  qint32 nGenerations;
+  stream >> nGenerations;
+
+  generations_.reserve(qMax(search_->searchParams()->nGenerations, 
+                            (int) nGenerations));
+  for (int i = 0; i < nGenerations; ++i) {
+    Generation *gen = new Generation(this, stream, individuals, db);
+    generations_.append(gen);
+    allGenerations->append(gen);
+  }
 }
 
 Deme::~Deme() {
@@ -39,22 +56,24 @@ Generation *Deme::createNextGeneration() {
   return gen;
 }
 
-// Persistence methods
-
-void Deme::load(const QHash<int, Individual*> &individualsIdMap) {
-  loadGenerations(individualsIdMap);
+// Checkpoints
 
-  ed_.loadFinished();
+int Deme::readId(QDataStream &stream) {
+  qint32 id;
+  stream >> id;
+  return id;
 }
 
-void Deme::loadGenerations(const QHash<int, Individual*> &individualsIdMap) {
-  ed_.loadReferences("Generation");
-  while (ed_.nextReference()) {
-    Generation *ele = new Generation(this, individualsIdMap, ed_);
-    generations_.append(ele);
-  }
+void Deme::writeState(QDataStream &stream, 
+                      const QHash<Individual*, int> &indIndexes) const {
+  int n = generations_.size();
+  stream << (qint32) id() << (qint32) n;
+  for (int i = 0; i < n; ++i)
+    generations_.at(i)->writeState(stream, indIndexes);
 }
 
+// Persistence methods
+
 int Deme::submit(DB *db) {
   QPair<QString, DBElement*> refMember("Search", search_);
 
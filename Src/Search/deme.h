@@ -5,6 +5,7 @@
 
 #include "DB/dbelementdata.h"
 #include <QDateTime>
+#include <QDataStream>
 
 namespace LoboLab {
 
@@ -28,15 +29,20 @@ class Deme : public DBElement {
   int submitShallow(DB *db);
   virtual bool erase();
 
+  // Checkpoints. The generations are appended to the list of all the
+  // generations, whose positions are referred by the individuals.
+  void writeState(QDataStream &stream, 
+                  const QHash<Individual*, int> &indIndexes) const;
+
  private:
   explicit Deme(Search *s);
-  Deme(Search *s, const QHash<int, Individual*> &individualsIdMap, 
-       const DBElementData &ref);
+  Deme(Search *s, QDataStream &stream, const QList<Individual*> &individuals, 
+       QList<Generation*> *allGenerations, DB *db);
+  Deme(Search *s, const DBElementData &ref); // Without the generations
   Deme(const Deme &source, Search *s = NULL, bool maintainId = true);
   Deme &operator=(const Deme &source);
 
-  void load(const QHash<int, Individual*> &individualsIdMap);
-  void loadGenerations(const QHash<int, Individual*> &individualsIdMap);
+  static int readId(QDataStream &stream);
 
   Search *search_;
   QList<Generation*> generations_;
@@ -12,4 +12,18 @@ ErrorCalculator::ErrorCalculator() {}
 
 ErrorCalculator::~ErrorCalculator() {}
 
+void ErrorCalculator::processChildPairs(int nDeme, ChildPairCreator *creator,
+                                        int nPairs) {
+  QList<Individual*> children;
+  children.reserve(2 * nPairs);
+  for (int i = 0; i < nPairs; ++i) {
+    Individual *child1, *child2;
+    creator->createChildPair(i, &child1, &child2);
+    children.append(child1);
+    children.append(child2);
+  }
+
+  process(nDeme, children);
+}
+
 }
\ No newline at end of file
@@ -10,6 +10,16 @@ namespace LoboLab {
 class Search;
 class Individual;
 
+// Creates pairs of children, possibly at the same time in several threads
+class ChildPairCreator {
+ public:
+  virtual ~ChildPairCreator() {}
+
+  virtual void createChildPair(int iPair, Individual **child1, 
+                               Individual **child2) = 0;
+  virtual double expectedChildPairSimTime(int iPair) const = 0;
+};
+
 class ErrorCalculator {
 
  public:
@@ -17,6 +27,10 @@ class ErrorCalculator {
   virtual ~ErrorCalculator();
 
   virtual void process(int nDeme, const QList<Individual*> &individuals) = 0;
+  // The children are created and evaluated in the same job. By default, they
+  // are created in the calling thread.
+  virtual void processChildPairs(int nDeme, ChildPairCreator *creator, 
+                                 int nPairs);
   virtual int waitForAnyDeme() = 0;
 };
 
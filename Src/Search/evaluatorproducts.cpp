@@ -21,6 +21,10 @@ EvaluatorProducts::EvaluatorProducts(const Search &search)
   localDistErrorThreshold_ = search_.simParams()->localDistErrThreshold();
   expDistErrorThreshold_ = search_.simParams()->expDistErrThreshold();
   globalDistErrorThreshold_ = search_.simParams()->globalDistErrThreshold();
+
+  int nExperiments = search_.nExperiments();
+  for (int i = 0; i < nExperiments; ++i)
+    experimentChecksums_.append(search_.experiment(i)->checksum());
 }
 
 EvaluatorProducts::~EvaluatorProducts() {
@@ -49,7 +53,11 @@ QHash<int, double> EvaluatorProducts::createErrorTable(const Model &model, doubl
   return errorTable;
 }
 
-double EvaluatorProducts::evaluate(const Model &model, double maxError) {
+// The contributions of the experiments simulated before stopping are 
+// appended to contributions, if given, in the order of the search, so they
+// can be stored for rescoring. An experiment that fails is not included.
+double EvaluatorProducts::evaluate(const Model &model, double maxError,
+                                   QList<double> *contributions) {
   loadModel(model);
   double error = 0.0;
   int nExperiments = search_.nExperiments();
@@ -58,6 +66,32 @@ double EvaluatorProducts::evaluate(const Model &model, double maxError) {
     double experimentError = calcExperimentError(*search_.experiment(i));
     if (experimentError < 0.0) return experimentError;  // Error in the simulator
 
+    experimentError = std::max(0.0, experimentError - expDistErrorThreshold_);
+    if (contributions)
+      contributions->append(experimentError);
+    error += experimentError / nExperiments;
+    ++i;
+  }
+
+  error = std::max(0.0, error - globalDistErrorThreshold_);
+
+  return error;
+
+}
+
+// Same error as evaluate(), but over an arbitrary subset of experiments (for
+// example, the folds of a cross-validation).
+double EvaluatorProducts::evaluate(const Model &model, 
+                                   const QList<Experiment*> &experiments,
+                                   double maxError) {
+  loadModel(model);
+  double error = 0.0;
+  int nExperiments = experiments.size();
+  int i = 0;
+  while (i < nExperiments && (error - globalDistErrorThreshold_) <= maxError) {
+    double experimentError = calcExperimentError(*experiments.at(i));
+    if (experimentError < 0.0) return experimentError;  // Error in the simulator
+
     experimentError = std::max(0.0, experimentError - expDistErrorThreshold_);
     error += experimentError / nExperiments;
     ++i;
@@ -66,7 +100,33 @@ double EvaluatorProducts::evaluate(const Model &model, double maxError) {
   error = std::max(0.0, error - globalDistErrorThreshold_);
 
   return error;
+}
+
+// Error of one experiment as it enters the mean computed by evaluate(). The 
+// model must be loaded. Negative values are simulator errors.
+double EvaluatorProducts::calcExperimentContribution(const Experiment &exp) {
+  double experimentError = calcExperimentError(exp);
+  if (experimentError < 0.0) return experimentError;  // Error in the simulator
+
+  return std::max(0.0, experimentError - expDistErrorThreshold_);
+}
 
+// Combines the contributions of all the experiments into the error returned
+// by evaluate(), so that stored contributions can be reused.
+double EvaluatorProducts::combineContributions(
+    const QList<double> &contributions) const {
+  double error = 0.0;
+  int nExperiments = contributions.size();
+  for (int i = 0; i < nExperiments; ++i) {
+    double contribution = contributions.at(i);
+    if (contribution < 0.0) return contribution;  // Error in the simulator
+
+    error += contribution / nExperiments;
+  }
+
+  error = std::max(0.0, error - globalDistErrorThreshold_);
+
+  return error;
 }
 
 double EvaluatorProducts::calcExperimentError(const Experiment &exp) {
@@ -19,18 +19,31 @@ class EvaluatorProducts {
   ~EvaluatorProducts();
 
   const Search &search() const {return search_;}
+  // Checksums of the experiments of the search, in the same order
+  inline const QList<QByteArray> &experimentChecksums() const {
+    return experimentChecksums_;
+  }
 
   void loadModel(const Model &model);
-  double evaluate(const Model &model, double maxError);
+  inline void setBudget(qint64 maxRateEvals, qint64 maxMsecs) {
+    simulator_.setBudget(maxRateEvals, maxMsecs);
+  }
+  double evaluate(const Model &model, double maxError,
+                  QList<double> *contributions = NULL);
+  double evaluate(const Model &model, const QList<Experiment*> &experiments,
+                  double maxError);
   QHash<int, double> createErrorTable(const Model &model, double maxError);
   double calcDistance(const SimState &state, const QHash<int, int> &labelsInd, 
                       const Experiment& exp) const;
   double calcExperimentError(const Experiment &exp);
+  double calcExperimentContribution(const Experiment &exp);
+  double combineContributions(const QList<double> &contributions) const;
   double calcDistance(const SimState &state, const Phenotype &phenotype) const;
 
  private:
   const Search &search_;
   Simulator simulator_;
+  QList<QByteArray> experimentChecksums_;
 
   double localDistErrorThreshold_;
   double expDistErrorThreshold_;
@@ -5,6 +5,7 @@
 #include "deme.h"
 #include "individual.h"
 #include "Model/model.h"
+#include "DB/db.h"
 #include "Common/log.h"
 #include <iostream>
 
@@ -21,15 +22,35 @@ Generation::Generation(Deme *d, int i)
     meanComp_(0),
     maxComp_(-1),
     bestComp_(1e100),
+    nTimeouts_(0),
     ed_("Generation") {
 }
 
-Generation::Generation(Deme *d,
-                       const QHash<int, Individual*> &individualsIdMap, 
-                       const DBElementData &ref)
+// The individuals are added by the search, for all the generations at once
+Generation::Generation(Deme *d, const DBElementData &ref)
     : deme_(d), 
       ed_("Generation", ref) {
-  load(individualsIdMap);
+  load();
+}
+
+// Restored from a checkpoint. The links to the individuals are restored
+// by the individuals themselves.
+Generation::Generation(Deme *d, QDataStream &stream,
+                       const QList<Individual*> &individuals, DB *db)
+    : deme_(d), 
+      ed_("Generation", readId(stream), db) {
+  qint32 ind, time, nTimeouts, nInds;
+  stream >> ind >> time >> minFit_ >> meanFit_ >> maxFit_ >> minComp_ >> 
+    meanComp_ >> maxComp_ >> bestComp_ >> nTimeouts >> nInds;
+  ind_ = ind;
+  time_ = time;
+  nTimeouts_ = nTimeouts;
+
+  for (int i = 0; i < nInds; ++i) {
+    qint32 iInd;
+    stream >> iInd;
+    individuals_.append(individuals.at(iInd));
+  }
 }
 
 Generation::~Generation() {}
@@ -39,22 +60,34 @@ void Generation::addIndividual(Individual *ind) {
   ind->addedToGeneration(this);
 }
 
-void Generation::calcPopulSta() {
+void Generation::replaceIndividual(int i, Individual *ind) {
+  individuals_[i] = ind;
+  ind->addedToGeneration(this);
+}
 
+// The individuals that exceeded the simulation budget, or whose simulation
+// failed, have no real error, so they are left out of the error statistics.
+// If all of them did, the error statistics are the timeout error.
+void Generation::calcPopulSta() {
+  int nScored = 0;
   int n = individuals_.size();
   for (int i = 0; i < n; ++i) {
-    double fit = individuals_.at(i)->error();
-    int comp = individuals_.at(i)->complexity();
-
-    meanFit_ += fit;
-    if (fit < minFit_) {
-      minFit_ = fit;
-      bestComp_ = comp;
-    } else if (fit == minFit_ && comp < bestComp_) {
-      bestComp_ = comp;
+    Individual *ind = individuals_.at(i);
+    double fit = ind->error();
+    int comp = ind->complexity();
+
+    if (!ind->timedOut() && fit < Individual::TimeoutError) {
+      ++nScored;
+      meanFit_ += fit;
+      if (fit < minFit_) {
+        minFit_ = fit;
+        bestComp_ = comp;
+      } else if (fit == minFit_ && comp < bestComp_) {
+        bestComp_ = comp;
+      }
+      if (fit > maxFit_)
+        maxFit_ = fit;
     }
-    if (fit > maxFit_)
-      maxFit_ = fit;
 
     meanComp_ += comp;
     if (comp < minComp_)
@@ -63,30 +96,51 @@ void Generation::calcPopulSta() {
       maxComp_ = comp;
   }
 
-  meanFit_ /= n;
+  if (nScored > 0) {
+    meanFit_ /= nScored;
+  } else {
+    minFit_ = Individual::TimeoutError;
+    meanFit_ = Individual::TimeoutError;
+    maxFit_ = Individual::TimeoutError;
+  }
   meanComp_ /= n;
 }
 
+// Checkpoints
+
+int Generation::readId(QDataStream &stream) {
+  qint32 id;
+  stream >> id;
+  return id;
+}
+
+void Generation::writeState(QDataStream &stream, 
+                            const QHash<Individual*, int> &indIndexes) const {
+  stream << (qint32) id() << (qint32) ind_ << (qint32) time_ << minFit_ << 
+    meanFit_ << maxFit_ << minComp_ << meanComp_ << maxComp_ << bestComp_ << 
+    (qint32) nTimeouts_;
+
+  int n = individuals_.size();
+  stream << (qint32) n;
+  for (int i = 0; i < n; ++i)
+    stream << (qint32) indIndexes.value(individuals_.at(i));
+}
+
 // Persistence methods
 
-void Generation::load(const QHash<int, Individual*> &individualsIdMap) {
+void Generation::load() {
   ind_ = ed_.loadValue(FInd).toInt();
   time_ = ed_.loadValue(FTime).toInt();
-
-  loadGenerationIndividuals(individualsIdMap);
+  nTimeouts_ = ed_.loadValue(FNTimeouts).toInt();
 
   ed_.loadFinished();
 }
 
-void Generation::loadGenerationIndividuals(
-  const QHash<int, Individual*> &individualsIdMap) {
-  ed_.loadReferences("GenerationIndividual");
-  while (ed_.nextReference()) {
-    Individual *ind = individualsIdMap.value(
-                        ed_.loadRefValue(GenerationIndividual::FIndividual).toInt());
-    individuals_.append(ind);
-    ind->addedToGeneration(this, ed_);
-  }
+// The reference is the row of the generation individual
+void Generation::addLoadedIndividual(Individual *ind, 
+                                     const DBElementData &ref) {
+  individuals_.append(ind);
+  ind->addedToGeneration(this, ref);
 }
 
 int Generation::submit(DB *db) {
@@ -102,6 +156,7 @@ int Generation::submit(DB *db) {
   values.insert("MeanComp", meanComp_);
   values.insert("MaxComp", maxComp_);
   values.insert("BestComp", bestComp_);
+  values.insert("NTimeouts", nTimeouts_);
 
   QHash<QString, DBElement*> members;
 
@@ -121,10 +176,24 @@ int Generation::submitWithIndividuals(DB *db) {
   values.insert("MeanComp", meanComp_);
   values.insert("MaxComp", maxComp_);
   values.insert("BestComp", bestComp_);
+  values.insert("NTimeouts", nTimeouts_);
 
   QHash<QString, DBElement*> members;
 
-  return ed_.submit(db, refMember, members, values, individuals_);
+  db->beginTransaction();
+  int id = ed_.submit(db, refMember, members, values);
+  bool ok = id && Individual::submitNew(db, individuals_);
+  if (ok)
+    ok = db->endTransaction();
+  else {
+    Log::write() << "Generation::submitWithIndividuals: error: " <<
+                 db->lastError().text() << endl;
+    db->rollbackTransaction();
+    Q_ASSERT(false);
+    id = 0;
+  }
+
+  return id;
 }
 
 bool Generation::erase() {
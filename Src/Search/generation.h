@@ -5,6 +5,7 @@
 
 #include "DB/dbelementdata.h"
 #include "generationindividual.h"
+#include <QDataStream>
 
 namespace LoboLab {
 
@@ -27,32 +28,42 @@ class Generation : public DBElement {
   inline int ind() const { return ind_; }
   inline int time() const { return time_; }
   inline void setTime(int time) { time_ = time; }
+  inline int nTimeouts() const { return nTimeouts_; }
+  inline void setNTimeouts(int nTimeouts) { nTimeouts_ = nTimeouts; }
 
   void calcPopulSta();
 
   void addIndividual(Individual *ind);
+  void replaceIndividual(int i, Individual *ind);
 
   inline virtual int id() const { return ed_.id(); }
   virtual int submit(DB *db);
   virtual int submitWithIndividuals(DB *db);
   virtual bool erase();
 
+  // Checkpoints. The individuals are written as indexes in the checkpoint.
+  void writeState(QDataStream &stream, 
+                  const QHash<Individual*, int> &indIndexes) const;
+
  private:
   Generation(Deme *d, int ind);
-  Generation(Deme *d, const QHash<int, Individual*> &individualsIdMap,
-             const DBElementData &ref);
+  Generation(Deme *d, QDataStream &stream, 
+             const QList<Individual*> &individuals, DB *db);
+  Generation(Deme *d, const DBElementData &ref); // Without the individuals
   Generation(const Generation &source);
   Generation &operator=(const Generation &source);
 
-  void load(const QHash<int, Individual*> &individualsIdMap);
-  void loadGenerationIndividuals(
-    const QHash<int, Individual*> &individualsIdMap);
+  void load();
+  static int readId(QDataStream &stream);
+  void addLoadedIndividual(Individual *ind, const DBElementData &ref);
 
   Deme *deme_;
   int ind_;
   int time_;
   double minFit_, meanFit_, maxFit_;
   double minComp_, meanComp_, maxComp_, bestComp_;  
+  int nTimeouts_; // Individuals evaluated for this generation that exceeded
+                  // the simulation budget
   QList<Individual*> individuals_;
 
   DBElementData ed_;
@@ -69,7 +80,8 @@ class Generation : public DBElement {
     FMinComp,
     FMeanComp,
     FMaxComp,
-    FBestComp
+    FBestComp,
+    FNTimeouts
   };
 };
 
@@ -21,6 +21,14 @@ GenerationIndividual::GenerationIndividual(Generation *g, Individual *i,
   load();
 }
 
+// Restored from a checkpoint, without loading
+GenerationIndividual::GenerationIndividual(Generation *g, Individual *i, 
+                                           int id, DB *db)
+  : generation_(g), individual_(i), rank_(-1), crowdDist_(-1),
+    ed_("GenerationIndividual", id, db) {
+  Q_ASSERT(individual_);
+}
+
 GenerationIndividual::~GenerationIndividual() {
 }
 
@@ -48,16 +56,20 @@ void GenerationIndividual::load() {
 int GenerationIndividual::submit(DB *db) {
   QPair<QString, DBElement*> refMember("Generation", generation_);
 
-  int indId = individual_->id();
-  if (!indId)
-    indId = individual_->submit(db);
+  if (!individual_->id())
+    individual_->submit(db);
+
+  return ed_.submit(db, refMember, submitValues());
+}
 
+// Without the generation, which submit() adds as the reference
+QHash<QString, QVariant> GenerationIndividual::submitValues() const {
   QHash<QString, QVariant> values;
-  values.insert("Individual", indId);
+  values.insert("Individual", individual_->id());
   if (rank_ > -1) values.insert("Rank", rank_);
   if (crowdDist_ > -1) values.insert("CrowdDist", crowdDist_);
 
-  return ed_.submit(db, refMember, values);
+  return values;
 }
 
 bool GenerationIndividual::erase() {
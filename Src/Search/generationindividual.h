@@ -36,6 +36,7 @@ class GenerationIndividual : public DBElement {
   GenerationIndividual(Generation *g, Individual *i);
   GenerationIndividual(Generation *g, Individual *i,
                        const DBElementData &ref);
+  GenerationIndividual(Generation *g, Individual *i, int id, DB *db);
   ~GenerationIndividual();
 
   GenerationIndividual(const GenerationIndividual &source,
@@ -47,6 +48,7 @@ class GenerationIndividual : public DBElement {
   void setIndividual(Individual *newIndividual);
 
   void load();
+  QHash<QString, QVariant> submitValues() const;
 
   Generation *generation_;
   Individual *individual_;
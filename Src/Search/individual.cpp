@@ -3,31 +3,39 @@
 
 #include "individual.h"
 #include "generation.h"
+#include "individualexperimenterror.h"
 #include "search.h"
+#include "Experiment/experiment.h"
 #include "Model/model.h"
 #include "DB/db.h"
 #include "Common/mathalgo.h"
 
 namespace LoboLab {
 
+const double Individual::TimeoutError = 1e9;
+
 Individual::Individual(Model *dm, const Individual *parent1, 
                        const Individual *parent2)
+  : Individual(dm, parent1, parent2, parent1 ? parent1->id() : -1, 
+               parent2 ? parent2->id() : -1) {
+}
+
+Individual::Individual(Model *dm, const Individual *parent1, 
+                       const Individual *parent2, int parent1Id, 
+                       int parent2Id)
   : model_(dm), 
     error_(-1),
     simTime_(-1), 
+    timedOut_(false),
+    parent1Id_(parent1Id),
+    parent2Id_(parent2Id),
     ed_("Individual") {
-  if (parent1) { 
-    parent1Id_ = parent1->id();
+  if (parent1)
     parentError_ = parent1->error();
-  } else {
-    parent1Id_ = -1;
+  else
     parentError_ = 1000000;
-  }
 
-  if (parent2)
-    parent2Id_ = parent2->id();
-  else
-    parent2Id_ = -1;
+  parentSimTimePerComp_ = calcSimTimePerComp(parent1, parent2);
 
   
   modelComplexity_ = model_->calcComplexityInUse();
@@ -43,9 +51,28 @@ Individual::Individual(int id, DB *db)
   load();
 }
 
+Individual::Individual(QDataStream &stream, DB *db)
+  : ed_("Individual", readId(stream), db) {
+  QByteArray modelBin;
+  qint32 complexity, parent1Id, parent2Id;
+  stream >> modelBin >> complexity >> error_ >> simTime_ >> timedOut_ >>
+    parent1Id >> parent2Id >> parentError_ >> parentSimTimePerComp_;
+
+  model_ = new Model();
+  model_->loadFromBinary(modelBin);
+  modelComplexity_ = complexity;
+  parent1Id_ = parent1Id;
+  parent2Id_ = parent2Id;
+}
+
 
 Individual::~Individual() {
   clearGenerationIndividuals();
+
+  int n = experimentErrors_.size();
+  for (int i = 0; i < n; ++i)
+    delete experimentErrors_.at(i);
+
   delete model_;
 }
 
@@ -61,6 +88,7 @@ Individual::Individual(const Individual &source, bool maintainId)
   : modelComplexity_(source.modelComplexity_),
     error_(source.error_), 
     simTime_(source.simTime_), 
+    timedOut_(source.timedOut_),
     ed_(source.ed_, maintainId) {
   model_ = new Model(*source.model_);
 
@@ -68,13 +96,27 @@ Individual::Individual(const Individual &source, bool maintainId)
     parent1Id_ = source.parent1Id_;
     parent2Id_ = source.parent2Id_;
     parentError_ = source.parentError_;
+    parentSimTimePerComp_ = source.parentSimTimePerComp_;
   } else {
     parent1Id_ = source.id(); 
     parent2Id_ = 0;
     parentError_ = source.error();
+    parentSimTimePerComp_ = calcSimTimePerComp(&source);
   }
 }
 
+void Individual::setExperimentErrors(const Search &search,
+                                     const QList<QByteArray> &checksums,
+                                     const QList<double> &contributions) {
+  if (id() > 0 || !experimentErrors_.isEmpty()) // Saved or set before
+    return;
+
+  int n = contributions.size();
+  for (int i = 0; i < n; ++i)
+    experimentErrors_.append(new IndividualExperimentError(this, 
+      search.experiment(i)->id(), checksums.at(i), contributions.at(i)));
+}
+
 GenerationIndividual *Individual::addedToGeneration(Generation *generation) {
   GenerationIndividual *gi = new GenerationIndividual(generation, this);
   generationIndividuals_.append(gi);
@@ -90,6 +132,47 @@ GenerationIndividual *Individual::addedToGeneration(Generation *generation,
   return gi;
 }
 
+// The simulation time is roughly proportional to the complexity of the model,
+// so the cost of a child is predicted from the time per complexity unit of 
+// its parents. Returns -1 if there is no prediction.
+double Individual::expectedSimTime() const {
+  if (parentSimTimePerComp_ < 0)
+    return -1;
+  else
+    return parentSimTimePerComp_ * MathAlgo::max(1, modelComplexity_);
+}
+
+double Individual::expectedChildSimTime(const Individual *parent1,
+                                        const Individual *parent2,
+                                        int complexity) {
+  double simTimePerComp = calcSimTimePerComp(parent1, parent2);
+  if (simTimePerComp < 0)
+    return -1;
+  else
+    return simTimePerComp * MathAlgo::max(1, complexity);
+}
+
+double Individual::calcSimTimePerComp(const Individual *parent1,
+                                      const Individual *parent2) {
+  double simTimePerComp = 0;
+  int nParents = 0;
+
+  const Individual *parents[2] = {parent1, parent2};
+  for (int i = 0; i < 2; ++i) {
+    const Individual *parent = parents[i];
+    if (parent && parent->simTime_ > 0) {
+      simTimePerComp += parent->simTime_ / 
+                        MathAlgo::max(1, parent->modelComplexity_);
+      ++nParents;
+    }
+  }
+
+  if (nParents)
+    return simTimePerComp / nParents;
+  else
+    return -1;
+}
+
 bool Individual::dominates(const Individual *other) const {
     return (error_ < other->error_ && 
             modelComplexity_ <= other->modelComplexity_) ||
@@ -97,39 +180,170 @@ bool Individual::dominates(const Individual *other) const {
             error_ <= other->error_);
 }
 
+// Checkpoints
+
+int Individual::readId(QDataStream &stream) {
+  qint32 id;
+  stream >> id;
+  return id;
+}
+
+void Individual::writeState(QDataStream &stream) const {
+  stream << (qint32) id() << model_->toBinary() << (qint32) modelComplexity_ << 
+    error_ << simTime_ << timedOut_ << (qint32) parent1Id_ << 
+    (qint32) parent2Id_ << parentError_ << parentSimTimePerComp_;
+}
+
+void Individual::writeGenerationsState(QDataStream &stream, 
+    const QHash<Generation*, int> &genIndexes) const {
+  QList<GenerationIndividual*> genInds;
+  int n = generationIndividuals_.size();
+  for (int i = 0; i < n; ++i)
+    if (genIndexes.contains(generationIndividuals_.at(i)->generation()))
+      genInds.append(generationIndividuals_.at(i));
+
+  n = genInds.size();
+  stream << (qint32) n;
+  for (int i = 0; i < n; ++i) {
+    GenerationIndividual *gi = genInds.at(i);
+    stream << (qint32) genIndexes.value(gi->generation()) << 
+      (qint32) gi->id() << (qint32) gi->rank() << gi->crowdDist();
+  }
+}
+
+void Individual::readGenerationsState(QDataStream &stream, 
+                                      const QList<Generation*> &generations,
+                                      DB *db) {
+  qint32 n;
+  stream >> n;
+  for (int i = 0; i < n; ++i) {
+    qint32 iGeneration, id, rank;
+    double crowdDist;
+    stream >> iGeneration >> id >> rank >> crowdDist;
+
+    GenerationIndividual *gi = new GenerationIndividual(
+                                  generations.at(iGeneration), this, id, db);
+    gi->setRank(rank);
+    gi->setCrowdDist(crowdDist);
+    generationIndividuals_.append(gi);
+  }
+}
+
 // Persistence methods
 
 void Individual::load() {
+  // The rows written before the binary column only have the text
   model_ = new Model();
-  QString modelStr = ed_.loadValue(FModel).toString();
-  model_->loadFromString(modelStr);
+  QByteArray modelBin = ed_.loadValue(FModelBin).toByteArray();
+  if (modelBin.isEmpty() || !model_->loadFromBinary(modelBin)) {
+    QString modelStr = ed_.loadValue(FModel).toString();
+    model_->loadFromString(modelStr);
+  }
   modelComplexity_ = model_->calcComplexity();
 
   error_ = ed_.loadValue(FError).toDouble();
   simTime_ = ed_.loadValue(FSimTime).toDouble();
+  timedOut_ = ed_.loadValue(FTimedOut).toBool();
   parent1Id_ = ed_.loadValue(FParent1).toInt();
   parent2Id_ = ed_.loadValue(FParent2).toInt();
   parentError_ = -1;
+  parentSimTimePerComp_ = -1;
 
   ed_.loadFinished();
 }
 
+// The experiment errors are only inserted, since they do not change
 int Individual::submit(DB *db) {
+  int id = ed_.submit(db, submitValues(), generationIndividuals_);
+
+  int n = experimentErrors_.size();
+  for (int i = 0; id && i < n; ++i) {
+    IndividualExperimentError *expError = experimentErrors_.at(i);
+    if (expError->id() == 0 || expError->ed_.db() != db)
+      expError->submit(db);
+  }
+
+  return id;
+}
+
+QHash<QString, QVariant> Individual::submitValues() const {
   QHash<QString, QVariant> values;
   values.insert("Model", model_->toString());
+  values.insert("ModelBin", model_->toBinary());
   values.insert("Complexity", modelComplexity_);
   values.insert("Error", error_);
   values.insert("SimTime", simTime_);
+  values.insert("TimedOut", timedOut_);
   values.insert("Parent1", parent1Id_ > -1 ? parent1Id_ : QVariant());
   values.insert("Parent2", parent2Id_ > -1 ? parent2Id_ : QVariant());
 
-  return ed_.submit(db, values, generationIndividuals_);
+  return values;
+}
+
+// Inserts the individuals not saved yet in one batch, then their experiment 
+// errors, and then their generation individuals not saved yet whose 
+// generation is saved. The individuals already saved are not updated, since
+// they do not change after being evaluated.
+bool Individual::submitNew(DB *db, const QList<Individual*> &individuals) {
+  QList<DBElementData*> newInds;
+  QList<QHash<QString, QVariant> > indValues;
+  int n = individuals.size();
+  for (int i = 0; i < n; ++i) {
+    Individual *ind = individuals.at(i);
+    if (ind->id() == 0 || ind->ed_.db() != db) {
+      newInds.append(&ind->ed_);
+      indValues.append(ind->submitValues());
+    }
+  }
+
+  bool ok = DBElementData::submitNew(db, newInds, indValues);
+
+  QList<DBElementData*> newExpErrors;
+  QList<QHash<QString, QVariant> > expErrorValues;
+  for (int i = 0; ok && i < n; ++i) {
+    Individual *ind = individuals.at(i);
+    int nExpErrors = ind->experimentErrors_.size();
+    for (int j = 0; j < nExpErrors; ++j) {
+      IndividualExperimentError *expError = ind->experimentErrors_.at(j);
+      if (expError->id() == 0 || expError->ed_.db() != db) {
+        newExpErrors.append(&expError->ed_);
+        QHash<QString, QVariant> values = expError->submitValues();
+        values.insert("Individual", ind->id());
+        expErrorValues.append(values);
+      }
+    }
+  }
+
+  if (ok)
+    ok = DBElementData::submitNew(db, newExpErrors, expErrorValues);
+
+  QList<DBElementData*> newGenInds;
+  QList<QHash<QString, QVariant> > genIndValues;
+  for (int i = 0; ok && i < n; ++i) {
+    const QList<GenerationIndividual*> &genInds = 
+      individuals.at(i)->generationIndividuals_;
+    int nGenInds = genInds.size();
+    for (int j = 0; j < nGenInds; ++j) {
+      GenerationIndividual *gi = genInds.at(j);
+      if ((gi->id() == 0 || gi->ed_.db() != db) && gi->generation()->id()) {
+        newGenInds.append(&gi->ed_);
+        QHash<QString, QVariant> values = gi->submitValues();
+        values.insert("Generation", gi->generation()->id());
+        genIndValues.append(values);
+      }
+    }
+  }
+
+  if (ok)
+    ok = DBElementData::submitNew(db, newGenInds, genIndValues);
+
+  return ok;
 }
 
 bool Individual::erase() {
   QList<DBElement*> members;
 
-  return ed_.erase(members, generationIndividuals_);
+  return ed_.erase(members, generationIndividuals_, experimentErrors_);
 }
 
 bool indErrorLessThan(Individual *i1, Individual *i2) {
@@ -142,4 +356,17 @@ bool indErrorComplexityLessThan(Individual *i1, Individual *i2) {
           i1->complexity() < i2->complexity());
 }
 
+// Individuals without a prediction go first, the most complex first
+bool indExpectedSimTimeGreaterThan(Individual *i1, Individual *i2) {
+  double t1 = i1->expectedSimTime();
+  double t2 = i2->expectedSimTime();
+
+  if (t1 < 0 && t2 < 0)
+    return i1->complexity() > i2->complexity();
+  else if (t1 < 0 || t2 < 0)
+    return t1 < 0;
+  else
+    return t1 > t2;
+}
+
 }
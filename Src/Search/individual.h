@@ -5,12 +5,15 @@
 
 #include "DB/dbelementdata.h"
 #include "Model/model.h"
+#include <QDataStream>
 
 namespace LoboLab {
 
 class Evolution;
 class Generation;
 class GenerationIndividual;
+class IndividualExperimentError;
+class Search;
 
 class Individual : public DBElement {
   friend class Generation;
@@ -18,18 +21,41 @@ class Individual : public DBElement {
  public:
   Individual(Model *dm, const Individual *parent1 = NULL, 
              const Individual *parent2 = NULL);
+  // With the ids of the parents read before, since a parent may be saved
+  // for the first time by another thread meanwhile
+  Individual(Model *dm, const Individual *parent1, const Individual *parent2,
+             int parent1Id, int parent2Id);
   Individual(int id, DB *db);
   explicit Individual(const DBElementData &ref);
   Individual(const Individual &source, bool maintainId = true);
+  Individual(QDataStream &stream, DB *db); // From a checkpoint
   ~Individual();
 
   inline Model *model() const { return model_; }
   inline double error() const { return error_; }
   inline int complexity() const { return modelComplexity_; }
   inline double parentError() const { return parentError_; }
+  inline double simTime() const { return simTime_; }
+  inline bool timedOut() const { return timedOut_; }
+  double expectedSimTime() const;
+  // Prediction of expectedSimTime() for a child of the parents with the 
+  // given complexity, before it is created
+  static double expectedChildSimTime(const Individual *parent1, 
+                                     const Individual *parent2, 
+                                     int complexity);
+
+  // Error assigned to the individuals that exceed the simulation budget
+  static const double TimeoutError;
 
   inline void setError(double error) { error_ = error; }
   inline void setSimTime(double simTime) { simTime_ = simTime; }
+  inline void setTimedOut(bool timedOut) { timedOut_ = timedOut; }
+  // Contributions of the first experiments of the search to the error, as
+  // calculated by the evaluator, stored for rescoring when the individual is
+  // saved for the first time. Ignored if the individual is already saved.
+  void setExperimentErrors(const Search &search, 
+                           const QList<QByteArray> &checksums,
+                           const QList<double> &contributions);
 
   void clearGenerationIndividuals();
 
@@ -41,6 +67,14 @@ class Individual : public DBElement {
 
   inline QList<GenerationIndividual*> getGenerations() const {return generationIndividuals_;}
 
+  // Checkpoints. The generations are written separately, since they refer
+  // to the individuals. Only the generations indexed are written.
+  void writeState(QDataStream &stream) const;
+  void writeGenerationsState(QDataStream &stream, 
+                             const QHash<Generation*, int> &genIndexes) const;
+  void readGenerationsState(QDataStream &stream, 
+                            const QList<Generation*> &generations, DB *db);
+
  private:
   Individual &operator=(const Individual &source);
 
@@ -48,16 +82,25 @@ class Individual : public DBElement {
   GenerationIndividual *addedToGeneration(Generation *generation,
                                           const DBElementData &ref);
   void load();
+  QHash<QString, QVariant> submitValues() const;
+  static bool submitNew(DB *db, const QList<Individual*> &individuals);
+  static int readId(QDataStream &stream);
+
+  static double calcSimTimePerComp(const Individual *parent1,
+                                   const Individual *parent2 = NULL);
 
   Model *model_;
   int modelComplexity_;
   double error_;
   double simTime_;
+  bool timedOut_;
   int parent1Id_;
   int parent2Id_;
   double parentError_;
+  double parentSimTimePerComp_; // Used to predict the cost of new individuals
 
   QList<GenerationIndividual*> generationIndividuals_;
+  QList<IndividualExperimentError*> experimentErrors_;
 
   DBElementData ed_;
 
@@ -69,11 +112,14 @@ class Individual : public DBElement {
     FError,
     FSimTime,
     FParent1,
-    FParent2
+    FParent2,
+    FModelBin,
+    FTimedOut
   };
 };
 
 bool indErrorLessThan(Individual *i1, Individual *i2);
 bool indErrorComplexityLessThan(Individual *i1, Individual *i2);
+bool indExpectedSimTimeGreaterThan(Individual *i1, Individual *i2);
 
 } // namespace LoboLab
@@ -0,0 +1,78 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "individualerrortable.h"
+#include "individualexperimenterror.h"
+#include "individual.h"
+
+namespace LoboLab {
+
+// The table is persisted as references to the individual, so the element 
+// data refers to the individual row.
+IndividualErrorTable::IndividualErrorTable(Individual *individual, DB *db)
+  : individual_(individual),
+    ed_("Individual", individual->id(), db) {
+  load();
+}
+
+IndividualErrorTable::~IndividualErrorTable() {
+  for (QHash<int, IndividualExperimentError*>::const_iterator i = 
+       errors_.constBegin(); i != errors_.constEnd(); ++i)
+    delete i.value();
+}
+
+bool IndividualErrorTable::isUpToDate(int experimentId, 
+                                      const QByteArray &checksum) const {
+  IndividualExperimentError *expError = errors_.value(experimentId);
+  return expError && expError->checksum() == checksum;
+}
+
+double IndividualErrorTable::error(int experimentId) const {
+  IndividualExperimentError *expError = errors_.value(experimentId);
+  Q_ASSERT(expError);
+
+  return expError->error();
+}
+
+void IndividualErrorTable::setError(int experimentId, 
+                                    const QByteArray &checksum, double error) {
+  IndividualExperimentError *expError = errors_.value(experimentId);
+  if (expError) {
+    expError->checksum_ = checksum;
+    expError->error_ = error;
+  } else {
+    expError = new IndividualExperimentError(individual_, experimentId, 
+                                             checksum, error);
+    errors_.insert(experimentId, expError);
+  }
+
+  if (!modifiedErrors_.contains(expError))
+    modifiedErrors_.append(expError);
+}
+
+// Persistence methods
+
+void IndividualErrorTable::load() {
+  ed_.loadReferences("IndividualExperimentError");
+  while (ed_.nextReference()) {
+    IndividualExperimentError *expError = 
+      new IndividualExperimentError(individual_, ed_);
+    errors_.insert(expError->experimentId(), expError);
+  }
+
+  ed_.loadFinished();
+}
+
+// Updates the error of the individual and stores the contributions that 
+// were calculated since the table was loaded.
+int IndividualErrorTable::submit(DB *db) {
+  QHash<QString, QVariant> values;
+  values.insert("Error", individual_->error());
+
+  int id = ed_.submit(db, values, modifiedErrors_);
+  modifiedErrors_.clear();
+
+  return id;
+}
+
+}
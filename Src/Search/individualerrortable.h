@@ -0,0 +1,45 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "DB/dbelementdata.h"
+
+#include <QHash>
+#include <QList>
+
+namespace LoboLab {
+
+class Individual;
+class IndividualExperimentError;
+
+// Stored contributions of each experiment to the error of an individual. 
+// Allows recalculating the error of the individual simulating only the 
+// experiments that were added or changed since it was last scored.
+class IndividualErrorTable {
+ public:
+  IndividualErrorTable(Individual *individual, DB *db);
+  ~IndividualErrorTable();
+
+  inline Individual *individual() const { return individual_; }
+
+  bool isUpToDate(int experimentId, const QByteArray &checksum) const;
+  double error(int experimentId) const;
+  void setError(int experimentId, const QByteArray &checksum, double error);
+
+  int submit(DB *db);
+
+ private:
+  IndividualErrorTable(const IndividualErrorTable &source);
+  IndividualErrorTable &operator=(const IndividualErrorTable &source);
+
+  void load();
+
+  Individual *individual_;
+  QHash<int, IndividualExperimentError*> errors_; // Indexed by experiment id
+  QList<IndividualExperimentError*> modifiedErrors_;
+
+  DBElementData ed_;
+};
+
+} // namespace LoboLab
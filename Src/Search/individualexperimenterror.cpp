@@ -0,0 +1,57 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "individualexperimenterror.h"
+#include "individual.h"
+
+namespace LoboLab {
+
+IndividualExperimentError::IndividualExperimentError(Individual *ind, 
+                                                     int experimentId,
+                                                     const QByteArray &checksum,
+                                                     double error)
+  : individual_(ind), experimentId_(experimentId), checksum_(checksum), 
+    error_(error), ed_("IndividualExperimentError") {
+  Q_ASSERT(individual_);
+}
+
+IndividualExperimentError::IndividualExperimentError(Individual *ind,
+                                                     const DBElementData &ref)
+  : individual_(ind), ed_("IndividualExperimentError", ref) {
+  Q_ASSERT(individual_);
+  load();
+}
+
+IndividualExperimentError::~IndividualExperimentError() {
+}
+
+// Persistence methods
+
+void IndividualExperimentError::load() {
+  experimentId_ = ed_.loadValue(FExperiment).toInt();
+  checksum_ = ed_.loadValue(FChecksum).toByteArray();
+  error_ = ed_.loadValue(FError).toDouble();
+
+  ed_.loadFinished();
+}
+
+int IndividualExperimentError::submit(DB *db) {
+  QPair<QString, DBElement*> refMember("Individual", individual_);
+
+  return ed_.submit(db, refMember, submitValues());
+}
+
+QHash<QString, QVariant> IndividualExperimentError::submitValues() const {
+  QHash<QString, QVariant> values;
+  values.insert("Experiment", experimentId_);
+  values.insert("Checksum", QString::fromLatin1(checksum_));
+  values.insert("Error", error_);
+
+  return values;
+}
+
+bool IndividualExperimentError::erase() {
+  return ed_.erase();
+}
+
+}
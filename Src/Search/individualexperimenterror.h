@@ -0,0 +1,62 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "DB/dbelementdata.h"
+
+#include <QByteArray>
+
+namespace LoboLab {
+
+class Individual;
+class IndividualErrorTable;
+
+// Contribution of one experiment to the error of an individual, together with
+// the checksum of the experiment when it was simulated.
+class IndividualExperimentError : public DBElement {
+  friend class IndividualErrorTable;
+  friend class Individual;
+
+ public:
+  inline Individual *individual() const { return individual_; }
+  inline int experimentId() const { return experimentId_; }
+  inline const QByteArray &checksum() const { return checksum_; }
+  inline double error() const { return error_; }
+
+ protected:
+  inline virtual int id() const { return ed_.id(); };
+  virtual int submit(DB *db);
+  virtual bool erase();
+
+ private:
+  IndividualExperimentError(Individual *ind, int experimentId,
+                            const QByteArray &checksum, double error);
+  IndividualExperimentError(Individual *ind, const DBElementData &ref);
+  ~IndividualExperimentError();
+
+  IndividualExperimentError(const IndividualExperimentError &source);
+  IndividualExperimentError &operator=(
+    const IndividualExperimentError &source);
+
+  void load();
+  QHash<QString, QVariant> submitValues() const;
+
+  Individual *individual_;
+  int experimentId_;
+  QByteArray checksum_;
+  double error_;
+
+  DBElementData ed_;
+
+// Persistence fields
+ public:
+  enum {
+    FIndividual = 1,
+    FExperiment,
+    FChecksum,
+    FError
+  };
+};
+
+} // namespace LoboLab
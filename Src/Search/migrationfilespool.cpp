@@ -0,0 +1,72 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "migrationfilespool.h"
+#include "Common/log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QDateTime>
+
+namespace LoboLab {
+
+MigrationFileSpool::MigrationFileSpool(const QString &spoolDir, int iProcess)
+  : spoolDir_(spoolDir),
+    iProcess_(iProcess),
+    nSent_(0) {
+  QDir().mkpath(inboxDir(iProcess_));
+}
+
+MigrationFileSpool::~MigrationFileSpool() {
+}
+
+QString MigrationFileSpool::inboxDir(int iProcess) const {
+  return QString("%1/p%2").arg(spoolDir_).arg(iProcess);
+}
+
+bool MigrationFileSpool::send(int iProcess, const QByteArray &packet) {
+  QString dirName = inboxDir(iProcess);
+  QDir().mkpath(dirName);
+
+  QString name = QString("%1_%2_%3").arg(iProcess_)
+    .arg(QDateTime::currentMSecsSinceEpoch()).arg(nSent_++);
+  QString tmpFileName = dirName + "/." + name + ".tmp";
+  QString fileName = dirName + "/" + name + ".mig";
+
+  QFile file(tmpFileName);
+  bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  ok = ok && file.write(packet) == packet.size();
+  file.close();
+  ok = ok && QFile::rename(tmpFileName, fileName);
+
+  if (!ok) {
+    Log::write() << "MigrationFileSpool::send: ERROR: unable to write " << 
+      fileName << endl;
+    QFile::remove(tmpFileName);
+  }
+
+  return ok;
+}
+
+// The packets are removed from the inbox once read
+QList<QByteArray> MigrationFileSpool::receive() {
+  QList<QByteArray> packets;
+
+  QDir dir(inboxDir(iProcess_));
+  QStringList fileNames = dir.entryList(QStringList("*.mig"), QDir::Files, 
+                                        QDir::Name);
+  int n = fileNames.size();
+  for (int i = 0; i < n; ++i) {
+    QFile file(dir.filePath(fileNames.at(i)));
+    if (file.open(QIODevice::ReadOnly)) {
+      packets.append(file.readAll());
+      file.close();
+      file.remove();
+    }
+  }
+
+  return packets;
+}
+
+}
@@ -0,0 +1,31 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "migrationtransport.h"
+#include <QString>
+
+namespace LoboLab {
+
+// Migration through a directory shared by all the processes, with one inbox
+// subdirectory per process. Packets are written to a temporary file and 
+// renamed, so a packet is never read partially written.
+class MigrationFileSpool : public MigrationTransport {
+
+ public:
+  MigrationFileSpool(const QString &spoolDir, int iProcess);
+  virtual ~MigrationFileSpool();
+
+  bool send(int iProcess, const QByteArray &packet);
+  QList<QByteArray> receive();
+
+ private:
+  QString inboxDir(int iProcess) const;
+
+  QString spoolDir_;
+  int iProcess_;
+  qint64 nSent_;
+};
+
+} // namespace LoboLab
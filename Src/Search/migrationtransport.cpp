@@ -0,0 +1,12 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "migrationtransport.h"
+
+namespace LoboLab {
+
+MigrationTransport::MigrationTransport() {}
+
+MigrationTransport::~MigrationTransport() {}
+
+}
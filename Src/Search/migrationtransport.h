@@ -0,0 +1,24 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QList>
+#include <QByteArray>
+
+namespace LoboLab {
+
+// Channel used to exchange migrants with the other processes of a 
+// distributed search. Both operations must return without waiting for the
+// other processes.
+class MigrationTransport {
+
+ public:
+  MigrationTransport();
+  virtual ~MigrationTransport();
+
+  virtual bool send(int iProcess, const QByteArray &packet) = 0;
+  virtual QList<QByteArray> receive() = 0;
+};
+
+} // namespace LoboLab
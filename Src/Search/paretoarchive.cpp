@@ -0,0 +1,99 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#include "paretoarchive.h"
+#include "individual.h"
+
+namespace LoboLab {
+
+ParetoArchive::ParetoArchive() {
+}
+
+ParetoArchive::~ParetoArchive() {
+}
+
+bool ParetoArchive::insert(Individual *ind, QList<Individual*> *evicted) {
+  int complexity = ind->complexity();
+  double error = ind->error();
+
+  // The member with the largest complexity not above the individual's one
+  MemberMap::iterator it = members_.upperBound(complexity);
+  if (it != members_.begin()) {
+    --it;
+    double prevError = it.value().first()->error();
+    if (prevError < error)
+      return false;
+    else if (prevError == error) {
+      if (it.key() < complexity) // Same error with less complexity
+        return false;
+
+      it.value().append(ind); // Duplicate
+      memberSet_.insert(ind);
+      return true;
+    } else if (it.key() == complexity) { // Same complexity with more error
+      evict(it.value(), evicted);
+      members_.erase(it);
+    }
+  }
+
+  // The members with more complexity and no less error
+  it = members_.upperBound(complexity);
+  while (it != members_.end() && it.value().first()->error() >= error) {
+    evict(it.value(), evicted);
+    it = members_.erase(it);
+  }
+
+  members_.insert(complexity, QList<Individual*>() << ind);
+  memberSet_.insert(ind);
+
+  return true;
+}
+
+bool ParetoArchive::remove(Individual *ind) {
+  if (!memberSet_.remove(ind))
+    return false;
+
+  MemberMap::iterator it = members_.find(ind->complexity());
+  it.value().removeOne(ind);
+  if (it.value().isEmpty())
+    members_.erase(it);
+
+  return true;
+}
+
+void ParetoArchive::clear() {
+  members_.clear();
+  memberSet_.clear();
+}
+
+void ParetoArchive::evict(const QList<Individual*> &inds, 
+                          QList<Individual*> *evicted) {
+  int n = inds.size();
+  for (int i = 0; i < n; ++i)
+    memberSet_.remove(inds.at(i));
+
+  *evicted += inds;
+}
+
+Individual *ParetoArchive::best() const {
+  if (members_.isEmpty())
+    return NULL;
+  else
+    return (members_.constEnd() - 1).value().first();
+}
+
+// The error decreases with the complexity, so the map is traversed backwards
+QList<Individual*> ParetoArchive::individuals() const {
+  QList<Individual*> inds;
+  inds.reserve(memberSet_.size());
+
+  MemberMap::const_iterator it = members_.constEnd();
+  while (it != members_.constBegin()) {
+    --it;
+    inds += it.value();
+  }
+
+  return inds;
+}
+
+}
@@ -0,0 +1,50 @@
+// Copyright (c) Lobo Lab (lobo@umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QMap>
+#include <QList>
+#include <QSet>
+
+namespace LoboLab {
+
+class Individual;
+
+// Pareto front of the individuals with respect to error and complexity, 
+// ordered by complexity. Along the front the error strictly decreases when 
+// the complexity increases, so an insertion only needs to compare with the 
+// neighbors of its complexity. Individuals with the same error and 
+// complexity are all kept. The membership is also hashed, since most of the
+// individuals removed from the search are not members.
+class ParetoArchive {
+ public:
+  ParetoArchive();
+  ~ParetoArchive();
+
+  // Returns false if the individual is dominated by a member. Otherwise, the
+  // members dominated by the individual are removed and appended to evicted.
+  bool insert(Individual *ind, QList<Individual*> *evicted);
+  bool remove(Individual *ind);
+  void clear();
+
+  inline bool contains(Individual *ind) const { 
+    return memberSet_.contains(ind); 
+  }
+  inline bool isEmpty() const { return memberSet_.isEmpty(); }
+  inline int size() const { return memberSet_.size(); }
+  Individual *best() const; // The lowest error, and then the least complex
+
+  // Sorted by error, and then by complexity
+  QList<Individual*> individuals() const;
+
+ private:
+  typedef QMap<int, QList<Individual*> > MemberMap;
+
+  void evict(const QList<Individual*> &inds, QList<Individual*> *evicted);
+
+  MemberMap members_; // By complexity
+  QSet<Individual*> memberSet_;
+};
+
+} // namespace LoboLab
@@ -12,18 +12,39 @@
 #include "generation.h"
 #include "errorcalculator.h"
 #include "DB/db.h"
+#include "DB/dbwriter.h"
 #include "Common/log.h"
 #include "Common/mathalgo.h"
+#include "Model/model.h"
 #include "searchalgodetcrowd.h"
+#include "migrationtransport.h"
 
 #include <QElapsedTimer>
 #include <QTextStream>
 #include <QSet>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringList>
+#include <sstream>
 
 namespace LoboLab {
 
+const quint32 Search::CheckpointMagic = 0x4C4C434B; // "LLCK"
+const qint32 Search::CheckpointVersion = 4;
+// Tables with the last id written stored in the checkpoints
+const char *Search::CheckpointTables[] = {"Generation", "GenerationIndividual",
+                                          "Individual", NULL};
+
 Search::Search(int id, DB *db, bool loadEvolution)
-  : ed_("Search", id, db) {
+  : asyncEvolution_(false),
+    iProcess_(0),
+    nProcesses_(1),
+    migrationTransport_(NULL),
+    dbWriter_(NULL),
+    checkpointPeriod_(0),
+    resumeCheckpoint_(false),
+    ed_("Search", id, db) {
   load(loadEvolution);
 }
 
@@ -38,20 +59,17 @@ void Search::deleteAll() {
 
   searchExperiments_.clear();
   
-  n = paretoFront_.size();
-  for (int i = 0; i < n; ++i)
-    delete paretoFront_.at(i);
+  for (QSet<Individual*>::const_iterator i = individuals_.constBegin();
+       i != individuals_.constEnd(); ++i)
+    if (!paretoFront_.contains(*i) && !oldParetoFrontInds_.contains(*i))
+      delete *i;
 
-  n = oldParetoFrontInds_.size();
+  QList<Individual*> paretoInds = paretoFront_.individuals();
+  n = paretoInds.size();
   for (int i = 0; i < n; ++i)
-    delete oldParetoFrontInds_.at(i);
+    delete paretoInds.at(i);
 
-  n = individuals_.size();
-  for (int i = 0; i < n; ++i) {
-    Individual *ind = individuals_[i];
-    if (!paretoFront_.contains(ind) && !oldParetoFrontInds_.contains(ind))
-      delete ind;
-  }
+  qDeleteAll(oldParetoFrontInds_);
   
   paretoFront_.clear();
   oldParetoFrontInds_.clear();
@@ -97,45 +115,78 @@ void Search::runEvolution(ErrorCalculator *errorCalculator) {
   name_ += " - " + QDateTime::currentDateTimeUtc().toString(DB::DatetimeFormat);
   
   startDatetime_ = QDateTime::currentDateTimeUtc();
-  calcParalEvolution(errorCalculator);
+  if (asyncEvolution_)
+    calcAsyncEvolution(errorCalculator);
+  else
+    calcParalEvolution(errorCalculator);
   endDatetime_ = QDateTime::currentDateTimeUtc();
 }
 
+void Search::setDistributed(int iProcess, int nProcesses, 
+                            MigrationTransport *transport) {
+  iProcess_ = iProcess;
+  nProcesses_ = nProcesses;
+  migrationTransport_ = transport;
+}
+
 void Search::calcParalEvolution(ErrorCalculator *errorCalculator) {
   // One searchAlgorithm per deme
   QElapsedTimer timer; 
   QElapsedTimer exTimer;
+  QElapsedTimer checkpointTimer;
   QList<SearchAlgo*> searchAlgors;
+  int nDemes = nLocalDemes();
+  ParalEvolutionState state;
+  // Migration partners (-1 if no migration is neccesary)
+  int *migrationStatus = new int [nDemes];
+
+  searchAlgors.reserve(nDemes);
+  if (resumeCheckpoint_ && 
+      readCheckpoint(&state, &searchAlgors, migrationStatus)) {
+    // The demes that were being evaluated are evaluated again
+    for (int i = 0; i < nDemes; ++i) {
+      if (migrationStatus[i] != -1) {
+        SearchAlgo *algo = searchAlgors.at(i);
+        if (algo->isReproducing())
+          errorCalculator->processChildPairs(i, algo, algo->nPairs());
+        else // Initial population
+          errorCalculator->process(i, algo->currentGeneration()->individuals());
+      }
+    }
+  } else {
+    // Create initial populations
+    for (int i = 0; i < nDemes; ++i) {
+      Deme *deme = new Deme(this);
+      demes_.append(deme);
+      SearchAlgo *algo = new SearchAlgo(deme, this);
+      searchAlgors.append(algo);
+      errorCalculator->process(i, algo->calcInitialPopulation());
+    }
 
-  searchAlgors.reserve(searchParams_->nDemes);
-  // Create initial populations
-  for (int i = 0; i < searchParams_->nDemes; ++i) {
-    Deme *deme = new Deme(this);
-    demes_.append(deme);
-    SearchAlgo *algo = new SearchAlgo(deme, this);
-    searchAlgors.append(algo);
-    errorCalculator->process(i, algo->calcInitialPopulation());
-  }
+    state.meanGeneration = 0;
+    state.nMigrations = 0;
+    state.extraGenerationsNoImprov = searchParams_->maxGenerationsNoImprov;
+    state.nTotalTimeouts = 0;
+    state.bestComp = 1e5;
+    state.bestError = 1.0;
 
-  double meanGeneration = 0;
-  int nMigrations = 0;
-  // Migration partners (-1 if no migration is neccesary)
-  int *migrationStatus = new int [searchParams_->nDemes];
-  for (int i = 0; i < searchParams_->nDemes; ++i)
-    migrationStatus[i] = -2;
+    for (int i = 0; i < nDemes; ++i)
+      migrationStatus[i] = -2;
+  }
   
   // Save during evolution
-  if (searchParams_->saveIndividuals > 1)
+  startRecordingSubmits();
+  if (searchParams_->saveIndividuals > 1) {
     submitDemes(ed_.db());
+    writeRecordedSubmits();
+  }
 
   // Main loop
   int maxGenerationsNoImprov = searchParams_->maxGenerationsNoImprov;
-  int extraGenerationsNoImprov = maxGenerationsNoImprov;
   int maxGenerations = searchParams_->nGenerations;
-  int nDemesLeft = searchParams_->nDemes;
-  int bestComp = 1e5;
-  double bestError = 1.0;
+  int nDemesLeft = nDemes;
   timer.start();
+  checkpointTimer.start();
 
   exTimer.start();
   while (nDemesLeft > 0) {
@@ -145,74 +196,54 @@ void Search::calcParalEvolution(ErrorCalculator *errorCalculator) {
     algo->chooseNextGeneration();
     recalculateParetoFront();
 
-    // Save pareto front
-    if (searchParams_->saveIndividuals == 3) {
-      algo->currentGeneration()->submit(ed_.db());
-      submitParetoFront(ed_.db());
+    int nTimeouts = algo->currentGeneration()->nTimeouts();
+    if (nTimeouts > 0) {
+      state.nTotalTimeouts += nTimeouts;
+      Log::write() << "Search::calcParalEvolution: " << nTimeouts << 
+        " individuals exceeded the simulation budget in deme " << iDeme << 
+        " gen " << algo->currentGeneration()->ind() << endl;
     }
-    // Save all
-    else if (searchParams_->saveIndividuals == 4)
-      algo->currentGeneration()->submitWithIndividuals(ed_.db());
+
+    submitGeneration(algo->currentGeneration());
 
     int iGen = algo->currentGeneration()->ind();
 
     // Check we are not finished or an individual got a simulation error
-    if (meanGeneration < maxGenerations && meanGeneration < extraGenerationsNoImprov) {
-      if (MathAlgo::roundToHundredths(paretoFront_.first()->error()) < bestError ||
-        paretoFront_.first()->complexity() < bestComp) {
-        bestComp = paretoFront_.first()->complexity();
-        bestError = MathAlgo::roundToHundredths(paretoFront_.first()->error());
-        extraGenerationsNoImprov = 0;
-        extraGenerationsNoImprov = meanGeneration + maxGenerationsNoImprov;
-
-        Log::write() << "New best: error " << bestError << " comp " << bestComp << ". " << paretoFront_.size() <<
-          " (" << oldParetoFrontInds_.size() << ") Paretos after deme " << iDeme << " gen " << iGen << " meanGen " <<
-          meanGeneration << endl;
+    if (state.meanGeneration < maxGenerations && 
+        state.meanGeneration < state.extraGenerationsNoImprov) {
+      if (MathAlgo::roundToHundredths(paretoFront_.best()->error()) < 
+            state.bestError ||
+          paretoFront_.best()->complexity() < state.bestComp) {
+        state.bestComp = paretoFront_.best()->complexity();
+        state.bestError = 
+          MathAlgo::roundToHundredths(paretoFront_.best()->error());
+        state.extraGenerationsNoImprov = 
+          state.meanGeneration + maxGenerationsNoImprov;
+
+        Log::write() << "New best: error " << state.bestError << " comp " << 
+          state.bestComp << ". " << paretoFront_.size() << " (" << 
+          oldParetoFrontInds_.size() << ") Paretos after deme " << iDeme << 
+          " gen " << iGen << " meanGen " << state.meanGeneration << endl;
       }
 
-      processMigrationsAndReproduce(iDeme, meanGeneration, searchAlgors,
-        errorCalculator, &nMigrations, migrationStatus);
-      meanGeneration += 1.0 / searchParams_->nDemes;
+      processMigrationsAndReproduce(iDeme, state.meanGeneration, searchAlgors,
+        errorCalculator, &state.nMigrations, migrationStatus);
+      state.meanGeneration += 1.0 / nDemes;
       // Save database every hour
       int s = timer.elapsed() / 1000;
       int m = (s % (60 * 60)) / 60;
 
       if (m >= 1) {
-        Log::write() << "Search::calcParalEvolution: saving to database..." << endl;
-        if (searchParams_->saveIndividuals == 1)
-          submitBest(ed_.db());
-        else if (searchParams_->saveIndividuals == 2)
-          submitEvolution(ed_.db());
-        Log::write() << "Search::calcParalEvolution: saved to database." << endl;
-
-        // Remove saved old individuals
-        int n = oldParetoFrontInds_.size();
-        for (int i = n - 1; i >= 0; --i) {
-          Individual *individual = oldParetoFrontInds_.at(i);
-          if (!individuals_.contains(individual)) {
-            delete individual;
-            oldParetoFrontInds_.removeAt(i);
-          }
-        }
-
-        // Remove old individualGenerations
-        n = paretoFront_.size();
-        for (int i = 0; i < n; ++i)
-          paretoFront_[i]->clearGenerationIndividuals();
-
-        n = oldParetoFrontInds_.size();
-        for (int i = 0; i < n; ++i)
-          oldParetoFrontInds_[i]->clearGenerationIndividuals();
-
-        // Remove old generations
-        for (int i = 0; i < searchParams_->nDemes; ++i) {
-          Deme *deme = demes_[i];
-          while (deme->generations().size() > 1)
-            delete deme->generations().takeFirst();
-        }
-
+        submitProgress();
         timer.start();
       }
+
+      // Only while all the demes are evolving
+      if (!checkpointFileName_.isEmpty() && nDemesLeft == nDemes &&
+          checkpointTimer.elapsed() >= checkpointPeriod_ * 1000LL) {
+        writeCheckpoint(state, searchAlgors, migrationStatus);
+        checkpointTimer.start();
+      }
     } else { // End evolution
       releaseWaitingDemes(searchAlgors, errorCalculator, migrationStatus);
       delete algo;
@@ -221,19 +252,544 @@ void Search::calcParalEvolution(ErrorCalculator *errorCalculator) {
   }
 
 
+  if (state.nTotalTimeouts > 0)
+    Log::write() << "Search::calcParalEvolution: " << state.nTotalTimeouts <<
+      " individuals exceeded the simulation budget." << endl;
+
+  deleteImmigrants();
+
   Log::write() << "Search::calcParalEvolution: last saving to database..." << endl;
   submitEvolution(ed_.db());
+  writeRecordedSubmits();
+  stopRecordingSubmits();
   Log::write() << "Search::calcParalEvolution: last saved to database." << endl;
   
   delete [] migrationStatus;
 }
 
+// Each pair of children is a unit of the error calculator, numbered 
+// iDeme * nPairs + iPair. As soon as a pair is evaluated, the children 
+// compete with their parents and a new pair is created in its place, so there
+// is no barrier per deme. The migrations are asynchronous, and the new pairs 
+// stop when the search is finished, waiting only for the pairs in process.
+void Search::calcAsyncEvolution(ErrorCalculator *errorCalculator) {
+  QElapsedTimer timer; 
+  QList<SearchAlgo*> searchAlgors;
+  int nDemes = nLocalDemes();
+  int nPairs = 0;
+
+  if (!checkpointFileName_.isEmpty())
+    Log::write() << "Search::calcAsyncEvolution: WARNING: the asynchronous "
+      "evolution is not checkpointed." << endl;
+
+  searchAlgors.reserve(nDemes);
+  // Create initial populations
+  for (int i = 0; i < nDemes; ++i) {
+    Deme *deme = new Deme(this);
+    demes_.append(deme);
+    SearchAlgo *algo = new SearchAlgo(deme, this);
+    searchAlgors.append(algo);
+
+    QList<Individual*> population = algo->calcInitialPopulation();
+    nPairs = algo->nPairs();
+    for (int j = 0; j < nPairs; ++j)
+      errorCalculator->process(i * nPairs + j, population.mid(2 * j, 2));
+  }
+
+  int nPairsPending = nDemes * nPairs;
+  double meanGeneration = 0;
+
+  // Save during evolution
+  startRecordingSubmits();
+  if (searchParams_->saveIndividuals > 1) {
+    submitDemes(ed_.db());
+    writeRecordedSubmits();
+  }
+
+  // Main loop
+  int maxGenerationsNoImprov = searchParams_->maxGenerationsNoImprov;
+  int extraGenerationsNoImprov = maxGenerationsNoImprov;
+  int maxGenerations = searchParams_->nGenerations;
+  bool finished = false;
+  int nTotalTimeouts = 0;
+  int bestComp = 1e5;
+  double bestError = 1.0;
+  timer.start();
+
+  while (nPairsPending > 0) {
+    int iUnit = errorCalculator->waitForAnyDeme();
+    --nPairsPending;
+    int iDeme = iUnit / nPairs;
+    int iPair = iUnit % nPairs;
+
+    SearchAlgo *algo = searchAlgors[iDeme];
+    bool generationFinished = algo->choosePairSurvivors(iPair);
+    recalculateParetoFront();
+
+    if (generationFinished && !finished) {
+      Generation *generation = algo->currentGeneration();
+      int nTimeouts = generation->nTimeouts();
+      if (nTimeouts > 0) {
+        nTotalTimeouts += nTimeouts;
+        Log::write() << "Search::calcAsyncEvolution: " << nTimeouts << 
+          " individuals exceeded the simulation budget in deme " << iDeme << 
+          " gen " << generation->ind() << endl;
+      }
+
+      submitGeneration(generation);
+
+      if (meanGeneration < maxGenerations && 
+          meanGeneration < extraGenerationsNoImprov) {
+        if (MathAlgo::roundToHundredths(paretoFront_.best()->error()) < 
+              bestError ||
+            paretoFront_.best()->complexity() < bestComp) {
+          bestComp = paretoFront_.best()->complexity();
+          bestError = MathAlgo::roundToHundredths(paretoFront_.best()->error());
+          extraGenerationsNoImprov = meanGeneration + maxGenerationsNoImprov;
+
+          Log::write() << "New best: error " << bestError << " comp " << 
+            bestComp << ". " << paretoFront_.size() << " (" << 
+            oldParetoFrontInds_.size() << ") Paretos after deme " << iDeme << 
+            " gen " << generation->ind() << " meanGen " << meanGeneration << 
+            endl;
+        }
+
+        algo->startNextGeneration();
+        processAsyncMigration(iDeme, algo);
+        meanGeneration += 1.0 / nDemes;
+
+        // Save database every hour
+        int s = timer.elapsed() / 1000;
+        int m = (s % (60 * 60)) / 60;
+        if (m >= 1) {
+          submitProgress();
+          timer.start();
+        }
+      } else { // End evolution
+        finished = true;
+      }
+    }
+
+    if (!finished) {
+      errorCalculator->process(iUnit, algo->reproducePair(iPair));
+      ++nPairsPending;
+    }
+  }
+
+  for (int i = 0; i < nDemes; ++i)
+    delete searchAlgors.at(i);
+
+  if (nTotalTimeouts > 0)
+    Log::write() << "Search::calcAsyncEvolution: " << nTotalTimeouts <<
+      " individuals exceeded the simulation budget." << endl;
+
+  deleteImmigrants();
+
+  Log::write() << "Search::calcAsyncEvolution: last saving to database..." << endl;
+  submitEvolution(ed_.db());
+  writeRecordedSubmits();
+  stopRecordingSubmits();
+  Log::write() << "Search::calcAsyncEvolution: last saved to database." << endl;
+}
+
+void Search::submitGeneration(Generation *generation) {
+  // Save pareto front
+  if (searchParams_->saveIndividuals == 3) {
+    generation->submit(ed_.db());
+    submitParetoFront(ed_.db());
+  }
+  // Save all
+  else if (searchParams_->saveIndividuals == 4)
+    generation->submitWithIndividuals(ed_.db());
+
+  writeRecordedSubmits();
+}
+
+void Search::submitProgress() {
+  Log::write() << "Search::submitProgress: saving to database..." << endl;
+  if (searchParams_->saveIndividuals == 1)
+    submitBest(ed_.db());
+  else if (searchParams_->saveIndividuals == 2)
+    submitEvolution(ed_.db());
+  writeRecordedSubmits();
+  Log::write() << "Search::submitProgress: saved to database." << endl;
+
+  // Remove saved old individuals
+  QMutableSetIterator<Individual*> it(oldParetoFrontInds_);
+  while (it.hasNext()) {
+    Individual *individual = it.next();
+    if (!individuals_.contains(individual)) {
+      delete individual;
+      it.remove();
+    }
+  }
+
+  // Remove old individualGenerations
+  QList<Individual*> paretoInds = paretoFront_.individuals();
+  int n = paretoInds.size();
+  for (int i = 0; i < n; ++i)
+    paretoInds[i]->clearGenerationIndividuals();
+
+  for (QSet<Individual*>::const_iterator i = oldParetoFrontInds_.constBegin();
+       i != oldParetoFrontInds_.constEnd(); ++i)
+    (*i)->clearGenerationIndividuals();
+
+  // Remove old generations
+  n = demes_.size();
+  for (int i = 0; i < n; ++i) {
+    Deme *deme = demes_[i];
+    while (deme->generations().size() > 1)
+      delete deme->generations().takeFirst();
+  }
+}
+
+// With a writer, the rows submitted are recorded instead of written. The ids
+// of the new rows are assigned when recorded, so the elements submitted are 
+// updated in the following submits as usual.
+void Search::startRecordingSubmits() {
+  if (dbWriter_)
+    ed_.db()->startRecording();
+}
+
+// The recorded rows are copies, so the elements can change or be deleted
+// while the writer thread writes them
+void Search::writeRecordedSubmits() {
+  if (dbWriter_)
+    dbWriter_->write(ed_.db()->takeRecorded());
+}
+
+void Search::stopRecordingSubmits() {
+  if (dbWriter_) {
+    dbWriter_->flush();
+    ed_.db()->stopRecording();
+  }
+}
+
+// Checkpoints
+
+void Search::setCheckpoint(const QString &fileName, int periodSecs, 
+                           bool resume) {
+  checkpointFileName_ = fileName;
+  checkpointPeriod_ = periodSecs;
+  resumeCheckpoint_ = resume;
+}
+
+// The checkpoint is written to a temporary file that replaces the previous 
+// one when complete, so a crash never leaves a partial checkpoint. The
+// database is flushed before, so the ids of the elements refer to saved rows,
+// and the last ids of the evolution tables mark the rows saved until then.
+// The individuals are written once, and the rest refers to them by index.
+bool Search::writeCheckpoint(const ParalEvolutionState &state, 
+                             const QList<SearchAlgo*> &searchAlgors,
+                             const int *migrationStatus) {
+  QElapsedTimer timer;
+  timer.start();
+
+  if (dbWriter_)
+    dbWriter_->flush();
+  ed_.db()->flushMirror();
+
+  QSet<Individual*> indSet = individuals_;
+  indSet.unite(oldParetoFrontInds_);
+  QList<Individual*> paretoInds = paretoFront_.individuals();
+  indSet.unite(paretoInds.toSet());
+  int nDemes = demes_.size();
+  for (int i = 0; i < nDemes; ++i) {
+    const QList<Generation*> &generations = demes_.at(i)->generations();
+    int nGenerations = generations.size();
+    for (int j = 0; j < nGenerations; ++j)
+      indSet.unite(generations.at(j)->individuals().toSet());
+  }
+  for (QHash<int, QList<Individual*> >::const_iterator i = 
+       immigrants_.constBegin(); i != immigrants_.constEnd(); ++i)
+    indSet.unite(i.value().toSet());
+
+  QList<Individual*> inds = indSet.toList();
+  QHash<Individual*, int> indIndexes;
+  int nInds = inds.size();
+  indIndexes.reserve(nInds);
+  for (int i = 0; i < nInds; ++i)
+    indIndexes.insert(inds.at(i), i);
+
+  QSaveFile file(checkpointFileName_);
+  if (!file.open(QIODevice::WriteOnly)) {
+    Log::write() << "Search::writeCheckpoint: unable to open " << 
+      checkpointFileName_ << endl;
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << CheckpointMagic << CheckpointVersion << (qint32) id() << name_ <<
+    startDatetime_;
+
+  std::ostringstream randGenState;
+  randGenState << MathAlgo::rand_gen;
+  stream << QByteArray(randGenState.str().c_str());
+
+  stream << state.meanGeneration << (qint32) state.nMigrations << 
+    (qint32) state.extraGenerationsNoImprov << (qint32) state.nTotalTimeouts <<
+    (qint32) state.bestComp << state.bestError << (qint32) nDemes;
+  for (int i = 0; i < nDemes; ++i)
+    stream << (qint32) migrationStatus[i];
+
+  for (int i = 0; CheckpointTables[i]; ++i)
+    stream << (qint32) ed_.db()->maxRowId(CheckpointTables[i]);
+
+  stream << (qint32) nInds;
+  for (int i = 0; i < nInds; ++i)
+    inds.at(i)->writeState(stream);
+
+  QHash<Generation*, int> genIndexes;
+  for (int i = 0; i < nDemes; ++i) {
+    demes_.at(i)->writeState(stream, indIndexes);
+    searchAlgors.at(i)->writeState(stream);
+
+    const QList<Generation*> &generations = demes_.at(i)->generations();
+    int nGenerations = generations.size();
+    for (int j = 0; j < nGenerations; ++j)
+      genIndexes.insert(generations.at(j), genIndexes.size());
+  }
+
+  QList<Individual*> indLists[3] = {individuals_.toList(), paretoInds,
+                                    oldParetoFrontInds_.toList()};
+  for (int i = 0; i < 3; ++i) {
+    int n = indLists[i].size();
+    stream << (qint32) n;
+    for (int j = 0; j < n; ++j)
+      stream << (qint32) indIndexes.value(indLists[i].at(j));
+  }
+
+  stream << (qint32) immigrants_.size();
+  for (QHash<int, QList<Individual*> >::const_iterator i = 
+       immigrants_.constBegin(); i != immigrants_.constEnd(); ++i) {
+    int n = i.value().size();
+    stream << (qint32) i.key() << (qint32) n;
+    for (int j = 0; j < n; ++j)
+      stream << (qint32) indIndexes.value(i.value().at(j));
+  }
+
+  for (int i = 0; i < nInds; ++i)
+    inds.at(i)->writeGenerationsState(stream, genIndexes);
+
+  if (stream.status() != QDataStream::Ok || !file.commit()) {
+    Log::write() << "Search::writeCheckpoint: unable to write " << 
+      checkpointFileName_ << endl;
+    return false;
+  }
+
+  Log::write() << "Search::writeCheckpoint: " << nInds << 
+    " individuals checkpointed in " << timer.elapsed() << " ms." << endl;
+
+  return true;
+}
+
+// Restores the state written by writeCheckpoint. The demes and the search 
+// algorithms are created, in the same order. Returns false if the file is 
+// not a checkpoint of this search, and then nothing is restored.
+bool Search::readCheckpoint(ParalEvolutionState *state, 
+                            QList<SearchAlgo*> *searchAlgors,
+                            int *migrationStatus) {
+  QFile file(checkpointFileName_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    Log::write() << "Search::readCheckpoint: unable to open " << 
+      checkpointFileName_ << ". Starting a new evolution." << endl;
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+  quint32 magic;
+  qint32 version, searchId, nDemes;
+  QString name;
+  QDateTime startDatetime;
+  QByteArray randGenState;
+  ParalEvolutionState st;
+  qint32 nMigrations, extraGenerationsNoImprov, nTotalTimeouts, bestComp;
+  stream >> magic >> version >> searchId >> name >> startDatetime >> 
+    randGenState >> st.meanGeneration >> nMigrations >> 
+    extraGenerationsNoImprov >> nTotalTimeouts >> bestComp >> st.bestError >> 
+    nDemes;
+
+  if (stream.status() != QDataStream::Ok || magic != CheckpointMagic || 
+      version != CheckpointVersion || searchId != id() || 
+      nDemes != nLocalDemes()) {
+    Log::write() << "Search::readCheckpoint: " << checkpointFileName_ << 
+      " is not a checkpoint of this search. Starting a new evolution." << 
+      endl;
+    return false;
+  }
+
+  name_ = name;
+  startDatetime_ = startDatetime;
+  std::istringstream randGenStream(randGenState.toStdString());
+  randGenStream >> MathAlgo::rand_gen;
+  st.nMigrations = nMigrations;
+  st.extraGenerationsNoImprov = extraGenerationsNoImprov;
+  st.nTotalTimeouts = nTotalTimeouts;
+  st.bestComp = bestComp;
+  *state = st;
+
+  for (int i = 0; i < nDemes; ++i) {
+    qint32 status;
+    stream >> status;
+    migrationStatus[i] = status;
+  }
+
+  QList<int> lastIds;
+  for (int i = 0; CheckpointTables[i]; ++i) {
+    qint32 lastId;
+    stream >> lastId;
+    lastIds.append(lastId);
+  }
+
+  DB *db = ed_.db();
+  qint32 nInds;
+  stream >> nInds;
+  QList<Individual*> inds;
+  inds.reserve(nInds);
+  for (int i = 0; i < nInds; ++i)
+    inds.append(new Individual(stream, db));
+
+  QList<Generation*> generations;
+  for (int i = 0; i < nDemes; ++i) {
+    Deme *deme = new Deme(this, stream, inds, &generations, db);
+    demes_.append(deme);
+    SearchAlgo *algo = new SearchAlgo(deme, this);
+    algo->readState(stream);
+    searchAlgors->append(algo);
+  }
+
+  QList<Individual*> indLists[3];
+  for (int i = 0; i < 3; ++i) {
+    qint32 n;
+    stream >> n;
+    for (int j = 0; j < n; ++j) {
+      qint32 iInd;
+      stream >> iInd;
+      indLists[i].append(inds.at(iInd));
+    }
+  }
+
+  individuals_ = indLists[0].toSet();
+  QList<Individual*> evicted;
+  int n = indLists[1].size();
+  for (int i = 0; i < n; ++i)
+    paretoFront_.insert(indLists[1].at(i), &evicted);
+  oldParetoFrontInds_ = indLists[2].toSet();
+
+  qint32 nImmigrantDemes;
+  stream >> nImmigrantDemes;
+  for (int i = 0; i < nImmigrantDemes; ++i) {
+    qint32 iDeme, nImmigrants;
+    stream >> iDeme >> nImmigrants;
+    QList<Individual*> &immigrants = immigrants_[iDeme];
+    for (int j = 0; j < nImmigrants; ++j) {
+      qint32 iInd;
+      stream >> iInd;
+      immigrants.append(inds.at(iInd));
+    }
+  }
+
+  for (int i = 0; i < nInds; ++i)
+    inds.at(i)->readGenerationsState(stream, generations, db);
+
+  if (stream.status() != QDataStream::Ok)
+    Log::write() << "Search::readCheckpoint: WARNING: " << 
+      checkpointFileName_ << " is truncated." << endl;
+
+  removeRowsAfterCheckpoint(lastIds);
+
+  Log::write() << "Search::readCheckpoint: resumed from " << 
+    checkpointFileName_ << " at mean generation " << st.meanGeneration << 
+    " with " << nInds << " individuals." << endl;
+
+  return true;
+}
+
+// Removes the rows of the demes of this process saved after the checkpoint,
+// since the evolution saves them again when resumed. The demes are saved 
+// before the first checkpoint, and the other processes of a distributed 
+// search save their own demes. The individuals removed are those with new 
+// ids linked to the generation individuals removed. The rows are removed one
+// by one, so they are also removed from the original file of a scratch copy.
+bool Search::removeRowsAfterCheckpoint(const QList<int> &lastIds) {
+  int lastGenId = lastIds.at(0);
+  int lastGenIndId = lastIds.at(1);
+  int lastIndId = lastIds.at(2);
+
+  QStringList demeIds;
+  int nDemes = demes_.size();
+  for (int i = 0; i < nDemes; ++i)
+    demeIds.append(QString::number(demes_.at(i)->id()));
+
+  QString generationsSql = "SELECT Id FROM Generation WHERE Deme IN (" + 
+    demeIds.join(", ") + ")";
+  QString newIndsSql = "SELECT Individual FROM GenerationIndividual "
+    "WHERE Individual > ? AND Generation IN (" + generationsSql + ")";
+
+  QList<int> expErrorIds = readIds("SELECT Id FROM IndividualExperimentError "
+    "WHERE Individual IN (" + newIndsSql + ")", QVariantList() << lastIndId);
+  QList<int> indIds = readIds("SELECT DISTINCT Individual FROM (" + 
+    newIndsSql + ")", QVariantList() << lastIndId);
+  QList<int> genIndIds = readIds("SELECT Id FROM GenerationIndividual "
+    "WHERE Id > ? AND Generation IN (" + generationsSql + ")", 
+    QVariantList() << lastGenIndId);
+  QList<int> genIds = readIds(generationsSql + " AND Id > ?", 
+    QVariantList() << lastGenId);
+
+  DB *db = ed_.db();
+  bool ok = db->beginTransaction();
+  QList<int> idLists[4] = {expErrorIds, genIndIds, indIds, genIds};
+  const char *tables[4] = {"IndividualExperimentError", 
+    "GenerationIndividual", "Individual", "Generation"};
+  for (int i = 0; i < 4; ++i) {
+    int n = idLists[i].size();
+    for (int j = 0; ok && j < n; ++j)
+      ok = db->removeRow(tables[i], idLists[i].at(j));
+  }
+
+  if (ok)
+    ok = db->endTransaction();
+  else
+    db->rollbackTransaction();
+
+  if (ok)
+    Log::write() << "Search::removeRowsAfterCheckpoint: removed " << 
+      genIds.size() << " generations, " << genIndIds.size() << 
+      " generation individuals and " << indIds.size() << " individuals." << 
+      endl;
+  else
+    Log::write() << "Search::removeRowsAfterCheckpoint: ERROR: unable to "
+      "remove the rows saved after the checkpoint: " << 
+      db->lastError().text() << endl;
+
+  return ok;
+}
+
+QList<int> Search::readIds(const QString &sqlStr, 
+                           const QVariantList &values) const {
+  QList<int> ids;
+  QSqlQuery *query = ed_.db()->newQuery(sqlStr, values);
+  while (query->next())
+    ids.append(query->value(0).toInt());
+  delete query;
+
+  return ids;
+}
+
 // Process migration status
 // migrationStatus_ stores the partner to migrate with or -1 if it is waiting
 // for the partner or -2 if no migration is necessary.
 void Search::processMigrationsAndReproduce(int iDeme, double meanGeneration, 
     const QList<SearchAlgo*> &searchAlgors, ErrorCalculator *errorCalculator,
     int *nMigrations, int *migrationStatus) {
+  if (migrationTransport_) { // Never waits for other demes
+    processAsyncMigration(iDeme, searchAlgors[iDeme]);
+    reproduce(iDeme, searchAlgors[iDeme], errorCalculator);
+    return;
+  }
+
   // Check if migration is necessary
   int iDemeStatus = migrationStatus[iDeme];
 
@@ -246,10 +802,8 @@ void Search::processMigrationsAndReproduce(int iDeme, double meanGeneration,
       migrationStatus[iDemePartner] = -2;
       migrateIndividuals(searchAlgors[iDeme]->currentGeneration(), 
                          searchAlgors[iDemePartner]->currentGeneration());
-      errorCalculator->process(iDemePartner, 
-                                searchAlgors[iDemePartner]->reproduce());
-      errorCalculator->process(iDeme, 
-                                searchAlgors[iDeme]->reproduce());
+      reproduce(iDemePartner, searchAlgors[iDemePartner], errorCalculator);
+      reproduce(iDeme, searchAlgors[iDeme], errorCalculator);
     } else {
       migrationStatus[iDeme] = -1; // waiting for partner
     }
@@ -267,10 +821,17 @@ void Search::processMigrationsAndReproduce(int iDeme, double meanGeneration,
     migrationStatus[iDeme] = -1;
 
   } else {// no migration necessary
-      errorCalculator->process(iDeme, searchAlgors[iDeme]->reproduce());
+      reproduce(iDeme, searchAlgors[iDeme], errorCalculator);
   }
 }
 
+// The children are created in the threads of the error calculator
+void Search::reproduce(int iDeme, SearchAlgo *searchAlgo, 
+                       ErrorCalculator *errorCalculator) {
+  searchAlgo->chooseParents();
+  errorCalculator->processChildPairs(iDeme, searchAlgo, searchAlgo->nPairs());
+}
+
 void Search::migrateIndividuals(Generation *gen1, Generation *gen2) {
   int demesSize = searchParams_->demesSize;
   
@@ -302,16 +863,17 @@ void Search::migrateIndividuals(Generation *gen1, Generation *gen2) {
 }
 
 void Search::createMigrationPartners(int *migrationStatus) {
+  int nDemes = demes_.size();
 
   // Shuffle demes
-  int *randIds = new int[searchParams_->nDemes];
-  for (int i = 0; i < searchParams_->nDemes; ++i)
+  int *randIds = new int[nDemes];
+  for (int i = 0; i < nDemes; ++i)
     randIds[i] = i;
   
-  MathAlgo::shuffle(searchParams_->nDemes, randIds);
+  MathAlgo::shuffle(nDemes, randIds);
 
   // Select random partners
-  for (int i = 0; i < searchParams_->nDemes; i = i + 2) {
+  for (int i = 0; i < nDemes; i = i + 2) {
     int id1 = randIds[i];
     int id2 = randIds[i+1];
     migrationStatus[id1] = id2;
@@ -324,12 +886,13 @@ void Search::createMigrationPartners(int *migrationStatus) {
 void Search::releaseWaitingDemes(const QList<SearchAlgo*> &searchAlgors, 
                                  ErrorCalculator *errorCalculator,
                                  int *migrationStatus) {
-  for (int i=0; i < searchParams_->nDemes; ++i) {
+  int nDemes = searchAlgors.size();
+  for (int i=0; i < nDemes; ++i) {
     if (migrationStatus[i] > -2) {
       if (migrationStatus[i] == -1) {
         Log::write() << "Search::releaseWaitingDemes: Releasing waiting deme " 
           << i << endl;
-        errorCalculator->process(i, searchAlgors[i]->reproduce());
+        reproduce(i, searchAlgors[i], errorCalculator);
       } else {
         Log::write() << "Search::releaseWaitingDemes: Canceling scheduled "
           "deme " << i << endl;
@@ -340,50 +903,200 @@ void Search::releaseWaitingDemes(const QList<SearchAlgo*> &searchAlgors,
   }
 }
 
+// Distributed search
+
+int Search::nLocalDemes() const {
+  return (searchParams_->nDemes - iProcess_ + nProcesses_ - 1) / nProcesses_;
+}
+
+// One unit per deme, or per pair of children in asynchronous evolution. The
+// population size is rounded up to an even number by the search algorithm.
+int Search::nEvaluationUnits() const {
+  if (asyncEvolution_)
+    return nLocalDemes() * ((searchParams_->demesSize + 1) / 2);
+  else
+    return searchParams_->nDemes;
+}
+
+// Incorporates the immigrants received for the deme, and sends copies of 
+// some individuals to a random deme every migration period.
+void Search::processAsyncMigration(int iDeme, SearchAlgo *searchAlgo) {
+  Generation *generation = searchAlgo->currentGeneration();
+
+  receiveImmigrants();
+  immigrateIndividuals(iDeme, generation);
+
+  int iGen = generation->ind();
+  if (iGen > 0 && iGen % searchParams_->migrationPeriod == 0)
+    emigrateIndividuals(iDeme, generation);
+}
+
+// The local demes are numbered 0..nLocalDemes-1. Deme iDeme of process 
+// iProcess is the global deme iProcess + iDeme * nProcesses.
+void Search::emigrateIndividuals(int iDeme, Generation *generation) {
+  int nDemes = searchParams_->nDemes;
+  if (nDemes < 2)
+    return;
+
+  int iGlobalDeme = iProcess_ + iDeme * nProcesses_;
+  int iTargetDeme = MathAlgo::randInt(nDemes - 1);
+  if (iTargetDeme >= iGlobalDeme)
+    ++iTargetDeme;
+
+  int nInds = generation->nIndividuals();
+  int nMigrants = nInds / 2;
+  int *randIds = new int[nInds];
+  for (int i = 0; i < nInds; ++i)
+    randIds[i] = i;
+  MathAlgo::shuffle(nInds, randIds);
+
+  int iTargetProcess = iTargetDeme % nProcesses_;
+  if (iTargetProcess == iProcess_) {
+    QList<Individual*> &immigrants = immigrants_[iTargetDeme / nProcesses_];
+    for (int i = 0; i < nMigrants; ++i)
+      immigrants.append(new Individual(*generation->individual(randIds[i]), 
+                                       false));
+  } else {
+    QByteArray packet;
+    QDataStream stream(&packet, QIODevice::WriteOnly);
+    stream << (qint32) id() << (qint32) iTargetDeme << (qint32) nMigrants;
+    for (int i = 0; i < nMigrants; ++i) {
+      Individual *ind = generation->individual(randIds[i]);
+      stream << ind->model()->toBinary() << ind->error() << ind->simTime() << 
+        ind->timedOut();
+    }
+
+    migrationTransport_->send(iTargetProcess, packet);
+  }
+
+  delete [] randIds;
+
+  Log::write() << "Search::emigrateIndividuals: " << nMigrants << 
+    " individuals from deme " << iGlobalDeme << " to deme " << iTargetDeme << 
+    endl;
+}
+
+void Search::receiveImmigrants() {
+  if (!migrationTransport_) // All the demes are local
+    return;
+
+  QList<QByteArray> packets = migrationTransport_->receive();
+  int nPackets = packets.size();
+  for (int i = 0; i < nPackets; ++i) {
+    QDataStream stream(packets.at(i));
+    qint32 searchId, iGlobalDeme, n;
+    stream >> searchId >> iGlobalDeme >> n;
+    if (searchId != id() || iGlobalDeme % nProcesses_ != iProcess_) {
+      Log::write() << "Search::receiveImmigrants: WARNING: packet for search " 
+        << searchId << " deme " << iGlobalDeme << " ignored." << endl;
+      continue;
+    }
+
+    // The models are in binary form, so their errors are still exact
+    QList<Individual*> &immigrants = immigrants_[iGlobalDeme / nProcesses_];
+    for (int j = 0; j < n; ++j) {
+      QByteArray modelBin;
+      double error, simTime;
+      bool timedOut;
+      stream >> modelBin >> error >> simTime >> timedOut;
+
+      Model *model = new Model();
+      if (!model->loadFromBinary(modelBin)) {
+        Log::write() << "Search::receiveImmigrants: WARNING: malformed model "
+          "ignored." << endl;
+        delete model;
+        continue;
+      }
+
+      Individual *ind = new Individual(model);
+      ind->setError(error);
+      ind->setSimTime(simTime);
+      ind->setTimedOut(timedOut);
+      immigrants.append(ind);
+    }
+  }
+}
+
+// The immigrants replace random individuals of the current generation
+void Search::immigrateIndividuals(int iDeme, Generation *generation) {
+  QList<Individual*> &immigrants = immigrants_[iDeme];
+  if (immigrants.isEmpty())
+    return;
+
+  int nInds = generation->nIndividuals();
+  int nImmigrants = qMin(immigrants.size(), nInds);
+  int *randIds = new int[nInds];
+  for (int i = 0; i < nInds; ++i)
+    randIds[i] = i;
+  MathAlgo::shuffle(nInds, randIds);
+
+  // Only the most recent immigrants, the last ones to arrive, are kept if too
+  // many arrived
+  int nOld = immigrants.size() - nImmigrants;
+  for (int i = 0; i < nOld; ++i)
+    delete immigrants.at(i);
+
+  for (int i = 0; i < nImmigrants; ++i) {
+    Individual *immigrant = immigrants.at(nOld + i);
+    Individual *oldInd = generation->individual(randIds[i]);
+    generation->replaceIndividual(randIds[i], immigrant);
+    addNewIndividual(immigrant);
+    removeIndividual(oldInd);
+  }
+
+  immigrants.clear();
+  delete [] randIds;
+
+  recalculateParetoFront();
+
+  Log::write() << "Search::immigrateIndividuals: " << nImmigrants << 
+    " individuals into deme " << iProcess_ + iDeme * nProcesses_ << endl;
+}
+
+void Search::deleteImmigrants() {
+  for (QHash<int, QList<Individual*> >::const_iterator i = 
+       immigrants_.constBegin(); i != immigrants_.constEnd(); ++i) {
+    int n = i.value().size();
+    for (int j = 0; j < n; ++j)
+      delete i.value().at(j);
+  }
+
+  immigrants_.clear();
+}
+
 void Search::addNewIndividual(Individual *ind) {
-  individuals_.append(ind);
+  individuals_.insert(ind);
   newIndividuals_.append(ind);
 }
 
 void Search::removeIndividual(Individual *ind) {
-  if (paretoFront_.contains(ind)) {
-    paretoFront_.removeOne(ind);
-    oldParetoFrontInds_.append(ind);
-  }
+  individuals_.remove(ind);
+
+  if (paretoFront_.remove(ind))
+    oldParetoFrontInds_.insert(ind);
   else if (!oldParetoFrontInds_.contains(ind))
     delete ind;
-    
-  individuals_.removeOne(ind);
 }
 
 // Also includes duplicates in the front
+// Individuals that exceeded the simulation budget are not considered.
+// The new individuals that are not pareto after all the insertions were never
+// pareto, so they are not kept.
 void Search::recalculateParetoFront() {
-  paretoFront_.append(newIndividuals_);
-
-  if (!paretoFront_.isEmpty()) {
-    qSort(paretoFront_.begin(), paretoFront_.end(),	indErrorComplexityLessThan);
-
-    double lastError = paretoFront_.first()->error();
-    double lastComplex = paretoFront_.first()->complexity();
-    int i = 1;
-    while (i < paretoFront_.size()) {
-      Individual *ind = paretoFront_.at(i);
-      if (ind->complexity() < lastComplex) {
-        lastError = ind->error();
-        lastComplex = ind->complexity();
-        ++i;
-      } else if (ind->complexity() == lastComplex &&
-                 ind->error() == lastError) { // Duplicates included
-        ++i;
-      } else { // The individual is not pareto
-        if (newIndividuals_.contains(ind)) // The individual was never pareto
-          paretoFront_.removeAt(i);
-        else  // The individual was pareto
-          oldParetoFrontInds_.append(paretoFront_.takeAt(i));
-      }
-    }
+  QSet<Individual*> newInds;
+  QList<Individual*> evicted;
+  int nNew = newIndividuals_.size();
+  for (int i = 0; i < nNew; ++i) {
+    Individual *ind = newIndividuals_.at(i);
+    if (!ind->timedOut() && paretoFront_.insert(ind, &evicted))
+      newInds.insert(ind);
   }
 
+  int nEvicted = evicted.size();
+  for (int i = 0; i < nEvicted; ++i)
+    if (!newInds.contains(evicted.at(i))) // The individual was pareto
+      oldParetoFrontInds_.insert(evicted.at(i));
+
   newIndividuals_.clear();
 }
 
@@ -456,20 +1169,49 @@ QHash<int, Individual*> Search::loadIndividuals() {
   while (ed_.nextReference()) {
     Individual *ele = new Individual(ed_);
     individualsIdMap.insert(ele->id(), ele);
-    individuals_.append(ele);
+    individuals_.insert(ele);
   }
 
-  paretoFront_ = individuals_;
-  recalculateParetoFront();
+  // The saved individuals were all pareto at some point, except those that 
+  // exceeded the simulation budget, when all the individuals are saved
+  QList<Individual*> evicted;
+  for (QSet<Individual*>::const_iterator i = individuals_.constBegin();
+       i != individuals_.constEnd(); ++i)
+    if ((*i)->timedOut() || !paretoFront_.insert(*i, &evicted))
+      oldParetoFrontInds_.insert(*i);
+  oldParetoFrontInds_ += evicted.toSet();
 
   return individualsIdMap;
 }
 
+// The generations and the generation individuals of all the demes are read
+// with one query each, in the order of the demes and generations, and linked
+// by id
 void Search::loadDemes(const QHash<int, Individual*> &individualsIdMap) {
+  QHash<int, Deme*> demesIdMap;
   ed_.loadReferences("Deme");
   while (ed_.nextReference()) {
-    Deme *d = new Deme(this, individualsIdMap, ed_);
+    Deme *d = new Deme(this, ed_);
     demes_.append(d);
+    demesIdMap.insert(d->id(), d);
+  }
+
+  QHash<int, Generation*> generationsIdMap;
+  ed_.loadNestedReferences("Generation", "Deme");
+  while (ed_.nextReference()) {
+    Deme *d = demesIdMap.value(ed_.loadRefValue(Generation::FDeme).toInt());
+    Generation *gen = new Generation(d, ed_);
+    d->generations_.append(gen);
+    generationsIdMap.insert(gen->id(), gen);
+  }
+
+  ed_.loadNestedReferences("GenerationIndividual", "Generation", "Deme");
+  while (ed_.nextReference()) {
+    Generation *gen = generationsIdMap.value(
+      ed_.loadRefValue(GenerationIndividual::FGeneration).toInt());
+    Individual *ind = individualsIdMap.value(
+      ed_.loadRefValue(GenerationIndividual::FIndividual).toInt());
+    gen->addLoadedIndividual(ind, ed_);
   }
 }
 
@@ -487,7 +1229,7 @@ int Search::submit(DB *db) {
   members.insert("SimParams", simParams_);
 
   return ed_.submit(db, refMember, members, values, searchExperiments_, demes_, 
-    individuals_);
+    individuals_.toList());
 }
 
 int Search::submitDemes(DB *db) {
@@ -503,7 +1245,8 @@ int Search::submitParetoFront(DB *db) {
   QHash<QString, QVariant> values;
   QHash<QString, DBElement*> members;
 
-  return ed_.submit(db, refMember, members, values, paretoFront_);
+  return ed_.submit(db, refMember, members, values, 
+                    paretoFront_.individuals());
 }
 
 int Search::submitBest(DB *db) {
@@ -518,7 +1261,7 @@ int Search::submitBest(DB *db) {
   QHash<QString, DBElement*> members;
 
   QList<Individual*> bestIndividual;
-  bestIndividual.append(paretoFront_.first());
+  bestIndividual.append(paretoFront_.best());
   // Submitting best individual
   return ed_.submit(db, refMember, members, values, demes_, bestIndividual);
 }
@@ -536,7 +1279,7 @@ int Search::submitEvolution(DB *db) {
 
   // Submitting pareto front and old pareto front individuals
   return ed_.submit(db, refMember, members, values, demes_, 
-                    paretoFront_ + oldParetoFrontInds_);
+                    paretoFront_.individuals() + oldParetoFrontInds_.toList());
 }
 
 int Search::submitShallow(DB *db) {
@@ -552,7 +1295,8 @@ int Search::submitShallow(DB *db) {
 bool Search::erase() {
   QList<DBElement*> members;
   
-  return ed_.erase(members, searchExperiments_, individuals_, demes_);
+  return ed_.erase(members, searchExperiments_, individuals_.toList(), 
+                   demes_);
 }
 
 }
\ No newline at end of file
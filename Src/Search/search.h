@@ -7,8 +7,10 @@
 
 #include "DB/dbelementdata.h"
 #include "searchexperiment.h"
+#include "paretoarchive.h"
 
 #include <QList>
+#include <QSet>
 #include <QDateTime>
 
 namespace LoboLab {
@@ -23,6 +25,8 @@ class SimParams;
 class ErrorCalculator;
 class Product;
 class SearchAlgo;
+class MigrationTransport;
+class DBWriter;
 
 class Search : public DBElement {
  public:
@@ -63,6 +67,13 @@ class Search : public DBElement {
   inline Experiment *expOther(int i) const { return searchExpOthers_.at(i)->experiment(); }
 
   inline const QList<Deme*> &demes() const {return demes_;}
+  // Sorted by error and then by complexity
+  inline QList<Individual*> paretoFront() const { 
+    return paretoFront_.individuals(); 
+  }
+  inline QList<Individual*> oldParetoFront() const { 
+    return oldParetoFrontInds_.toList(); 
+  }
   
   // Functions used during evolution by the search algorithm
   void addNewIndividual(Individual *ind);
@@ -75,6 +86,28 @@ class Search : public DBElement {
 
   void runEvolution(ErrorCalculator *errorCalculator);
 
+  // Distributed search: this process only evolves the demes i with 
+  // i % nProcesses == iProcess, and the migrants are exchanged 
+  // asynchronously with the other processes through the transport.
+  void setDistributed(int iProcess, int nProcesses, 
+                      MigrationTransport *transport);
+  inline bool isDistributed() const { return migrationTransport_ != NULL; }
+
+  // Asynchronous steady-state evolution: the error calculator processes 
+  // pairs of children instead of whole demes, so nEvaluationUnits() units 
+  // are needed.
+  inline void setAsyncEvolution(bool async) { asyncEvolution_ = async; }
+  inline bool isAsyncEvolution() const { return asyncEvolution_; }
+  int nEvaluationUnits() const;
+
+  // The saves during evolution are recorded and written to the database by 
+  // the writer thread, so the evolution continues meanwhile
+  inline void setDBWriter(DBWriter *writer) { dbWriter_ = writer; }
+
+  // The generational evolution is checkpointed to the file every period, 
+  // and it can be resumed from the last checkpoint of the same search.
+  void setCheckpoint(const QString &fileName, int periodSecs, bool resume);
+
   inline virtual int id() const { return ed_.id(); };
   virtual int submit(DB *db);
   int submitDemes(DB *db);
@@ -85,20 +118,57 @@ class Search : public DBElement {
   virtual bool erase();
 
  private:
+  static const quint32 CheckpointMagic;
+  static const qint32 CheckpointVersion;
+  static const char *CheckpointTables[];
+
   Search(const Search &source, bool maintainId = true);
   Search &operator=(const Search &source);
   //void copy(const Search &source, bool maintainId);
   void deleteAll();
 
   
+  // State of the main loop of calcParalEvolution
+  struct ParalEvolutionState {
+    double meanGeneration;
+    int nMigrations;
+    int extraGenerationsNoImprov;
+    int nTotalTimeouts;
+    int bestComp;
+    double bestError;
+  };
+
   void calcParalEvolution(ErrorCalculator *errorCalculator);
   void processMigrationsAndReproduce(int iDeme, double meanGeneration, 
     const QList<SearchAlgo*> &searchAlgors, ErrorCalculator *errorCalculator,
     int *nMigrations, int *migrationStatus);
+  void reproduce(int iDeme, SearchAlgo *searchAlgo, 
+                 ErrorCalculator *errorCalculator);
   void migrateIndividuals(Generation *gen1, Generation *gen2);
   void createMigrationPartners(int *migrationStatus);
   void releaseWaitingDemes(const QList<SearchAlgo*> &searchAlgors, 
     ErrorCalculator *errorCalculator, int *migrationStatus);
+  void calcAsyncEvolution(ErrorCalculator *errorCalculator);
+  void submitGeneration(Generation *generation);
+  void submitProgress();
+  void startRecordingSubmits();
+  void writeRecordedSubmits();
+  void stopRecordingSubmits();
+
+  bool writeCheckpoint(const ParalEvolutionState &state, 
+                       const QList<SearchAlgo*> &searchAlgors,
+                       const int *migrationStatus);
+  bool readCheckpoint(ParalEvolutionState *state, 
+                      QList<SearchAlgo*> *searchAlgors, int *migrationStatus);
+  bool removeRowsAfterCheckpoint(const QList<int> &lastIds);
+  QList<int> readIds(const QString &sqlStr, const QVariantList &values) const;
+
+  int nLocalDemes() const;
+  void processAsyncMigration(int iDeme, SearchAlgo *searchAlgo);
+  void emigrateIndividuals(int iDeme, Generation *generation);
+  void receiveImmigrants();
+  void immigrateIndividuals(int iDeme, Generation *generation);
+  void deleteImmigrants();
 
   //void updateParetoFront(Individual *newInd);
   void recalculateParetoFront();
@@ -120,18 +190,27 @@ class Search : public DBElement {
   QList<SearchExperiment*> searchExpPreds_;
   QList<SearchExperiment*> searchExpOthers_;
   QList<Deme*> demes_;
-  QList<Individual*> individuals_;
+  QSet<Individual*> individuals_; // Hashed, since replaced ones are removed
   QList<Individual*> newIndividuals_; // Temporary storage of selected 
                                       // new individuals
-  QList<Individual*> paretoFront_; // Pareto front individuals 
-                                   // Sorted by complexity and then by error
-  QList<Individual*> oldParetoFrontInds_; // Individuals that were in the 
-                                          // pareto front.
+  ParetoArchive paretoFront_; // Pareto front individuals
+  QSet<Individual*> oldParetoFrontInds_; // Individuals that were in the 
+                                         // pareto front.
   QList<Product*> allProducts_;
   QList<int> inputLabels_;
   QList<int> outputLabels_;
   int maxProductLabel_;
 
+  bool asyncEvolution_;
+  int iProcess_;
+  int nProcesses_;
+  MigrationTransport *migrationTransport_;
+  QHash<int, QList<Individual*> > immigrants_; // By local deme
+  DBWriter *dbWriter_;
+  QString checkpointFileName_;
+  int checkpointPeriod_; // In seconds
+  bool resumeCheckpoint_;
+
   DBElementData ed_;
 
 // Persistence fields
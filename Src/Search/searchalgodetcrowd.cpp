@@ -23,7 +23,9 @@ namespace LoboLab {
 SearchAlgoDetCrowd::SearchAlgoDetCrowd(Deme *deme, Search *s)
     : search_(s), 
       deme_(deme),
-      generation_(NULL) {
+      generation_(NULL),
+      nPairsEvaluated_(0),
+      nPairTimeouts_(0) {
   searchParams_ = search_->searchParams();
   
   populationSize_ = searchParams_->demesSize;
@@ -33,11 +35,28 @@ SearchAlgoDetCrowd::SearchAlgoDetCrowd(Deme *deme, Search *s)
   randPopulationInd_ = new int[populationSize_];
   for (int i = 0; i < populationSize_; ++i)
     randPopulationInd_[i] = i;
+
+  parentIds_.resize(populationSize_);
+  pairSeeds_.resize(nPairs());
+
+  // The initial individuals are evaluated in pairs of consecutive positions
+  nInitialPairsPending_ = nPairs();
+  pairs_.resize(nPairs());
+  for (int i = 0; i < nPairs(); ++i) {
+    pairs_[i].iParent1 = 2 * i;
+    pairs_[i].iParent2 = 2 * i + 1;
+  }
 }
 
 SearchAlgoDetCrowd::~SearchAlgoDetCrowd(void) {
   delete [] randPopulationInd_;
 
+  for (int i = 0; i < pairs_.size(); ++i) {
+    const QList<Individual*> &children = pairs_.at(i).children;
+    for (int j = 0; j < children.size(); ++j)
+      delete children.at(j);
+  }
+
   if (generation_) {
     int n = generation_->nIndividuals();
     for (int i = 0; i < n ; ++i)
@@ -54,53 +73,100 @@ QList<Individual*> SearchAlgoDetCrowd::calcInitialPopulation() {
   return generation_->individuals();
 }
 
-const QList<Individual*> &SearchAlgoDetCrowd::reproduce() {
+void SearchAlgoDetCrowd::chooseParents() {
   // Randomize parents
   MathAlgo::shuffle(populationSize_, randPopulationInd_);
 
-  // Create children
-  for (int i = 0; i < populationSize_; i = i + 2) {
-    Individual *parent1 = generation_->individual(randPopulationInd_[i]);
-    Individual *parent2 = generation_->individual(randPopulationInd_[i+1]);
-    Individual *child1, *child2;
-    Model *childModel1, *childModel2;
+  for (int i = 0; i < populationSize_; ++i)
+    parentIds_[i] = generation_->individual(randPopulationInd_[i])->id();
 
-    if (MathAlgo::rand100() < 75){ // Crossover
-      Model::cross(parent1->model(), parent2->model(), childModel1, childModel2);
+  int n = nPairs();
+  for (int i = 0; i < n; ++i)
+    pairSeeds_[i] = MathAlgo::rand_gen();
 
-      // Here because Individual caches the model complexity
-      childModel1->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
-      childModel2->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
+  children_.fill(NULL, populationSize_);
+}
 
-      child1 = new Individual(childModel1, parent1, parent2);
-      child2 = new Individual(childModel2, parent2, parent1);
-    } else { // No crossover
-      childModel1 = new Model(*parent1->model());
-      childModel2 = new Model(*parent2->model());
+// Called from any thread. The current generation does not change until the 
+// children are evaluated.
+void SearchAlgoDetCrowd::createChildPair(int iPair, Individual **child1,
+                                         Individual **child2) {
+  MathAlgo::ScopedRandStream randStream(pairSeeds_.at(iPair));
 
-      // Here because Individual caches the model complexity
-      childModel1->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
-      childModel2->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
+  int i = 2 * iPair;
+  createChildren(generation_->individual(randPopulationInd_[i]), 
+                 generation_->individual(randPopulationInd_[i+1]),
+                 parentIds_.at(i), parentIds_.at(i+1), child1, child2);
 
-      child1 = new Individual(childModel1, parent1);
-      child2 = new Individual(childModel2, parent2);
-    }
+  children_[i] = *child1;
+  children_[i+1] = *child2;
+}
 
-    children_.append(child1);
-    children_.append(child2);
-  }
+// The same prediction as for the individuals, taking the complexity of each
+// child as that of the parent it is closer to. -1 if there is no prediction.
+double SearchAlgoDetCrowd::expectedChildPairSimTime(int iPair) const {
+  int i = 2 * iPair;
+  const Individual *parent1 = generation_->individual(randPopulationInd_[i]);
+  const Individual *parent2 = generation_->individual(randPopulationInd_[i+1]);
 
-  return children_;
+  double t1 = Individual::expectedChildSimTime(parent1, parent2, 
+                                               parent1->complexity());
+  double t2 = Individual::expectedChildSimTime(parent2, parent1, 
+                                               parent2->complexity());
+  if (t1 < 0 || t2 < 0)
+    return -1;
+  else
+    return t1 + t2;
+}
+
+void SearchAlgoDetCrowd::createChildren(const Individual *parent1, 
+                                        const Individual *parent2,
+                                        int parent1Id, int parent2Id,
+                                        Individual **child1, 
+                                        Individual **child2) const {
+  Model *childModel1, *childModel2;
+
+  if (MathAlgo::rand100() < 75){ // Crossover
+    Model::cross(parent1->model(), parent2->model(), childModel1, childModel2);
+
+    // Here because Individual caches the model complexity
+    childModel1->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
+    childModel2->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
+
+    *child1 = new Individual(childModel1, parent1, parent2, parent1Id, 
+                             parent2Id);
+    *child2 = new Individual(childModel2, parent2, parent1, parent2Id, 
+                             parent1Id);
+  } else { // No crossover
+    childModel1 = new Model(*parent1->model());
+    childModel2 = new Model(*parent2->model());
+
+    // Here because Individual caches the model complexity
+    childModel1->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
+    childModel2->mutate(search_->inputLabels(), search_->outputLabels(), search_->maxProductLabel());
+
+    *child1 = new Individual(childModel1, parent1, NULL, parent1Id, -1);
+    *child2 = new Individual(childModel2, parent2, NULL, parent2Id, -1);
+  }
 }
 
 void SearchAlgoDetCrowd::chooseNextGeneration() {
+  int nTimeouts = 0;
+
   // All individuals are chosen in first generation
   if(children_.isEmpty()) {
     int numInd = generation_->nIndividuals();
-    for (int i=0; i < numInd; ++i)
+    for (int i=0; i < numInd; ++i) {
       search_->addNewIndividual(generation_->individual(i));
+      if (generation_->individual(i)->timedOut())
+        ++nTimeouts;
+    }
   } else {
     Generation *nextGeneration = deme_->createNextGeneration();
+
+    for (int i = 0; i < populationSize_; ++i)
+      if (children_.at(i)->timedOut())
+        ++nTimeouts;
     
     // Select new population
     for (int i = 0; i < populationSize_; i = i + 2) {
@@ -133,9 +199,133 @@ void SearchAlgoDetCrowd::chooseNextGeneration() {
     generation_ = nextGeneration;
   }
 
+  finishGeneration(nTimeouts);
+}
+
+// Until the initial population is evaluated, the parents of a pair are the
+// two initial individuals it evaluated. Afterwards, they are chosen at random
+// from the current generation, so a parent may be in more than one pair.
+const QList<Individual*> &SearchAlgoDetCrowd::reproducePair(int iPair) {
+  ChildPair &pair = pairs_[iPair];
+
+  if (nInitialPairsPending_ == 0) {
+    pair.iParent1 = MathAlgo::randInt(populationSize_);
+    pair.iParent2 = MathAlgo::randInt(populationSize_ - 1);
+    if (pair.iParent2 >= pair.iParent1)
+      ++pair.iParent2;
+  }
+
+  Individual *parent1 = generation_->individual(pair.iParent1);
+  Individual *parent2 = generation_->individual(pair.iParent2);
+  Individual *child1, *child2;
+  createChildren(parent1, parent2, parent1->id(), parent2->id(), &child1, 
+                 &child2);
+  pair.children.append(child1);
+  pair.children.append(child2);
+
+  return pair.children;
+}
+
+// A generation is complete when the deme has evaluated as many children as
+// individuals in the population. The first one, when the initial population
+// is evaluated.
+bool SearchAlgoDetCrowd::choosePairSurvivors(int iPair) {
+  ChildPair &pair = pairs_[iPair];
+
+  if (pair.children.isEmpty()) { // Initial individuals
+    Individual *ind1 = generation_->individual(pair.iParent1);
+    Individual *ind2 = generation_->individual(pair.iParent2);
+    search_->addNewIndividual(ind1);
+    search_->addNewIndividual(ind2);
+    nPairTimeouts_ += ind1->timedOut() + ind2->timedOut();
+
+    if (--nInitialPairsPending_ > 0)
+      return false;
+  } else {
+    Individual *child1 = pair.children.at(0);
+    Individual *child2 = pair.children.at(1);
+    nPairTimeouts_ += child1->timedOut() + child2->timedOut();
+    pair.children.clear();
+
+    // The parents may have been replaced by the children of other pairs
+    replaceParent(pair.iParent1, child1);
+    replaceParent(pair.iParent2, child2);
+
+    if (++nPairsEvaluated_ < nPairs() || nInitialPairsPending_ > 0)
+      return false;
+
+    nPairsEvaluated_ = 0;
+  }
+
+  finishGeneration(nPairTimeouts_);
+  nPairTimeouts_ = 0;
+
+  return true;
+}
+
+void SearchAlgoDetCrowd::replaceParent(int iParent, Individual *child) {
+  Individual *parent = generation_->individual(iParent);
+
+  if (child->error() <= parent->error()) {
+    generation_->replaceIndividual(iParent, child);
+    search_->addNewIndividual(child);
+    search_->removeIndividual(parent);
+  } else {
+    delete child;
+  }
+}
+
+// The current population continues in a new generation
+void SearchAlgoDetCrowd::startNextGeneration() {
+  Generation *nextGeneration = deme_->createNextGeneration();
+
+  for (int i = 0; i < populationSize_; ++i)
+    nextGeneration->addIndividual(generation_->individual(i));
+
+  generation_->clearIndividuals(); // Save some memory
+  generation_ = nextGeneration;
+}
+
+// The children being created are not written, since they are created again
+// from the parents and the seeds
+void SearchAlgoDetCrowd::writeState(QDataStream &stream) const {
+  for (int i = 0; i < populationSize_; ++i)
+    stream << (qint32) randPopulationInd_[i] << (qint32) parentIds_.at(i);
+
+  int n = nPairs();
+  for (int i = 0; i < n; ++i)
+    stream << pairSeeds_.at(i);
+
+  stream << isReproducing();
+}
+
+void SearchAlgoDetCrowd::readState(QDataStream &stream) {
+  generation_ = deme_->generations().last();
+
+  for (int i = 0; i < populationSize_; ++i) {
+    qint32 ind, parentId;
+    stream >> ind >> parentId;
+    randPopulationInd_[i] = ind;
+    parentIds_[i] = parentId;
+  }
+
+  int n = nPairs();
+  for (int i = 0; i < n; ++i)
+    stream >> pairSeeds_[i];
+
+  bool reproducing;
+  stream >> reproducing;
+  if (reproducing)
+    children_.fill(NULL, populationSize_);
+  else
+    children_.clear();
+}
+
+void SearchAlgoDetCrowd::finishGeneration(int nTimeouts) {
   // Minimum 1 second for better log show
   generation_->setTime(1 + search_->startDatetime().secsTo(
                                               QDateTime::currentDateTimeUtc()));
+  generation_->setNTimeouts(nTimeouts);
   generation_->calcPopulSta();
 }
 
@@ -3,7 +3,10 @@
 
 #pragma once
 
+#include "errorcalculator.h"
 #include <QList>
+#include <QVector>
+#include <QDataStream>
 
 namespace LoboLab {
 
@@ -15,29 +18,68 @@ class Individual;
 class DB;
 class Product;
 
-class SearchAlgoDetCrowd {
+class SearchAlgoDetCrowd : public ChildPairCreator {
  public:
   SearchAlgoDetCrowd(Deme *deme, Search *s);
   ~SearchAlgoDetCrowd(void);
   
   inline Deme *deme() const { return deme_; }
   inline Generation *currentGeneration() const { return generation_; }
+  inline QList<Individual*> children() const { return children_.toList(); }
+  inline bool isReproducing() const { return !children_.isEmpty(); }
 
   QList<Individual*> calcInitialPopulation();
-  const QList<Individual*> &reproduce();
+  // The parents and the random seed of each pair of children are chosen in
+  // order, and then each pair can be created in any thread, so the children
+  // do not depend on the threads or the order in which they are created.
+  void chooseParents();
+  void createChildPair(int iPair, Individual **child1, Individual **child2);
+  double expectedChildPairSimTime(int iPair) const;
   void chooseNextGeneration();
 
+  // Asynchronous steady-state mode. Each pair of children competes with its
+  // parents as soon as it is evaluated, replacing them in the current 
+  // generation.
+  inline int nPairs() const { return populationSize_ / 2; }
+  const QList<Individual*> &reproducePair(int iPair);
+  bool choosePairSurvivors(int iPair); // True if a generation is complete
+  void startNextGeneration();
+
+  // Checkpoints of the generational mode. The deme is restored before, and
+  // its last generation is the current one. If it was reproducing, the 
+  // children must be created again.
+  void writeState(QDataStream &stream) const;
+  void readState(QDataStream &stream);
+
  private:
+  struct ChildPair {
+    int iParent1;
+    int iParent2;
+    QList<Individual*> children; // Empty for the initial individuals
+  };
+
   Individual *newRandIndividual() const;
+  void createChildren(const Individual *parent1, const Individual *parent2,
+                      int parent1Id, int parent2Id, Individual **child1,
+                      Individual **child2) const;
+  void replaceParent(int iParent, Individual *child);
+  void finishGeneration(int nTimeouts);
   
   Search *search_;
   Deme *deme_;
 
   SearchParams *searchParams_;
   Generation *generation_;
-  QList<Individual*> children_;
+  QVector<Individual*> children_; // Each pair sets only its own positions
   int populationSize_;
   int *randPopulationInd_;
+  QVector<int> parentIds_; // In the order of randPopulationInd_
+  QVector<quint64> pairSeeds_;
+
+  QVector<ChildPair> pairs_;
+  int nInitialPairsPending_;
+  int nPairsEvaluated_; // In the current generation
+  int nPairTimeouts_;
 
 };
 
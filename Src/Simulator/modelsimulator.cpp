@@ -30,7 +30,8 @@ ModelSimulator::ModelSimulator()
     degradations_(NULL), degradationFactors_(NULL),
     rates1_(NULL), rates2_(NULL), rates3_(NULL), rates4_(NULL), rates5_(NULL),
     rates6_(NULL), rates7_(NULL), rates8_(NULL), rates9_(NULL), rates10_(NULL),
-    nOps_(0), nAllocatedOps_(0), ops_(NULL) {
+    nOps_(0), nAllocatedOps_(0), ops_(NULL),
+    maxRateEvals_(0), maxMsecs_(0), nRateEvals_(0) {
 }
 
 ModelSimulator::~ModelSimulator() {
@@ -90,12 +91,7 @@ void ModelSimulator::loadModel(const Model &model, bool includeAllFeatures) {
   clearLabels();
   QSet<int> labelSet = model.calcProductLabelsInUse(includeAllFeatures);
 
-  labels_ = labelSet.toList();
-
-  std::sort(labels_.begin(), labels_.end(), [model](int a, int b) {
-    return model.prodWithLabel(a)->type() < model.prodWithLabel(b)->type()
-             || (a < b) ;
-  });
+  labels_ = model.calcSortedProductLabelsInUse(includeAllFeatures);
   nProducts_ = labels_.size();
   nConstRateProducts_ = 0;
   nIntermediateProducts_ = 0;
@@ -134,7 +130,7 @@ void ModelSimulator::loadModel(const Model &model, bool includeAllFeatures) {
   QList<SimOp*> opsList; // Temporary storage for the operations
   for (int i = 0; i < nProducts_; ++i) {
     // Process product constants
-    ModelProd *prod = model.prodWithLabel(labels_.at(i));
+    const ModelProd *prod = model.prodWithLabel(labels_.at(i));
     productions_[i] = 1;
     limits_[i] = prod->lim();
     constRates_[i] = 0;
@@ -147,15 +143,15 @@ void ModelSimulator::loadModel(const Model &model, bool includeAllFeatures) {
       outputLabels_.append(prod->label());
 
     // Process product links
-    QList<ModelLink*> links = model.linksToLabel(labels_.at(i));
+    QList<const ModelLink*> links = model.linksToLabel(labels_.at(i));
 
     // Categorize links
     int n = links.size();
 
-    QList<ModelLink*> orLinks;
-    QList<ModelLink*> andLinks;
+    QList<const ModelLink*> orLinks;
+    QList<const ModelLink*> andLinks;
     for (int j = 0; j < n; ++j) {
-      ModelLink *link = links[j];
+      const ModelLink *link = links[j];
       if (labelSet.contains(link->regulatorProdLabel())) {
         if (link->isAndReg())
           andLinks.append(link);
@@ -190,10 +186,23 @@ void ModelSimulator::loadModel(const Model &model, bool includeAllFeatures) {
   h_ = hini;
   errold_ = erroldini;
   success_ = true;
+
+  nRateEvals_ = 0;
+  budgetTimer_.start();
+}
+
+void ModelSimulator::setBudget(qint64 maxRateEvals, qint64 maxMsecs) {
+  maxRateEvals_ = maxRateEvals;
+  maxMsecs_ = maxMsecs;
 }
 
-QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<ModelLink*> &orLinks,
-  const QList<ModelLink*>& andLinks) {
+bool ModelSimulator::budgetExceeded() const {
+  return (maxRateEvals_ > 0 && nRateEvals_ > maxRateEvals_) ||
+         (maxMsecs_ > 0 && budgetTimer_.elapsed() > maxMsecs_);
+}
+
+QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<const ModelLink*> &orLinks,
+  const QList<const ModelLink*>& andLinks) {
 
   QList<SimOp*> opsList;
   bool regulTempUsed = false;
@@ -204,7 +213,7 @@ QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<ModelLink*> &o
   // Process OR links
     int n = orLinks.size();
     for (int i = 0; i < n; ++i) {
-      ModelLink *link = orLinks[i];
+      const ModelLink *link = orLinks[i];
       if (link->hillCoef() >= 0) {
         if (!regulTempUsed) {
           opsList.append(new SimOpZero(&regul_[p]));
@@ -218,7 +227,7 @@ QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<ModelLink*> &o
     // Process AND links
     n = andLinks.size();
     for (int i = 0; i < n; ++i) {
-      ModelLink *link = andLinks[i];
+      const ModelLink *link = andLinks[i];
       if (link->hillCoef() >= 0) {
         if (!regulTempUsed) {
           opsList.append(new SimOpOne(&regul_[p]));
@@ -235,7 +244,7 @@ QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<ModelLink*> &o
     // Process division for And links 
     n = andLinks.size();
     for (int i = 0; i < n; ++i) {
-      ModelLink *link = andLinks[i];
+      const ModelLink *link = andLinks[i];
       opsList.append(new SimOpDiv(&oldConcs_[labels2Ind_[link->regulatorProdLabel()]],
         link->disConst(), fabs(link->hillCoef()), &regul_[p]));
     }
@@ -243,7 +252,7 @@ QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<ModelLink*> &o
     // Process division for Or links
     n = orLinks.size();
     for (int i = 0; i < n; ++i) {
-      ModelLink *link = orLinks[i];
+      const ModelLink *link = orLinks[i];
       opsList.append(new SimOpDiv(&oldConcs_[labels2Ind_[link->regulatorProdLabel()]],
         link->disConst(), fabs(link->hillCoef()), &regul_[p]));
     }
@@ -251,7 +260,7 @@ QList<SimOp*> ModelSimulator::createProductOps(int p, const QList<ModelLink*> &o
   return opsList;
 }
 
-SimOp *ModelSimulator::createHillOpForLink(ModelLink *link, double *to) const {
+SimOp *ModelSimulator::createHillOpForLink(const ModelLink *link, double *to) const {
   if (link->hillCoef() >= 0)
     return new SimOpHillAct(
              &oldConcs_[labels2Ind_[link->regulatorProdLabel()]],
@@ -373,6 +382,8 @@ const double ModelSimulator::safe = 0.9;
 const double ModelSimulator::minscale = 0.333;
 const double ModelSimulator::maxscale = 6.0;
 
+const double ModelSimulator::BudgetExceededError = -3.0;
+
 // 8th order Runge-Kutta with adaptive stepsize
 // See Numerical recipes, 3rd ed, Chapter 17 for an introduction
 double ModelSimulator::simulate(double tSpan, SimState &state, bool rateCheck) {
@@ -393,10 +404,16 @@ double ModelSimulator::simulate(double tSpan, SimState &state, bool rateCheck) {
       oldConcs_[i] = y[i];
     }
     calcRates(rates1_);
+    nRateEvals_++;
 
     double hnext;
     do { // Loop until found a small enough timestep with a successful integration
       double errRat = integrate(y);
+      nRateEvals_ += 11;
+      // Checked on every attempt: stiff models can fail many steps above hmin
+      if (budgetExceeded())
+        return BudgetExceededError;
+
       hnext = checkSuccess(errRat);
       if (!success_) {
         hovershot = 0;
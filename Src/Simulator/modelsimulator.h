@@ -6,6 +6,7 @@
 #include <QList>
 #include <QHash>
 #include <QSize>
+#include <QElapsedTimer>
 
 #include "Common/mathalgo.h"
 #include "Experiment/experiment.h"
@@ -26,6 +27,11 @@ class ModelSimulator {
   void loadModel(const Model &model, bool includeAllFeatures = false);
   double simulate(double tSpan, SimState &state, bool rateCheck = true);
 
+  // Limits the computation per loaded model (0 means no limit). When the 
+  // budget is exceeded, simulate() returns BudgetExceededError.
+  void setBudget(qint64 maxRateEvals, qint64 maxMsecs);
+  static const double BudgetExceededError;
+
   void setProdRate(int label, double rate);
   void blockProductProduction(int label);
   void applyDegradationFactor(int label, double factor);
@@ -49,12 +55,13 @@ class ModelSimulator {
  private:
   ModelSimulator(const ModelSimulator &source);
   ModelSimulator &operator=(const ModelSimulator &source);
-  QList<SimOp*> createProductOps(int p, const QList<ModelLink*> &orLinks,
-    const QList<ModelLink*>& andLinks);
-  SimOp *createHillOpForLink(ModelLink *link, double *to) const;
+  QList<SimOp*> createProductOps(int p, const QList<const ModelLink*> &orLinks,
+    const QList<const ModelLink*>& andLinks);
+  SimOp *createHillOpForLink(const ModelLink *link, double *to) const;
   double integrate(const double*);
   void calcRates(double *rates);
   double checkSuccess(double errRat);
+  bool budgetExceeded() const;
 
   QList<int> labels_;
   QHash<int, int> labels2Ind_;
@@ -99,6 +106,12 @@ class ModelSimulator {
 
   QList<int> outputLabels_;
 
+  // Budget per loaded model
+  qint64 maxRateEvals_;
+  qint64 maxMsecs_;
+  qint64 nRateEvals_;
+  QElapsedTimer budgetTimer_;
+
   // Constants
   static const double b1, b6, b7, b8, b9, b10, b11, b12, bhh1, bhh2, bhh3,
     er1, er6, er7, er8, er9, er10, er11, er12,
@@ -45,6 +45,10 @@ namespace LoboLab {
     void loadExperiment(const Experiment *exp);
     void initialize();
 
+    inline void setBudget(qint64 maxRateEvals, qint64 maxMsecs) {
+      modelSimulator_.setBudget(maxRateEvals, maxMsecs);
+    }
+
     double simulateWithoutPhenotypes(double timePeriod, bool rateCheck = true);
     double simulate(double timePeriod, bool rateCheck = true);
 
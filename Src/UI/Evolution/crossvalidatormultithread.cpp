@@ -0,0 +1,150 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "crossvalidatormultithread.h"
+#include "Search/crossvalidation.h"
+#include "Search/evaluatorproducts.h"
+#include "Search/individual.h"
+#include "Search/search.h"
+#include "Common/log.h"
+
+#include <limits>
+
+namespace LoboLab {
+
+CrossValidatorMultiThread::CrossValidatorMultiThread(int nThreads, 
+                                                     const Search &search)
+  : nThreads_(nThreads),
+    search_(search),
+    crossValidation_(NULL) {
+}
+
+CrossValidatorMultiThread::~CrossValidatorMultiThread(void) {
+}
+
+void CrossValidatorMultiThread::evaluate(CrossValidation *crossValidation,
+                                       const QList<Individual*> &individuals) {
+  crossValidation_ = crossValidation;
+  individuals_ = individuals;
+
+  int nInds = individuals_.size();
+  int nFolds = crossValidation_->nFolds();
+  trainErrors_.fill(-1, nInds * nFolds);
+  testErrors_.fill(-1, nInds * nFolds);
+
+  for (int i = 0; i < nInds; ++i) {
+    for (int j = 0; j < nFolds; ++j) {
+      Job job = {i, j};
+      pendJobs_.enqueue(job);
+    }
+  }
+
+  Log::write() << "CrossValidatorMultiThread::evaluate: " << nInds << 
+    " individuals, " << nFolds << " folds, " << nThreads_ << " threads." << 
+    endl;
+
+  QList<CalculatorThread*> threads;
+  for (int i = 0; i < nThreads_; ++i) {
+    CalculatorThread *thread = new CalculatorThread(search_, this);
+    threads.append(thread);
+    thread->start();
+  }
+
+  for (int i = 0; i < nThreads_; ++i) {
+    threads.at(i)->wait();
+    delete threads.at(i);
+  }
+
+  // Scores are added from this thread, once all the folds are evaluated
+  for (int i = 0; i < nInds; ++i) {
+    double meanTestError = 0;
+    int nFailedFolds = 0;
+    for (int j = 0; j < nFolds; ++j) {
+      double trainError = trainErrors_.at(i * nFolds + j);
+      double testError = testErrors_.at(i * nFolds + j);
+      Q_ASSERT_X(trainError >= 0 && testError >= 0,
+                 "CrossValidatorMultiThread::evaluate",
+                 "Simulator error not replaced by the failure error");
+      if (trainError == Individual::TimeoutError || 
+          testError == Individual::TimeoutError)
+        ++nFailedFolds;
+
+      crossValidation_->addScore(individuals_.at(i), j, trainError, 
+                                 testError);
+      meanTestError += testError / nFolds;
+    }
+
+    Log::write() << "CrossValidatorMultiThread::evaluate: individual " <<
+      individuals_.at(i)->id() << " comp " << individuals_.at(i)->complexity() <<
+      " error " << individuals_.at(i)->error() << " mean test error " << 
+      meanTestError;
+    if (nFailedFolds > 0)
+      Log::write() << " failed folds " << nFailedFolds;
+    Log::write() << endl;
+  }
+
+  crossValidation_ = NULL;
+  individuals_.clear();
+}
+
+bool CrossValidatorMultiThread::takeNextJob(Job *job) {
+  bool found;
+
+  mutex_.lock();
+  found = !pendJobs_.isEmpty();
+  if (found)
+    *job = pendJobs_.dequeue();
+  mutex_.unlock();
+
+  return found;
+}
+
+// class CalculatorThread
+
+CrossValidatorMultiThread::CalculatorThread::CalculatorThread(
+    const Search &search,
+    CrossValidatorMultiThread *p)
+  : parent_(p) {
+  evaluator_ = new EvaluatorProducts(search);
+}
+
+CrossValidatorMultiThread::CalculatorThread::~CalculatorThread() {
+  wait();
+  delete evaluator_;
+}
+
+void CrossValidatorMultiThread::CalculatorThread::run() {
+  setPriority(LowestPriority);
+
+  const double maxError = std::numeric_limits<double>::max();
+  CrossValidation *crossValidation = parent_->crossValidation_;
+  int nFolds = crossValidation->nFolds();
+  // Each job writes its own position, so no locking is needed
+  double *trainErrors = parent_->trainErrors_.data();
+  double *testErrors = parent_->testErrors_.data();
+
+  Job job;
+  while (parent_->takeNextJob(&job)) {
+    const Model &model = *parent_->individuals_.at(job.iInd)->model();
+    int i = job.iInd * nFolds + job.iFold;
+
+    trainErrors[i] = calcFoldError(model, 
+      crossValidation->trainExperiments(job.iFold), maxError);
+    testErrors[i] = calcFoldError(model, 
+      crossValidation->testExperiments(job.iFold), maxError);
+  }
+}
+
+// A simulator error scores the fold with the error of the failed individuals
+// of the evolution, so that a model that cannot be simulated scores the worst
+double CrossValidatorMultiThread::CalculatorThread::calcFoldError(
+    const Model &model, const QList<Experiment*> &experiments, 
+    double maxError) {
+  double error = evaluator_->evaluate(model, experiments, maxError);
+  if (error < 0.0)
+    error = Individual::TimeoutError;
+
+  return error;
+}
+
+}
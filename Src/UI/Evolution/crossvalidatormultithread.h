@@ -0,0 +1,69 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QList>
+#include <QThread>
+#include <QMutex>
+#include <QQueue>
+#include <QVector>
+
+namespace LoboLab {
+
+class EvaluatorProducts;
+class CrossValidation;
+class Individual;
+class Experiment;
+class Model;
+class Search;
+
+// Evaluates a set of individuals on every fold of a cross-validation, 
+// distributing the (individual, fold) pairs among several threads.
+class CrossValidatorMultiThread {
+
+ public:
+  CrossValidatorMultiThread(int nThreads, const Search &search);
+  ~CrossValidatorMultiThread(void);
+
+  void evaluate(CrossValidation *crossValidation, 
+                const QList<Individual*> &individuals);
+
+ private:
+  struct Job {
+    int iInd;
+    int iFold;
+  };
+
+  class CalculatorThread : public QThread {
+   public:
+    CalculatorThread(const Search &search, CrossValidatorMultiThread *parent);
+    ~CalculatorThread(void);
+
+   protected:
+    void run();
+
+   private:
+    double calcFoldError(const Model &model, 
+                         const QList<Experiment*> &experiments, 
+                         double maxError);
+
+    EvaluatorProducts *evaluator_;
+    CrossValidatorMultiThread *parent_;
+  };
+
+  bool takeNextJob(Job *job);
+
+  int nThreads_;
+  const Search &search_;
+
+  CrossValidation *crossValidation_;
+  QList<Individual*> individuals_;
+  QQueue<Job> pendJobs_;
+  QVector<double> trainErrors_;
+  QVector<double> testErrors_;
+
+  QMutex mutex_;
+};
+
+} // namespace LoboLab
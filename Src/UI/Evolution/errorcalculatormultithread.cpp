@@ -8,6 +8,7 @@
 #include "Search/searchparams.h"
 #include "Common/log.h"
 #include <iostream>
+#include <algorithm>
 #include <time.h>
 
 namespace LoboLab {
@@ -16,122 +17,260 @@ ErrorCalculatorMultiThread::ErrorCalculatorMultiThread(int nDemes,
   int nThreads, const Search &search)
     : ErrorCalculator(), 
       nDemes_(nDemes),
-      nIndQueuedDeme_(nDemes_, 0),
-      nIndPendDeme_(nDemes_, 0) {
+      nIndPendDeme_(new QAtomicInt[nDemes]),
+      endThreads_(0),
+      nextThread_(0) {
     
-  for (int i = 0; i < nThreads; ++i) {
-    CalculatorThread *thread = new CalculatorThread(search, this);
-    calculatorThreads_.append(thread);
-    thread->start();
-  }
+  for (int i = 0; i < nThreads; ++i)
+    calculatorThreads_.append(new CalculatorThread(search, this, i));
+
+  // Started after creating all of them, since any thread can steal from others
+  for (int i = 0; i < nThreads; ++i)
+    calculatorThreads_.at(i)->start();
 }
 
 ErrorCalculatorMultiThread::~ErrorCalculatorMultiThread(void) {
-  for (int i = 0; i < calculatorThreads_.size(); ++i) {
-    CalculatorThread *thread = calculatorThreads_.at(i);
-    thread->stopThread();
-    delete thread;
-  }
+  stopThreads();
+
+  for (int i = 0; i < calculatorThreads_.size(); ++i)
+    delete calculatorThreads_.at(i);
+
+  delete [] nIndPendDeme_;
 }
 
+// The individuals are sorted by expected simulation time and dealt in turn
+// to the thread queues, starting at a rotating thread, so that the longest 
+// individuals of a deme run in parallel. Each queue is locked only once per 
+// call.
 void ErrorCalculatorMultiThread::process(int iDeme,
                                         const QList<Individual*> &individuals) {
-  mutex_.lock();
+  int nInds = individuals.size();
+  if (nInds == 0) {
+    demeReady(iDeme);
+    return;
+  }
 
-  pendDemeQueue_.enqueue(iDeme);
-  pendIndQueue_.append(individuals);
-  nIndQueuedDeme_[iDeme] = individuals.size();
-  nIndPendDeme_[iDeme] = individuals.size();
+  QList<Individual*> sortedInds = individuals;
+  qStableSort(sortedInds.begin(), sortedInds.end(), 
+              indExpectedSimTimeGreaterThan);
 
-  threadsCondition_.wakeAll();
-  
-  mutex_.unlock();
+  QList<Job> jobs;
+  jobs.reserve(nInds);
+  for (int i = 0; i < nInds; ++i) {
+    Individual *ind = sortedInds.at(i);
+    Job job = {ind, NULL, -1, iDeme, ind->expectedSimTime()};
+    jobs.append(job);
+  }
+
+  pushJobs(iDeme, jobs);
 }
 
-int ErrorCalculatorMultiThread::waitForAnyDeme() {
-  mutex_.lock();
+// Each pair of children is created and calculated by the same thread, so the
+// search thread only chooses the parents
+void ErrorCalculatorMultiThread::processChildPairs(int iDeme, 
+                                                   ChildPairCreator *creator,
+                                                   int nPairs) {
+  if (nPairs == 0) {
+    demeReady(iDeme);
+    return;
+  }
 
-  while (readyDemeQueue_.isEmpty())
-    parentCondition_.wait(&mutex_);
+  QList<Job> jobs;
+  jobs.reserve(nPairs);
+  for (int i = 0; i < nPairs; ++i) {
+    Job job = {NULL, creator, i, iDeme, creator->expectedChildPairSimTime(i)};
+    jobs.append(job);
+  }
+  qStableSort(jobs.begin(), jobs.end(), jobLongerThan);
 
-  int iDemeReady = readyDemeQueue_.dequeue();
+  pushJobs(iDeme, jobs);
+}
 
-  mutex_.unlock();
+void ErrorCalculatorMultiThread::pushJobs(int iDeme, 
+                                          const QList<Job> &sortedJobs) {
+  int nJobs = sortedJobs.size();
+  nIndPendDeme_[iDeme].storeRelease(nJobs);
+
+  int nThreads = calculatorThreads_.size();
+  QVector<QList<Job> > threadJobs(nThreads);
+  for (int i = 0; i < nJobs; ++i)
+    threadJobs[(nextThread_ + i) % nThreads].append(sortedJobs.at(i));
+  nextThread_ = (nextThread_ + nJobs) % nThreads;
+
+  for (int i = 0; i < nThreads; ++i)
+    if (!threadJobs.at(i).isEmpty())
+      calculatorThreads_.at(i)->pushJobs(threadJobs.at(i));
+
+  pendJobs_.release(nJobs);
+}
+
+// Must be called before processing any individual
+void ErrorCalculatorMultiThread::setBudget(qint64 maxRateEvals, 
+                                           qint64 maxMsecs) {
+  for (int i = 0; i < calculatorThreads_.size(); ++i)
+    calculatorThreads_.at(i)->setBudget(maxRateEvals, maxMsecs);
+}
+
+int ErrorCalculatorMultiThread::waitForAnyDeme() {
+  readyDemes_.acquire();
+
+  readyMutex_.lock();
+  int iDemeReady = readyDemeQueue_.dequeue();
+  readyMutex_.unlock();
 
   return iDemeReady;
 }
 
+// Unknown times first, as indExpectedSimTimeGreaterThan
+bool ErrorCalculatorMultiThread::jobLongerThan(const Job &job1, 
+                                               const Job &job2) {
+  if (job1.individual && job2.individual)
+    return indExpectedSimTimeGreaterThan(job1.individual, job2.individual);
+
+  double t1 = job1.expectedSimTime;
+  double t2 = job2.expectedSimTime;
+  if (t1 < 0 || t2 < 0)
+    return t1 < 0 && t2 >= 0;
+  else
+    return t1 > t2;
+}
+
+void ErrorCalculatorMultiThread::jobFinished(int iDeme) {
+  // The ordered decrement makes the errors set by other threads visible to
+  // the thread that finishes the deme
+  if (nIndPendDeme_[iDeme].fetchAndAddOrdered(-1) == 1)
+    demeReady(iDeme);
+}
+
+void ErrorCalculatorMultiThread::demeReady(int iDeme) {
+  readyMutex_.lock();
+  readyDemeQueue_.enqueue(iDeme);
+  readyMutex_.unlock();
+
+  readyDemes_.release();
+}
+
+void ErrorCalculatorMultiThread::stopThreads() {
+  endThreads_.storeRelease(1);
+
+  int nThreads = calculatorThreads_.size();
+  pendJobs_.release(nThreads); // Wake up every thread
+  for (int i = 0; i < nThreads; ++i)
+    calculatorThreads_.at(i)->wait();
+}
+
 // class CalculatorThread
 
 ErrorCalculatorMultiThread::CalculatorThread::CalculatorThread(
     const Search &search,
-    ErrorCalculatorMultiThread *p)
-  : parent_(p) {
+    ErrorCalculatorMultiThread *p,
+    int iThread)
+  : parent_(p),
+    iThread_(iThread) {
   evaluator_ = new EvaluatorProducts(search);
 }
 
 ErrorCalculatorMultiThread::CalculatorThread::~CalculatorThread() {
-  stopThread();
+  wait();
   delete evaluator_;
 }
 
 void ErrorCalculatorMultiThread::CalculatorThread::run() {
   setPriority(LowestPriority);
 
-  parent_->mutex_.lock();
-  endThread_ = false;
+  forever {
+    // Each acquired resource guarantees one job in some queue
+    parent_->pendJobs_.acquire();
+    if (parent_->endThreads_.loadAcquire())
+      break;
 
-  while (!endThread_) {
-    if (parent_->pendIndQueue_.isEmpty())
-      waitForIndividuals();
-    else
-      processNextIndividual();
+    Job job;
+    while (!takeJob(&job))
+      yieldCurrentThread(); // Taken by a thread that scanned the queues first
+
+    if (job.individual) {
+      calcIndividual(job.individual);
+    } else {
+      Individual *child1, *child2;
+      job.creator->createChildPair(job.iPair, &child1, &child2);
+      calcIndividual(child1);
+      calcIndividual(child2);
+    }
+
+    parent_->jobFinished(job.iDeme);
   }
+}
 
-  parent_->mutex_.unlock();
+void ErrorCalculatorMultiThread::CalculatorThread::calcIndividual(
+    Individual *individual) {
+  double error, simTime;
+  QList<double> contributions;
+  calcError(*individual->model(), individual->parentError(), &error, 
+            &simTime, &contributions);
+  // Any simulator failure gets the worst error, but only a budget overrun
+  // is a timeout
+  if (error == ModelSimulator::BudgetExceededError)
+    individual->setTimedOut(true);
+  if (error < 0.0)
+    error = Individual::TimeoutError;
+  individual->setError(error);
+  individual->setSimTime(simTime);
+  individual->setExperimentErrors(evaluator_->search(), 
+    evaluator_->experimentChecksums(), contributions);
 }
 
-void ErrorCalculatorMultiThread::CalculatorThread::processNextIndividual() {
-  Individual *nextInd = parent_->pendIndQueue_.dequeue();
-  int iDeme = parent_->pendDemeQueue_.head();
+// The jobs are stolen from the same end as they are taken, since the longest
+// job is the one that most delays the completion of its deme
+bool ErrorCalculatorMultiThread::CalculatorThread::takeJob(Job *job) {
+  if (popJob(job))
+    return true;
 
-  if (--parent_->nIndQueuedDeme_[iDeme] == 0) // last individual in queue from deme
-    parent_->pendDemeQueue_.dequeue();
+  const QList<CalculatorThread*> &threads = parent_->calculatorThreads_;
+  int nThreads = threads.size();
+  for (int i = 1; i < nThreads; ++i)
+    if (threads.at((iThread_ + i) % nThreads)->popJob(job))
+      return true;
 
-  parent_->mutex_.unlock();
+  return false;
+}
 
-  double error, simTime;
-  calcError(*nextInd->model(), nextInd->parentError(), &error, &simTime);
-  nextInd->setError(error);
-  nextInd->setSimTime(simTime);
-  
-  parent_->mutex_.lock();
-
-  if (--parent_->nIndPendDeme_[iDeme] == 0) { // last individual processed in deme
-    parent_->readyDemeQueue_.enqueue(iDeme);
-    parent_->parentCondition_.wakeOne();
+// The queue is kept sorted by expected simulation time, the longest first, 
+// also among the jobs of different demes. The new jobs must be sorted.
+void ErrorCalculatorMultiThread::CalculatorThread::pushJobs(
+    const QList<Job> &jobs) {
+  jobsMutex_.lock();
+  QList<Job>::iterator pos = jobs_.begin();
+  int n = jobs.size();
+  for (int i = 0; i < n; ++i) {
+    pos = std::upper_bound(pos, jobs_.end(), jobs.at(i), jobLongerThan);
+    pos = jobs_.insert(pos, jobs.at(i)) + 1;
   }
+  jobsMutex_.unlock();
+}
+
+bool ErrorCalculatorMultiThread::CalculatorThread::popJob(Job *job) {
+  jobsMutex_.lock();
+  bool found = !jobs_.isEmpty();
+  if (found)
+    *job = jobs_.takeFirst();
+  jobsMutex_.unlock();
+
+  return found;
+}
+
+void ErrorCalculatorMultiThread::CalculatorThread::setBudget(
+    qint64 maxRateEvals, qint64 maxMsecs) {
+  evaluator_->setBudget(maxRateEvals, maxMsecs);
 }
 
 void ErrorCalculatorMultiThread::CalculatorThread::calcError(const Model &model, 
                                                              double maxError,
                                                              double *error, 
-                                                             double *simTime) {
+                                                             double *simTime,
+                                               QList<double> *contributions) {
   timer_.start();
-  *error = evaluator_->evaluate(model, maxError);
+  *error = evaluator_->evaluate(model, maxError, contributions);
   *simTime = timer_.elapsed() / 1000.0;
 }
 
-void ErrorCalculatorMultiThread::CalculatorThread::waitForIndividuals() {
-  parent_->threadsCondition_.wait(&parent_->mutex_);
-}
-
-void ErrorCalculatorMultiThread::CalculatorThread::stopThread() {
-  parent_->mutex_.lock();
-  endThread_ = true;
-  parent_->threadsCondition_.wakeAll();
-  parent_->mutex_.unlock();
-  wait();
 }
-
-}
\ No newline at end of file
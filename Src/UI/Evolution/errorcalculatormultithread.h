@@ -7,7 +7,8 @@
 #include <QList>
 #include <QThread>
 #include <QMutex>
-#include <QWaitCondition>
+#include <QSemaphore>
+#include <QAtomicInt>
 #include <QQueue>
 #include <QVector>
 #include <QElapsedTimer>
@@ -18,6 +19,13 @@ class EvaluatorProducts;
 class Model;
 class DB;
 
+// Work-stealing pool of calculator threads. Each thread has its own queue of
+// individuals, protected by its own mutex and sorted by expected simulation
+// time. When its queue is empty, a thread steals the longest individual from 
+// the other queues. A job can also be a pair of children, which the thread
+// creates before calculating them. The jobs pending in each deme are counted
+// atomically, and the deme is notified to the search thread when its last 
+// job is calculated.
 class ErrorCalculatorMultiThread : public ErrorCalculator {
 
  public:
@@ -25,44 +33,63 @@ class ErrorCalculatorMultiThread : public ErrorCalculator {
   virtual ~ErrorCalculatorMultiThread(void);
 
   void process(int iDeme, const QList<Individual*> &individuals);
+  void processChildPairs(int iDeme, ChildPairCreator *creator, int nPairs);
   int waitForAnyDeme();
 
+  void setBudget(qint64 maxRateEvals, qint64 maxMsecs);
+
  private:
+  struct Job {
+    Individual *individual; // NULL for a pair of children to create
+    ChildPairCreator *creator;
+    int iPair;
+    int iDeme;
+    double expectedSimTime;
+  };
 
   class CalculatorThread : public QThread {
    public:
-    CalculatorThread(const Search &search, ErrorCalculatorMultiThread *parent);
+    CalculatorThread(const Search &search, ErrorCalculatorMultiThread *parent,
+                     int iThread);
     ~CalculatorThread(void);
 
-    void stopThread();
+    void pushJobs(const QList<Job> &jobs);
+    bool popJob(Job *job); // Takes the longest job
+    void setBudget(qint64 maxRateEvals, qint64 maxMsecs);
 
    protected:
     void run();
 
    private:
-    void processNextIndividual();
-    void waitForIndividuals(); 
+    bool takeJob(Job *job);
+    void calcIndividual(Individual *individual);
     void calcError(const Model &model, double maxError, double *error,
-                   double *simTime);
+                   double *simTime, QList<double> *contributions);
 
     EvaluatorProducts *evaluator_;
     ErrorCalculatorMultiThread *parent_;
-    Individual* individual_;
+    int iThread_;
 
-    bool endThread_;
+    QList<Job> jobs_;
+    QMutex jobsMutex_;
     QElapsedTimer timer_;
   };
 
+  static bool jobLongerThan(const Job &job1, const Job &job2);
+  void pushJobs(int iDeme, const QList<Job> &sortedJobs);
+  void jobFinished(int iDeme);
+  void demeReady(int iDeme);
+  void stopThreads();
+
   int nDemes_;
-  QQueue<int> pendDemeQueue_;
+  QAtomicInt *nIndPendDeme_;
+  QAtomicInt endThreads_;
+  QSemaphore pendJobs_; // One resource per queued individual
+  int nextThread_; // Only accessed from the search thread
+
   QQueue<int> readyDemeQueue_;
-  QQueue<Individual*> pendIndQueue_;
-  QVector<int> nIndQueuedDeme_;
-  QVector<int> nIndPendDeme_;
-  
-  QMutex mutex_;
-  QWaitCondition threadsCondition_;
-  QWaitCondition parentCondition_;
+  QMutex readyMutex_;
+  QSemaphore readyDemes_;
 
   QList<CalculatorThread*> calculatorThreads_;
 };
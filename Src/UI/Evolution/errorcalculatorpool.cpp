@@ -0,0 +1,150 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "errorcalculatorpool.h"
+#include "evaluationpool.h"
+#include "Search/evaluatorproducts.h"
+#include "Search/individual.h"
+#include "Simulator/modelsimulator.h"
+#include <QElapsedTimer>
+
+namespace LoboLab {
+
+ErrorCalculatorPool::ErrorCalculatorPool(int nUnits, EvaluationPool *pool,
+                                         const Search &search)
+    : ErrorCalculator(),
+      pool_(pool),
+      nUnits_(nUnits),
+      nIndPendUnit_(new QAtomicInt[nUnits]),
+      nEvaluated_(0) {
+  int nThreads = pool_->nThreads();
+  for (int i = 0; i < nThreads; ++i)
+    evaluators_.append(new EvaluatorProducts(search));
+
+  pool_->addCalculator(this);
+}
+
+// All the units processed must have been waited for
+ErrorCalculatorPool::~ErrorCalculatorPool(void) {
+  pool_->removeCalculator(this);
+
+  for (int i = 0; i < evaluators_.size(); ++i)
+    delete evaluators_.at(i);
+
+  delete [] nIndPendUnit_;
+}
+
+void ErrorCalculatorPool::process(int iUnit, 
+                                  const QList<Individual*> &individuals) {
+  int nInds = individuals.size();
+  if (nInds == 0) {
+    unitReady(iUnit);
+    return;
+  }
+
+  nIndPendUnit_[iUnit].storeRelease(nInds);
+
+  QList<Individual*> sortedInds = individuals;
+  qStableSort(sortedInds.begin(), sortedInds.end(), 
+              indExpectedSimTimeGreaterThan);
+
+  QList<EvaluationPool::Job> jobs;
+  jobs.reserve(nInds);
+  for (int i = 0; i < nInds; ++i) {
+    Individual *ind = sortedInds.at(i);
+    EvaluationPool::Job job = {ind, NULL, -1, iUnit, ind->expectedSimTime()};
+    jobs.append(job);
+  }
+
+  pool_->pushJobs(this, jobs);
+}
+
+// Each pair of children is created and calculated by the same pool thread
+void ErrorCalculatorPool::processChildPairs(int iUnit, 
+                                            ChildPairCreator *creator,
+                                            int nPairs) {
+  if (nPairs == 0) {
+    unitReady(iUnit);
+    return;
+  }
+
+  nIndPendUnit_[iUnit].storeRelease(nPairs);
+
+  QList<EvaluationPool::Job> jobs;
+  jobs.reserve(nPairs);
+  for (int i = 0; i < nPairs; ++i) {
+    EvaluationPool::Job job = {NULL, creator, i, iUnit, 
+                               creator->expectedChildPairSimTime(i)};
+    jobs.append(job);
+  }
+  qStableSort(jobs.begin(), jobs.end(), EvaluationPool::jobLongerThan);
+
+  pool_->pushJobs(this, jobs);
+}
+
+// Must be called before processing any individual
+void ErrorCalculatorPool::setBudget(qint64 maxRateEvals, qint64 maxMsecs) {
+  for (int i = 0; i < evaluators_.size(); ++i)
+    evaluators_.at(i)->setBudget(maxRateEvals, maxMsecs);
+}
+
+int ErrorCalculatorPool::waitForAnyDeme() {
+  readyUnits_.acquire();
+
+  readyMutex_.lock();
+  int iUnitReady = readyUnitQueue_.dequeue();
+  readyMutex_.unlock();
+
+  return iUnitReady;
+}
+
+// Called from the pool thread iThread
+void ErrorCalculatorPool::calculate(const EvaluationPool::Job &job, 
+                                    int iThread) {
+  if (job.individual) {
+    calcIndividual(job.individual, iThread);
+  } else {
+    Individual *child1, *child2;
+    job.creator->createChildPair(job.iPair, &child1, &child2);
+    calcIndividual(child1, iThread);
+    calcIndividual(child2, iThread);
+  }
+
+  // The ordered decrement makes the errors set by other threads visible to
+  // the thread that finishes the unit
+  if (nIndPendUnit_[job.iUnit].fetchAndAddOrdered(-1) == 1)
+    unitReady(job.iUnit);
+}
+
+void ErrorCalculatorPool::calcIndividual(Individual *individual, 
+                                         int iThread) {
+  QElapsedTimer timer;
+  timer.start();
+  EvaluatorProducts *evaluator = evaluators_.at(iThread);
+  QList<double> contributions;
+  double error = evaluator->evaluate(*individual->model(), 
+                                     individual->parentError(), &contributions);
+  double simTime = timer.elapsed() / 1000.0;
+
+  // Any simulator failure gets the worst error, but only a budget overrun
+  // is a timeout
+  if (error == ModelSimulator::BudgetExceededError)
+    individual->setTimedOut(true);
+  if (error < 0.0)
+    error = Individual::TimeoutError;
+  individual->setError(error);
+  individual->setSimTime(simTime);
+  individual->setExperimentErrors(evaluator->search(), 
+    evaluator->experimentChecksums(), contributions);
+  nEvaluated_.fetchAndAddRelaxed(1);
+}
+
+void ErrorCalculatorPool::unitReady(int iUnit) {
+  readyMutex_.lock();
+  readyUnitQueue_.enqueue(iUnit);
+  readyMutex_.unlock();
+
+  readyUnits_.release();
+}
+
+}
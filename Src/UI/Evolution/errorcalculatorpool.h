@@ -0,0 +1,53 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "evaluationpool.h"
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QQueue>
+
+namespace LoboLab {
+
+class EvaluatorProducts;
+class Model;
+
+// Error calculator of one search that evaluates its individuals in a pool of 
+// threads shared with other searches. There is one evaluator per pool 
+// thread, since each thread evaluates one individual at a time.
+class ErrorCalculatorPool : public ErrorCalculator {
+  friend class EvaluationPool;
+
+ public:
+  ErrorCalculatorPool(int nUnits, EvaluationPool *pool, const Search &search);
+  virtual ~ErrorCalculatorPool(void);
+
+  void process(int iUnit, const QList<Individual*> &individuals);
+  void processChildPairs(int iUnit, ChildPairCreator *creator, int nPairs);
+  int waitForAnyDeme();
+
+  void setBudget(qint64 maxRateEvals, qint64 maxMsecs);
+
+  // Progress, readable from any thread
+  inline int nEvaluated() const { return nEvaluated_.loadAcquire(); }
+
+ private:
+  void calculate(const EvaluationPool::Job &job, int iThread);
+  void calcIndividual(Individual *individual, int iThread);
+  void unitReady(int iUnit);
+
+  EvaluationPool *pool_;
+  int nUnits_;
+  QAtomicInt *nIndPendUnit_;
+  QAtomicInt nEvaluated_;
+  QList<EvaluatorProducts*> evaluators_; // One per pool thread
+
+  QQueue<int> readyUnitQueue_;
+  QMutex readyMutex_;
+  QSemaphore readyUnits_;
+};
+
+} // namespace LoboLab
@@ -0,0 +1,441 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "errorcalculatorsocket.h"
+#include "evaluationprotocol.h"
+#include "Search/individual.h"
+#include "Search/search.h"
+#include "Search/evaluatorproducts.h"
+#include "Simulator/modelsimulator.h"
+#include "Model/model.h"
+#include "Experiment/experiment.h"
+#include "Common/log.h"
+
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QProcess>
+#include <QCoreApplication>
+#include <QStringList>
+#include <algorithm>
+
+namespace LoboLab {
+
+using namespace EvaluationProtocol;
+
+ErrorCalculatorSocket::ErrorCalculatorSocket(int nDemes, quint16 port,
+                                             const Search &search,
+                                             int batchSize)
+  : ErrorCalculator(),
+    nDemes_(nDemes),
+    search_(search),
+    port_(port),
+    batchSize_(qMax(1, batchSize)),
+    maxRateEvals_(0),
+    maxMsecs_(0),
+    nextJobId_(1),
+    listening_(false),
+    endThreads_(false),
+    nWorkers_(0),
+    nIndPendDeme_(nDemes_, 0) {
+  localEvaluator_ = new EvaluatorProducts(search_);
+  noWorkersTimer_.start();
+
+  int nExperiments = search_.nExperiments();
+  for (int i = 0; i < nExperiments; ++i)
+    experimentChecksums_.append(search_.experiment(i)->checksum());
+
+  listenerThread_ = new ListenerThread(port_, this);
+  listenerThread_->start();
+  listenerStarted_.acquire(); // Wait until listening, before any worker starts
+
+  if (listening_)
+    Log::write() << "ErrorCalculatorSocket: listening on port " << port_ << 
+      endl;
+  else
+    Log::write() << "ErrorCalculatorSocket: ERROR: unable to listen on port " 
+      << port_ << endl;
+}
+
+ErrorCalculatorSocket::~ErrorCalculatorSocket(void) {
+  stopThreads();
+
+  for (int i = 0; i < localWorkers_.size(); ++i) {
+    QProcess *worker = localWorkers_.at(i);
+    if (!worker->waitForFinished(WorkerTimeoutMsecs))
+      worker->kill();
+    delete worker;
+  }
+
+  delete localEvaluator_;
+}
+
+// The same search must be loadable by the workers from the database file
+void ErrorCalculatorSocket::startLocalWorkers(int nWorkers, 
+                                              const QString &dbFileName) {
+  QStringList args;
+  args << dbFileName << QString::number(search_.id()) << "1" << "-worker" << 
+    "127.0.0.1" << QString::number(port_);
+
+  for (int i = 0; i < nWorkers; ++i) {
+    QProcess *worker = new QProcess();
+    worker->setProcessChannelMode(QProcess::ForwardedChannels);
+    worker->start(QCoreApplication::applicationFilePath(), args);
+    localWorkers_.append(worker);
+  }
+
+  Log::write() << "ErrorCalculatorSocket: started " << nWorkers << 
+    " local workers." << endl;
+}
+
+// Must be called before processing any individual
+void ErrorCalculatorSocket::setBudget(qint64 maxRateEvals, qint64 maxMsecs) {
+  maxRateEvals_ = maxRateEvals;
+  maxMsecs_ = maxMsecs;
+  localEvaluator_->setBudget(maxRateEvals, maxMsecs);
+}
+
+// The models are serialized here, so the connection threads do not access
+// the individuals until their results arrive
+void ErrorCalculatorSocket::process(int iDeme,
+                                    const QList<Individual*> &individuals) {
+  mutex_.lock();
+
+  int nInds = individuals.size();
+  nIndPendDeme_[iDeme] = nInds;
+  if (nInds == 0) {
+    readyDemeQueue_.enqueue(iDeme);
+    parentCondition_.wakeOne();
+  }
+
+  for (int i = 0; i < nInds; ++i) {
+    Individual *individual = individuals.at(i);
+    Job job = {nextJobId_++, individual, iDeme, individual->model()->toBinary(),
+               individual->parentError()};
+    insertJob(job);
+  }
+
+  jobsCondition_.wakeAll();
+
+  mutex_.unlock();
+}
+
+// While no worker is connected, the jobs are calculated here, the longest
+// first, so the search does not wait forever for workers that never connect
+int ErrorCalculatorSocket::waitForAnyDeme() {
+  mutex_.lock();
+
+  bool calcLocally = false;
+  while (readyDemeQueue_.isEmpty()) {
+    if (nWorkers_ == 0 && !pendJobs_.isEmpty() && 
+        noWorkersTimer_.hasExpired(WorkerTimeoutMsecs)) {
+      if (!calcLocally) {
+        Log::write() << "ErrorCalculatorSocket: WARNING: no worker connected. "
+          "Calculating " << pendJobs_.size() << " jobs locally." << endl;
+        calcLocally = true;
+      }
+
+      Job job = pendJobs_.takeFirst();
+      mutex_.unlock();
+      calcJobLocally(job);
+      mutex_.lock();
+    } else {
+      parentCondition_.wait(&mutex_, HeartbeatMsecs);
+    }
+  }
+
+  int iDemeReady = readyDemeQueue_.dequeue();
+
+  mutex_.unlock();
+
+  return iDemeReady;
+}
+
+bool ErrorCalculatorSocket::jobLongerThan(const Job &job1, const Job &job2) {
+  return indExpectedSimTimeGreaterThan(job1.individual, job2.individual);
+}
+
+// The mutex must be locked
+void ErrorCalculatorSocket::insertJob(const Job &job) {
+  QList<Job>::iterator pos = std::upper_bound(pendJobs_.begin(), 
+    pendJobs_.end(), job, jobLongerThan);
+  pendJobs_.insert(pos, job);
+}
+
+void ErrorCalculatorSocket::addConnection(qintptr socketDescriptor) {
+  mutex_.lock();
+  if (!endThreads_) {
+    ConnectionThread *thread = new ConnectionThread(socketDescriptor, this);
+    connectionThreads_.append(thread);
+    thread->start();
+  }
+  mutex_.unlock();
+}
+
+void ErrorCalculatorSocket::workerConnected() {
+  mutex_.lock();
+  ++nWorkers_;
+  mutex_.unlock();
+}
+
+void ErrorCalculatorSocket::workerLost() {
+  mutex_.lock();
+  if (--nWorkers_ == 0)
+    noWorkersTimer_.start();
+  mutex_.unlock();
+}
+
+void ErrorCalculatorSocket::calcJobLocally(const Job &job) {
+  QElapsedTimer timer;
+  timer.start();
+
+  Result result;
+  result.jobId = job.id;
+  result.error = localEvaluator_->evaluate(*job.individual->model(), 
+                                           job.maxError, &result.contributions);
+  result.simTime = timer.elapsed() / 1000.0;
+
+  jobsFinished(QList<Job>() << job, QList<Result>() << result);
+}
+
+// Waits for jobs for a short time, so that the threads can end
+QList<ErrorCalculatorSocket::Job> ErrorCalculatorSocket::takeJobs() {
+  QList<Job> jobs;
+
+  mutex_.lock();
+  if (pendJobs_.isEmpty() && !endThreads_)
+    jobsCondition_.wait(&mutex_, HeartbeatMsecs);
+
+  while (jobs.size() < batchSize_ && !pendJobs_.isEmpty())
+    jobs.append(pendJobs_.takeFirst());
+  mutex_.unlock();
+
+  return jobs;
+}
+
+void ErrorCalculatorSocket::requeueJobs(const QList<Job> &jobs) {
+  mutex_.lock();
+  int n = jobs.size();
+  for (int i = 0; i < n; ++i)
+    insertJob(jobs.at(i));
+
+  jobsCondition_.wakeAll();
+  mutex_.unlock();
+}
+
+void ErrorCalculatorSocket::jobsFinished(const QList<Job> &jobs, 
+                                         const QList<Result> &results) {
+  mutex_.lock();
+
+  int n = jobs.size();
+  for (int i = 0; i < n; ++i) {
+    Individual *individual = jobs.at(i).individual;
+    double error = results.at(i).error;
+    // Any simulator failure gets the worst error, but only a budget overrun
+    // is a timeout
+    if (error == ModelSimulator::BudgetExceededError)
+      individual->setTimedOut(true);
+    if (error < 0.0)
+      error = Individual::TimeoutError;
+    individual->setError(error);
+    individual->setSimTime(results.at(i).simTime);
+    individual->setExperimentErrors(search_, experimentChecksums_, 
+                                    results.at(i).contributions);
+
+    int iDeme = jobs.at(i).iDeme;
+    if (--nIndPendDeme_[iDeme] == 0) { // last individual processed in deme
+      readyDemeQueue_.enqueue(iDeme);
+      parentCondition_.wakeOne();
+    }
+  }
+
+  mutex_.unlock();
+}
+
+void ErrorCalculatorSocket::stopThreads() {
+  mutex_.lock();
+  endThreads_ = true;
+  jobsCondition_.wakeAll();
+  mutex_.unlock();
+
+  listenerThread_->wait();
+  delete listenerThread_;
+
+  // No connection is added after the listener has finished
+  for (int i = 0; i < connectionThreads_.size(); ++i) {
+    connectionThreads_.at(i)->wait();
+    delete connectionThreads_.at(i);
+  }
+}
+
+// class Listener
+
+ErrorCalculatorSocket::Listener::Listener(ErrorCalculatorSocket *p)
+  : parent_(p) {
+}
+
+void ErrorCalculatorSocket::Listener::incomingConnection(
+    qintptr socketDescriptor) {
+  parent_->addConnection(socketDescriptor);
+}
+
+// class ListenerThread
+
+ErrorCalculatorSocket::ListenerThread::ListenerThread(quint16 port, 
+  ErrorCalculatorSocket *p)
+  : port_(port),
+    parent_(p) {
+}
+
+void ErrorCalculatorSocket::ListenerThread::run() {
+  Listener listener(parent_);
+  parent_->listening_ = listener.listen(QHostAddress::Any, port_);
+  parent_->listenerStarted_.release();
+
+  if (parent_->listening_) {
+    forever {
+      parent_->mutex_.lock();
+      bool end = parent_->endThreads_;
+      parent_->mutex_.unlock();
+      if (end)
+        break;
+
+      listener.waitForNewConnection(HeartbeatMsecs);
+    }
+  }
+}
+
+// class ConnectionThread
+
+ErrorCalculatorSocket::ConnectionThread::ConnectionThread(
+    qintptr socketDescriptor, ErrorCalculatorSocket *p)
+  : socketDescriptor_(socketDescriptor),
+    parent_(p) {
+}
+
+void ErrorCalculatorSocket::ConnectionThread::run() {
+  QTcpSocket socket;
+  if (!socket.setSocketDescriptor(socketDescriptor_))
+    return;
+
+  QString peer = socket.peerAddress().toString();
+  QByteArray buffer;
+  if (!receiveHello(&socket, &buffer)) {
+    Log::write() << "ErrorCalculatorSocket: WARNING: rejected connection from "
+      << peer << endl;
+    return;
+  }
+
+  Log::write() << "ErrorCalculatorSocket: worker connected from " << peer << 
+    endl;
+  parent_->workerConnected();
+
+  bool ok = true;
+  forever {
+    parent_->mutex_.lock();
+    bool end = parent_->endThreads_;
+    parent_->mutex_.unlock();
+    if (end)
+      break;
+
+    if (jobsInFlight_.isEmpty()) {
+      ok = sendJobs(&socket);
+      if (!ok)
+        break;
+    } else {
+      ok = receiveMessages(&socket, &buffer);
+      if (!ok)
+        break;
+    }
+  }
+
+  if (ok) {
+    writeMessage(&socket, createEmptyMessage(MsgQuit));
+    socket.disconnectFromHost();
+  } else {
+    Log::write() << "ErrorCalculatorSocket: WARNING: worker " << peer << 
+      " lost. Dispatching again " << jobsInFlight_.size() << " jobs." << endl;
+    parent_->requeueJobs(jobsInFlight_.values());
+    jobsInFlight_.clear();
+  }
+
+  parent_->workerLost();
+}
+
+// The worker must be evaluating the same search
+bool ErrorCalculatorSocket::ConnectionThread::receiveHello(QTcpSocket *socket,
+                                                           QByteArray *buffer) {
+  QByteArray message;
+  while (!takeMessage(buffer, &message)) {
+    if (!socket->waitForReadyRead(WorkerTimeoutMsecs))
+      return false;
+    buffer->append(socket->readAll());
+  }
+
+  QDataStream stream(message);
+  stream.setVersion(StreamVersion);
+  qint32 type, searchId;
+  stream >> type >> searchId;
+
+  return type == MsgHello && searchId == parent_->search_.id();
+}
+
+// Returns false if the worker is lost
+bool ErrorCalculatorSocket::ConnectionThread::sendJobs(QTcpSocket *socket) {
+  QList<Job> jobs = parent_->takeJobs();
+  if (jobs.isEmpty())
+    return socket->state() == QAbstractSocket::ConnectedState;
+
+  QByteArray message;
+  QDataStream stream(&message, QIODevice::WriteOnly);
+  stream.setVersion(StreamVersion);
+  stream << (qint32) MsgJobs << parent_->maxRateEvals_ << parent_->maxMsecs_ 
+    << (qint32) jobs.size();
+
+  int n = jobs.size();
+  for (int i = 0; i < n; ++i) {
+    const Job &job = jobs.at(i);
+    stream << job.id << job.model << job.maxError;
+    jobsInFlight_.insert(job.id, job);
+  }
+
+  return writeMessage(socket, message);
+}
+
+// Returns false if the worker is lost
+bool ErrorCalculatorSocket::ConnectionThread::receiveMessages(
+    QTcpSocket *socket, QByteArray *buffer) {
+  // Busy workers send heartbeats
+  if (!socket->waitForReadyRead(WorkerTimeoutMsecs))
+    return false;
+
+  buffer->append(socket->readAll());
+
+  QByteArray message;
+  while (takeMessage(buffer, &message)) {
+    QDataStream stream(message);
+    stream.setVersion(StreamVersion);
+    qint32 type;
+    stream >> type;
+
+    if (type == MsgResults) {
+      QList<Job> jobs;
+      QList<Result> results;
+      qint32 n;
+      stream >> n;
+      for (int i = 0; i < n; ++i) {
+        Result result;
+        stream >> result.jobId >> result.error >> result.simTime >> 
+          result.contributions;
+        if (jobsInFlight_.contains(result.jobId)) {
+          jobs.append(jobsInFlight_.take(result.jobId));
+          results.append(result);
+        }
+      }
+      parent_->jobsFinished(jobs, results);
+    } // Heartbeat messages only keep the connection alive
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,140 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "Search/errorcalculator.h"
+#include <QList>
+#include <QHash>
+#include <QQueue>
+#include <QVector>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <QTcpServer>
+
+class QProcess;
+
+namespace LoboLab {
+
+class EvaluatorProducts;
+
+// Calculates the errors in worker processes, possibly on other nodes, 
+// connected through TCP. The models are sent in binary form in batches. Each
+// connection is served by its own thread, and the jobs of a worker that 
+// disconnects or stops sending heartbeats are dispatched again. While no 
+// worker has been connected for WorkerTimeoutMsecs, the jobs are calculated
+// by the thread that waits for the demes.
+class ErrorCalculatorSocket : public ErrorCalculator {
+
+ public:
+  ErrorCalculatorSocket(int nDemes, quint16 port, const Search &search, 
+                        int batchSize = 1);
+  virtual ~ErrorCalculatorSocket(void);
+
+  inline bool isListening() const { return listening_; }
+
+  void process(int iDeme, const QList<Individual*> &individuals);
+  int waitForAnyDeme();
+
+  void setBudget(qint64 maxRateEvals, qint64 maxMsecs);
+  void startLocalWorkers(int nWorkers, const QString &dbFileName);
+
+ private:
+  struct Job {
+    qint64 id;
+    Individual *individual;
+    int iDeme;
+    QByteArray model;
+    double maxError;
+  };
+
+  struct Result {
+    qint64 jobId;
+    double error;
+    double simTime;
+    QList<double> contributions;
+  };
+
+  class Listener : public QTcpServer {
+   public:
+    explicit Listener(ErrorCalculatorSocket *parent);
+
+   protected:
+    void incomingConnection(qintptr socketDescriptor);
+
+   private:
+    ErrorCalculatorSocket *parent_;
+  };
+
+  class ListenerThread : public QThread {
+   public:
+    ListenerThread(quint16 port, ErrorCalculatorSocket *parent);
+
+   protected:
+    void run();
+
+   private:
+    quint16 port_;
+    ErrorCalculatorSocket *parent_;
+  };
+
+  class ConnectionThread : public QThread {
+   public:
+    ConnectionThread(qintptr socketDescriptor, ErrorCalculatorSocket *parent);
+
+   protected:
+    void run();
+
+   private:
+    bool receiveHello(QTcpSocket *socket, QByteArray *buffer);
+    bool sendJobs(QTcpSocket *socket);
+    bool receiveMessages(QTcpSocket *socket, QByteArray *buffer);
+
+    qintptr socketDescriptor_;
+    ErrorCalculatorSocket *parent_;
+    QHash<qint64, Job> jobsInFlight_;
+  };
+
+  static bool jobLongerThan(const Job &job1, const Job &job2);
+  void insertJob(const Job &job);
+  void addConnection(qintptr socketDescriptor);
+  void workerConnected();
+  void workerLost();
+  void calcJobLocally(const Job &job);
+  QList<Job> takeJobs();
+  void requeueJobs(const QList<Job> &jobs);
+  void jobsFinished(const QList<Job> &jobs, const QList<Result> &results);
+  void stopThreads();
+
+  int nDemes_;
+  const Search &search_;
+  QList<QByteArray> experimentChecksums_;
+  quint16 port_;
+  int batchSize_;
+  qint64 maxRateEvals_;
+  qint64 maxMsecs_;
+  qint64 nextJobId_;
+  bool listening_;
+  bool endThreads_;
+  int nWorkers_;
+  QElapsedTimer noWorkersTimer_; // Since the last worker was lost
+  EvaluatorProducts *localEvaluator_;
+
+  QList<Job> pendJobs_; // Sorted by expected simulation time
+  QVector<int> nIndPendDeme_;
+  QQueue<int> readyDemeQueue_;
+
+  QMutex mutex_;
+  QWaitCondition jobsCondition_;
+  QWaitCondition parentCondition_;
+  QSemaphore listenerStarted_;
+
+  ListenerThread *listenerThread_;
+  QList<ConnectionThread*> connectionThreads_;
+  QList<QProcess*> localWorkers_;
+};
+
+} // namespace LoboLab
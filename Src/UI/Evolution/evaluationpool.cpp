@@ -0,0 +1,132 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "evaluationpool.h"
+#include "errorcalculatorpool.h"
+#include "Search/individual.h"
+#include <algorithm>
+
+namespace LoboLab {
+
+EvaluationPool::EvaluationPool(int nThreads)
+    : nextCalculator_(0),
+      endThreads_(0) {
+  for (int i = 0; i < nThreads; ++i) {
+    PoolThread *thread = new PoolThread(this, i);
+    poolThreads_.append(thread);
+    thread->start();
+  }
+}
+
+EvaluationPool::~EvaluationPool() {
+  stopThreads();
+
+  for (int i = 0; i < poolThreads_.size(); ++i)
+    delete poolThreads_.at(i);
+}
+
+// Unknown times first, as indExpectedSimTimeGreaterThan
+bool EvaluationPool::jobLongerThan(const Job &job1, const Job &job2) {
+  if (job1.individual && job2.individual)
+    return indExpectedSimTimeGreaterThan(job1.individual, job2.individual);
+
+  double t1 = job1.expectedSimTime;
+  double t2 = job2.expectedSimTime;
+  if (t1 < 0 || t2 < 0)
+    return t1 < 0 && t2 >= 0;
+  else
+    return t1 > t2;
+}
+
+void EvaluationPool::addCalculator(ErrorCalculatorPool *calculator) {
+  jobsMutex_.lock();
+  calculators_.append(calculator);
+  jobs_.append(QList<Job>());
+  jobsMutex_.unlock();
+}
+
+// The calculator must not have individuals pending
+void EvaluationPool::removeCalculator(ErrorCalculatorPool *calculator) {
+  jobsMutex_.lock();
+  int i = calculators_.indexOf(calculator);
+  Q_ASSERT(jobs_.at(i).isEmpty());
+  calculators_.removeAt(i);
+  jobs_.removeAt(i);
+  if (nextCalculator_ > i)
+    --nextCalculator_;
+  jobsMutex_.unlock();
+}
+
+// The new jobs must be sorted by expected simulation time, the longest first
+void EvaluationPool::pushJobs(ErrorCalculatorPool *calculator,
+                              const QList<Job> &sortedJobs) {
+  jobsMutex_.lock();
+  QList<Job> &jobs = jobs_[calculators_.indexOf(calculator)];
+  QList<Job>::iterator pos = jobs.begin();
+  int n = sortedJobs.size();
+  for (int i = 0; i < n; ++i) {
+    pos = std::upper_bound(pos, jobs.end(), sortedJobs.at(i), jobLongerThan);
+    pos = jobs.insert(pos, sortedJobs.at(i)) + 1;
+  }
+  jobsMutex_.unlock();
+
+  pendJobs_.release(n);
+}
+
+// Takes the longest job of the next calculator in turn with jobs pending
+bool EvaluationPool::takeJob(Job *job, ErrorCalculatorPool **calculator) {
+  jobsMutex_.lock();
+  int nCalculators = calculators_.size();
+  bool found = false;
+  for (int i = 0; i < nCalculators && !found; ++i) {
+    int iCalculator = (nextCalculator_ + i) % nCalculators;
+    QList<Job> &jobs = jobs_[iCalculator];
+    if (!jobs.isEmpty()) {
+      *job = jobs.takeFirst();
+      *calculator = calculators_.at(iCalculator);
+      nextCalculator_ = (iCalculator + 1) % nCalculators;
+      found = true;
+    }
+  }
+  jobsMutex_.unlock();
+
+  return found;
+}
+
+void EvaluationPool::stopThreads() {
+  endThreads_.storeRelease(1);
+
+  int nThreads = poolThreads_.size();
+  pendJobs_.release(nThreads); // Wake up every thread
+  for (int i = 0; i < nThreads; ++i)
+    poolThreads_.at(i)->wait();
+}
+
+// class PoolThread
+
+EvaluationPool::PoolThread::PoolThread(EvaluationPool *pool, int iThread)
+  : pool_(pool),
+    iThread_(iThread) {
+}
+
+EvaluationPool::PoolThread::~PoolThread() {
+  wait();
+}
+
+void EvaluationPool::PoolThread::run() {
+  setPriority(LowestPriority);
+
+  forever {
+    // Each acquired resource guarantees one job in some queue
+    pool_->pendJobs_.acquire();
+    if (pool_->endThreads_.loadAcquire())
+      break;
+
+    Job job;
+    ErrorCalculatorPool *calculator;
+    if (pool_->takeJob(&job, &calculator))
+      calculator->calculate(job, iThread_);
+  }
+}
+
+}
@@ -0,0 +1,73 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include "Search/errorcalculator.h"
+#include <QList>
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+#include <QAtomicInt>
+
+namespace LoboLab {
+
+class Individual;
+class ErrorCalculatorPool;
+
+// Calculator threads shared by the error calculators of several searches 
+// running concurrently. Each calculator has its own queue of individuals, 
+// sorted by expected simulation time, and the threads take the jobs from the
+// queues in turn, so every search gets the same share of the threads while 
+// it has individuals pending. A job can also be a pair of children, which the
+// thread creates before calculating them.
+class EvaluationPool {
+  friend class ErrorCalculatorPool;
+
+ public:
+  explicit EvaluationPool(int nThreads);
+  ~EvaluationPool();
+
+  inline int nThreads() const { return poolThreads_.size(); }
+
+ private:
+  struct Job {
+    Individual *individual; // NULL for a pair of children to create
+    ChildPairCreator *creator;
+    int iPair;
+    int iUnit;
+    double expectedSimTime;
+  };
+
+  class PoolThread : public QThread {
+   public:
+    PoolThread(EvaluationPool *pool, int iThread);
+    ~PoolThread();
+
+   protected:
+    void run();
+
+   private:
+    EvaluationPool *pool_;
+    int iThread_;
+  };
+
+  static bool jobLongerThan(const Job &job1, const Job &job2);
+  void addCalculator(ErrorCalculatorPool *calculator);
+  void removeCalculator(ErrorCalculatorPool *calculator);
+  void pushJobs(ErrorCalculatorPool *calculator, 
+                const QList<Job> &sortedJobs);
+  bool takeJob(Job *job, ErrorCalculatorPool **calculator);
+  void stopThreads();
+
+  QList<ErrorCalculatorPool*> calculators_;
+  QList<QList<Job> > jobs_; // One queue per calculator, the longest first
+  int nextCalculator_; // Next queue in turn
+  QMutex jobsMutex_;
+  QSemaphore pendJobs_; // One resource per queued individual
+  QAtomicInt endThreads_;
+
+  QList<PoolThread*> poolThreads_;
+};
+
+} // namespace LoboLab
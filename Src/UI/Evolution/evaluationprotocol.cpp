@@ -0,0 +1,50 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "evaluationprotocol.h"
+
+#include <QTcpSocket>
+#include <QtEndian>
+
+namespace LoboLab {
+
+namespace EvaluationProtocol {
+
+bool writeMessage(QTcpSocket *socket, const QByteArray &message) {
+  uchar size[4];
+  qToBigEndian<quint32>(message.size(), size);
+
+  bool ok = socket->write((const char*)size, 4) == 4;
+  ok &= socket->write(message) == message.size();
+  ok &= socket->waitForBytesWritten(WorkerTimeoutMsecs);
+
+  return ok;
+}
+
+// Extracts the first complete message from the received data, if any
+bool takeMessage(QByteArray *buffer, QByteArray *message) {
+  if (buffer->size() < 4)
+    return false;
+
+  quint32 size = qFromBigEndian<quint32>((const uchar*)buffer->constData());
+  if ((quint32)buffer->size() < 4 + size)
+    return false;
+
+  *message = buffer->mid(4, size);
+  buffer->remove(0, 4 + size);
+
+  return true;
+}
+
+QByteArray createEmptyMessage(MessageType type) {
+  QByteArray message;
+  QDataStream stream(&message, QIODevice::WriteOnly);
+  stream.setVersion(StreamVersion);
+  stream << (qint32) type;
+
+  return message;
+}
+
+} // namespace EvaluationProtocol
+
+} // namespace LoboLab
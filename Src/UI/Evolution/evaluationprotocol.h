@@ -0,0 +1,45 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QByteArray>
+#include <QDataStream>
+
+class QTcpSocket;
+
+namespace LoboLab {
+
+// Messages exchanged between ErrorCalculatorSocket and the evaluation 
+// workers. Each message is a QDataStream payload, starting with its type,
+// preceded by its size as a quint32.
+//
+// Hello (worker):   qint32 searchId
+// Jobs (server):    qint64 maxRateEvals, qint64 maxMsecs, qint32 n, 
+//                   n x (qint64 jobId, QByteArray model, double maxError),
+//                   with the models in the binary form of Model::toBinary()
+// Results (worker): qint32 n, n x (qint64 jobId, double error, double simTime,
+//                   QList<double> contributions of the experiments)
+// Heartbeat (worker, while evaluating)
+// Quit (server)
+namespace EvaluationProtocol {
+
+enum MessageType {
+  MsgHello = 1,
+  MsgJobs,
+  MsgResults,
+  MsgHeartbeat,
+  MsgQuit
+};
+
+const int HeartbeatMsecs = 1000;
+const int WorkerTimeoutMsecs = 30000; // Without any message from a busy worker
+const QDataStream::Version StreamVersion = QDataStream::Qt_5_0;
+
+bool writeMessage(QTcpSocket *socket, const QByteArray &message);
+bool takeMessage(QByteArray *buffer, QByteArray *message);
+QByteArray createEmptyMessage(MessageType type);
+
+} // namespace EvaluationProtocol
+
+} // namespace LoboLab
@@ -0,0 +1,135 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "evaluationworker.h"
+#include "evaluationprotocol.h"
+#include "Search/evaluatorproducts.h"
+#include "Search/search.h"
+#include "Search/individual.h"
+#include "Model/model.h"
+#include "Common/log.h"
+
+#include <QTcpSocket>
+#include <QElapsedTimer>
+
+namespace LoboLab {
+
+using namespace EvaluationProtocol;
+
+EvaluationWorker::EvaluationWorker(const Search &search)
+  : search_(search) {
+  evaluator_ = new EvaluatorProducts(search_);
+}
+
+EvaluationWorker::~EvaluationWorker(void) {
+  delete evaluator_;
+}
+
+// Returns false if the connection with the server was lost
+bool EvaluationWorker::run(const QString &host, quint16 port) {
+  QTcpSocket socket;
+  socket.connectToHost(host, port);
+  if (!socket.waitForConnected(WorkerTimeoutMsecs)) {
+    Log::write() << "EvaluationWorker::run: ERROR: unable to connect to " << 
+      host << ":" << port << endl;
+    return false;
+  }
+
+  QByteArray hello;
+  QDataStream helloStream(&hello, QIODevice::WriteOnly);
+  helloStream.setVersion(StreamVersion);
+  helloStream << (qint32) MsgHello << (qint32) search_.id();
+  if (!writeMessage(&socket, hello))
+    return false;
+
+  QByteArray buffer;
+  forever {
+    if (!socket.waitForReadyRead(-1))
+      return false;
+
+    buffer.append(socket.readAll());
+
+    QByteArray message;
+    while (takeMessage(&buffer, &message)) {
+      QDataStream stream(message);
+      stream.setVersion(StreamVersion);
+      qint32 type;
+      stream >> type;
+
+      if (type == MsgJobs) {
+        if (!processJobs(&socket, stream))
+          return false;
+      } else if (type == MsgQuit) {
+        socket.disconnectFromHost();
+        return true;
+      }
+    }
+  }
+}
+
+// The batch is calculated in another thread, so that this one can send the
+// heartbeats
+bool EvaluationWorker::processJobs(QTcpSocket *socket, QDataStream &stream) {
+  qint64 maxRateEvals, maxMsecs;
+  qint32 n;
+  stream >> maxRateEvals >> maxMsecs >> n;
+  evaluator_->setBudget(maxRateEvals, maxMsecs);
+
+  QList<Job> jobs;
+  for (int i = 0; i < n; ++i) {
+    Job job;
+    stream >> job.id >> job.model >> job.maxError;
+    jobs.append(job);
+  }
+
+  BatchThread thread(evaluator_, &jobs);
+  thread.start();
+  while (!thread.wait(HeartbeatMsecs))
+    if (!writeMessage(socket, createEmptyMessage(MsgHeartbeat))) {
+      thread.wait();
+      return false;
+    }
+
+  QByteArray message;
+  QDataStream resultStream(&message, QIODevice::WriteOnly);
+  resultStream.setVersion(StreamVersion);
+  resultStream << (qint32) MsgResults << (qint32) n;
+  for (int i = 0; i < n; ++i) {
+    const Job &job = jobs.at(i);
+    resultStream << job.id << job.error << job.simTime << job.contributions;
+  }
+
+  return writeMessage(socket, message);
+}
+
+// class BatchThread
+
+EvaluationWorker::BatchThread::BatchThread(EvaluatorProducts *evaluator,
+                                           QList<Job> *jobs)
+  : evaluator_(evaluator),
+    jobs_(jobs) {
+}
+
+void EvaluationWorker::BatchThread::run() {
+  setPriority(LowestPriority);
+
+  QElapsedTimer timer;
+  int n = jobs_->size();
+  for (int i = 0; i < n; ++i) {
+    Job &job = (*jobs_)[i];
+    Model model;
+    if (!model.loadFromBinary(job.model)) {
+      Log::write() << "EvaluationWorker: ERROR: malformed model in job " << 
+        job.id << endl;
+      job.error = Individual::TimeoutError;
+      job.simTime = 0;
+      continue;
+    }
+
+    timer.start();
+    job.error = evaluator_->evaluate(model, job.maxError, &job.contributions);
+    job.simTime = timer.elapsed() / 1000.0;
+  }
+}
+
+}
@@ -0,0 +1,57 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QThread>
+#include <QDataStream>
+
+class QTcpSocket;
+
+namespace LoboLab {
+
+class EvaluatorProducts;
+class Search;
+
+// Worker process of ErrorCalculatorSocket. Receives batches of models,
+// calculates their errors and sends the results back, sending heartbeats 
+// while it is busy.
+class EvaluationWorker {
+
+ public:
+  explicit EvaluationWorker(const Search &search);
+  ~EvaluationWorker(void);
+
+  bool run(const QString &host, quint16 port);
+
+ private:
+  struct Job {
+    qint64 id;
+    QByteArray model;
+    double maxError;
+    double error;
+    double simTime;
+    QList<double> contributions;
+  };
+
+  class BatchThread : public QThread {
+   public:
+    BatchThread(EvaluatorProducts *evaluator, QList<Job> *jobs);
+
+   protected:
+    void run();
+
+   private:
+    EvaluatorProducts *evaluator_;
+    QList<Job> *jobs_;
+  };
+
+  bool processJobs(QTcpSocket *socket, QDataStream &stream);
+
+  const Search &search_;
+  EvaluatorProducts *evaluator_;
+};
+
+} // namespace LoboLab
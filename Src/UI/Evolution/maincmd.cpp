@@ -4,12 +4,24 @@
 #include "maincmd.h"
 #include "version.h"
 #include "DB/db.h"
+#include "DB/dbsea.h"
+#include "DB/dbwriter.h"
 
 #include "Search/search.h"
+#include "Search/crossvalidation.h"
+#include "Search/individualerrortable.h"
 #include "Search/searchparams.h"
+#include "Search/migrationfilespool.h"
 #include "Simulator/simparams.h"
 #include "errorcalculatormultithread.h"
+#include "crossvalidatormultithread.h"
+#include "rescorermultithread.h"
+#include "errorcalculatorsocket.h"
+#include "evaluationworker.h"
+#include "evaluationpool.h"
+#include "searchrunner.h"
 #include "Common/log.h"
+#include "Common/mathalgo.h"
 
 #include <QTimer>
 #include <QCoreApplication>
@@ -36,22 +48,104 @@ MainCmd::~MainCmd(void) {
 void MainCmd::run() {
   QStringList args = QCoreApplication::arguments();
 
-  QString dbFileName;
   int searchId = 0;
+  QList<int> searchIds;
+  int nFolds = 0;
+  bool rescore = false;
+  QString workerHost;
+  quint16 workerPort = 0;
+  maxRateEvals_ = 0;
+  maxMsecs_ = 0;
+  serverPort_ = 0;
+  nLocalWorkers_ = 0;
+  batchSize_ = 1;
+  iIslandProcess_ = 0;
+  nIslandProcesses_ = 1;
+  asyncEvolution_ = false;
+  checkpointPeriod_ = 0;
+  resumeCheckpoint_ = false;
 
   if (args.size() > 1)
-    dbFileName = args.at(1);
-  if (args.size() > 2)
-    searchId = args.at(2).toInt();
+    dbFileName_ = args.at(1);
+  if (args.size() > 2) {
+    searchIds = parseSearchIds(args.at(2));
+    if (!searchIds.isEmpty())
+      searchId = searchIds.first();
+  }
   if (args.size() > 3)
     nThreads_ = args.at(3).toInt();
   else
     nThreads_ = 3;
 
+  // Options
+  for (int i = 4; i < args.size(); ++i) {
+    if (args.at(i) == "-cv" && i + 1 < args.size())
+      nFolds = args.at(++i).toInt();
+    else if (args.at(i) == "-rescore")
+      rescore = true;
+    else if (args.at(i) == "-async")
+      asyncEvolution_ = true;
+    else if (args.at(i) == "-checkpoint" && i + 2 < args.size()) {
+      checkpointFileName_ = args.at(++i);
+      checkpointPeriod_ = args.at(++i).toInt();
+    } else if (args.at(i) == "-resume")
+      resumeCheckpoint_ = true;
+    else if (args.at(i) == "-budget" && i + 1 < args.size())
+      maxMsecs_ = args.at(++i).toDouble() * 1000;
+    else if (args.at(i) == "-maxevals" && i + 1 < args.size())
+      maxRateEvals_ = args.at(++i).toLongLong();
+    else if (args.at(i) == "-server" && i + 1 < args.size())
+      serverPort_ = args.at(++i).toUShort();
+    else if (args.at(i) == "-localworkers" && i + 1 < args.size())
+      nLocalWorkers_ = args.at(++i).toInt();
+    else if (args.at(i) == "-batch" && i + 1 < args.size())
+      batchSize_ = args.at(++i).toInt();
+    else if (args.at(i) == "-worker" && i + 2 < args.size()) {
+      workerHost = args.at(++i);
+      workerPort = args.at(++i).toUShort();
+    } else if (args.at(i) == "-island" && i + 3 < args.size()) {
+      iIslandProcess_ = args.at(++i).toInt();
+      nIslandProcesses_ = args.at(++i).toInt();
+      spoolDir_ = args.at(++i);
+    } else if (args.at(i) == "-scratch" && i + 1 < args.size())
+      scratchDir_ = args.at(++i);
+  }
 
-  if (searchId && connectDB(db_, dbFileName)) {
-    search_ = new Search(searchId, &db_, false);
-    runSearch();
+  // The runners of a batch only take the budget, and the batch would 
+  // ignore the rest of the options
+  if (searchIds.size() > 1 && (asyncEvolution_ || 
+      !checkpointFileName_.isEmpty() || nIslandProcesses_ > 1 || 
+      serverPort_ || workerPort || nFolds > 1 || rescore)) {
+    std::cout << "MainCmd: several searches can only be run with -budget, " 
+              << "-maxevals and -scratch." << std::endl;
+    searchId = 0;
+  }
+
+  // The asynchronous evolution writes no checkpoints, so it could not be 
+  // resumed
+  if (asyncEvolution_ && !checkpointFileName_.isEmpty()) {
+    std::cout << "MainCmd: -async cannot be used with -checkpoint." 
+              << std::endl;
+    searchId = 0;
+  }
+
+  search_ = NULL;
+  if (searchId && connectDB(db_, dbFileName_)) {
+    if (searchIds.size() > 1) {
+      runBatch(searchIds);
+    } else if (workerPort) {
+      search_ = new Search(searchId, &db_, false);
+      runWorker(workerHost, workerPort);
+    } else if (nFolds > 1) {
+      search_ = new Search(searchId, &db_, true);
+      runCrossValidation(nFolds);
+    } else if (rescore) {
+      search_ = new Search(searchId, &db_, true);
+      runRescoring();
+    } else {
+      search_ = new Search(searchId, &db_, false);
+      runSearch();
+    }
     delete search_;
   } else {
     Log::write() << "Incorrect arguments." << endl;
@@ -60,7 +154,15 @@ void MainCmd::run() {
               std::endl;
     std::cout << "Usage: " <<
               QCoreApplication::applicationName().toStdString()
-              << "search_database_name search_id n_threads" << std::endl;
+              << " search_database_name search_id[,search_id|-last_id...] "
+              << "n_threads [-cv n_folds | -rescore] "
+              << "[-budget max_seconds] [-maxevals max_rate_evaluations] "
+              << "[-server port [-localworkers n] [-batch n]] "
+              << "[-worker server_host server_port] "
+              << "[-island i_process n_processes spool_dir] "
+              << "[-async | -checkpoint file period_seconds [-resume]] "
+              << "[-scratch local_dir]" 
+              << std::endl;
     quit();
   }
 }
@@ -69,14 +171,58 @@ void MainCmd::quit() {
   QCoreApplication::instance()->quit();
 }
 
+// The budget limits the simulation of each individual (0 means no limit).
+// With a server port, the errors are calculated by worker processes instead
+// of threads. With islands, this process evolves only its share of the 
+// demes and exchanges migrants with the other processes through the spool
+// directory. In asynchronous evolution, the error calculator processes pairs
+// of children instead of demes. The saves during the evolution are written by
+// a background thread. The checkpoints allow to resume the evolution by 
+// generations after a crash.
 void MainCmd::runSearch() {
   QElapsedTimer timer;
   timer.start();
   
-  int nDemes = search_->searchParams()->nDemes;
-  ErrorCalculatorMultiThread errorCalculator(nDemes, nThreads_, *search_);
+  DBWriter dbWriter(dbFileName_, isFastDB());
+  dbWriter.start();
+  search_->setDBWriter(&dbWriter);
+
+  MigrationFileSpool *migrationSpool = NULL;
+  if (nIslandProcesses_ > 1) {
+    migrationSpool = new MigrationFileSpool(spoolDir_, iIslandProcess_);
+    search_->setDistributed(iIslandProcess_, nIslandProcesses_, 
+                            migrationSpool);
+  }
+
+  search_->setAsyncEvolution(asyncEvolution_);
+  if (!checkpointFileName_.isEmpty())
+    search_->setCheckpoint(checkpointFileName_, checkpointPeriod_, 
+                           resumeCheckpoint_);
+  int nUnits = search_->nEvaluationUnits();
+  if (serverPort_) {
+    ErrorCalculatorSocket errorCalculator(nUnits, serverPort_, *search_, 
+                                          batchSize_);
+    if (!errorCalculator.isListening()) {
+      search_->setDBWriter(NULL);
+      delete migrationSpool;
+      quit();
+      return;
+    }
 
-  search_->runEvolution(&errorCalculator);
+    errorCalculator.setBudget(maxRateEvals_, maxMsecs_);
+    if (nLocalWorkers_ > 0)
+      errorCalculator.startLocalWorkers(nLocalWorkers_, dbFileName_);
+
+    search_->runEvolution(&errorCalculator);
+  } else {
+    ErrorCalculatorMultiThread errorCalculator(nUnits, nThreads_, *search_);
+    errorCalculator.setBudget(maxRateEvals_, maxMsecs_);
+
+    search_->runEvolution(&errorCalculator);
+  }
+
+  search_->setDBWriter(NULL);
+  delete migrationSpool;
 
   int s = timer.elapsed() / 1000;
   int d = s/(24*60*60);
@@ -91,20 +237,133 @@ void MainCmd::runSearch() {
   quit();
 }
 
+// The searches run concurrently, each one in its own thread, and their 
+// individuals are evaluated in one pool of threads shared fairly between 
+// them. The progress of each search is logged every minute.
+void MainCmd::runBatch(const QList<int> &searchIds) {
+  QElapsedTimer timer;
+  timer.start();
+
+  EvaluationPool pool(nThreads_);
+  QList<SearchRunner*> runners;
+  int n = searchIds.size();
+  for (int i = 0; i < n; ++i) {
+    SearchRunner *runner = new SearchRunner(searchIds.at(i), dbFileName_, 
+                                            isFastDB(), &pool);
+    runner->setBudget(maxRateEvals_, maxMsecs_);
+    runners.append(runner);
+    runner->start();
+  }
+
+  Log::write() << "MainCmd: Running " << n << " searches with " << 
+    nThreads_ << " threads." << endl;
+
+  for (int i = 0; i < n; ++i) {
+    while (!runners.at(i)->wait(60 * 1000)) {
+      for (int j = 0; j < n; ++j) {
+        SearchRunner *runner = runners.at(j);
+        Log::write() << "MainCmd: Search " << runner->searchId() << ": " << 
+          runner->nEvaluated() << " individuals evaluated" << 
+          (runner->isFinished() ? " (finished)." : ".") << endl;
+      }
+    }
+  }
+
+  for (int i = 0; i < n; ++i) {
+    SearchRunner *runner = runners.at(i);
+    std::cout << "MainCmd: Search " << runner->searchId() << ": " << 
+      runner->nEvaluated() << " individuals evaluated." << std::endl;
+    delete runner;
+  }
+
+  int s = timer.elapsed() / 1000;
+  std::cout << "MainCmd: Batch finished. Elapsed time: " << s << "s" << 
+    std::endl;
+  Log::write() << "MainCmd: Batch finished. Elapsed time: " << s << "s" << 
+    endl;
+  quit();
+}
+
+void MainCmd::runCrossValidation(int nFolds) {
+  QElapsedTimer timer;
+  timer.start();
+
+  CrossValidation crossValidation(search_, nFolds, MathAlgo::randSeed());
+  CrossValidatorMultiThread crossValidator(nThreads_, *search_);
+
+  crossValidator.evaluate(&crossValidation, search_->paretoFront());
+  crossValidation.submit(&db_);
+
+  int s = timer.elapsed() / 1000;
+  std::cout << "MainCmd: Cross-validation finished. Elapsed time: " << s << 
+            "s" << std::endl;
+  Log::write() << "MainCmd: Cross-validation finished. Elapsed time: " << s <<
+    "s" << endl;
+  quit();
+}
+
+// Recalculates the error of the Pareto and old Pareto individuals after
+// experiments have been added to or changed in the search.
+void MainCmd::runRescoring() {
+  QElapsedTimer timer;
+  timer.start();
+
+  QList<Individual*> individuals = search_->paretoFront() + 
+                                   search_->oldParetoFront();
+  QList<IndividualErrorTable*> errorTables;
+  int n = individuals.size();
+  for (int i = 0; i < n; ++i)
+    errorTables.append(new IndividualErrorTable(individuals.at(i), &db_));
+
+  RescorerMultiThread rescorer(nThreads_, *search_);
+  rescorer.rescore(errorTables);
+
+  db_.beginTransaction();
+  for (int i = 0; i < n; ++i) {
+    errorTables.at(i)->submit(&db_);
+    delete errorTables.at(i);
+  }
+  db_.endTransaction();
+
+  int s = timer.elapsed() / 1000;
+  std::cout << "MainCmd: Rescoring finished. Elapsed time: " << s << 
+            "s" << std::endl;
+  Log::write() << "MainCmd: Rescoring finished. Elapsed time: " << s <<
+    "s" << endl;
+  quit();
+}
+
+void MainCmd::runWorker(const QString &host, quint16 port) {
+  Log::write() << "MainCmd: Starting worker for " << host << ":" << port << 
+    endl;
+
+  EvaluationWorker worker(*search_);
+  bool ok = worker.run(host, port);
+
+  Log::write() << "MainCmd: Worker finished" << 
+    (ok ? "." : " (connection lost).") << endl;
+  quit();
+}
 
 void MainCmd::closeDB() {
   db_.disconnect();
 }
 
 bool MainCmd::connectDB(DB &db, const QString &dbFileName) {
-#ifdef QT_DEBUG
-  int error = db.connect(dbFileName, false); // Slow connection: checking foreign keys
-#else
-  int error = db.connect(dbFileName, true); // Fast connection: no foreign keys check, some operations are in memory, and disk write is delayed
-#endif
+  int error = db.connect(dbFileName, isFastDB());
 
   if (!error) {
     //ExperimentFactory::instance(&db);
+    if (!DBSea::upgradeDB(&db))
+      Log::write() << "Unable to upgrade the database schema (" << 
+        dbFileName << ")." << endl;
+
+    // The schema changes are not copied from the scratch copy, so it is made
+    // after upgrading the original file
+    if (!scratchDir_.isEmpty()) {
+      DB::setScratchDir(scratchDir_);
+      error = db.connect(dbFileName, isFastDB());
+    }
   }
   else if (error == 1) {
     Log::write() << "Unable to open the database file (" << dbFileName << ")."
@@ -118,4 +377,31 @@ bool MainCmd::connectDB(DB &db, const QString &dbFileName) {
   return error == 0;
 }
 
+// Comma-separated ids or ranges of ids, such as "3,7-9"
+QList<int> MainCmd::parseSearchIds(const QString &str) {
+  QList<int> ids;
+  QStringList items = str.split(',', QString::SkipEmptyParts);
+  int n = items.size();
+  for (int i = 0; i < n; ++i) {
+    QStringList range = items.at(i).split('-');
+    int first = range.first().toInt();
+    int last = range.last().toInt();
+    if (range.size() > 2 || first <= 0 || last < first)
+      return QList<int>();
+
+    for (int id = first; id <= last; ++id)
+      ids.append(id);
+  }
+
+  return ids;
+}
+
+bool MainCmd::isFastDB() const {
+#ifdef QT_DEBUG
+  return false; // Slow connection: checking foreign keys
+#else
+  return true; // Fast connection: no foreign keys check, some operations are in memory, and disk write is delayed
+#endif
+}
+
 } // namespace LoboLab
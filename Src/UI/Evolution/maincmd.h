@@ -23,12 +23,32 @@ class MainCmd : public QObject {
  private:
   void quit();
   void runSearch();
+  void runBatch(const QList<int> &searchIds);
+  void runWorker(const QString &host, quint16 port);
+  void runCrossValidation(int nFolds);
+  void runRescoring();
   void closeDB();
   bool connectDB(DB &db, const QString &dbFileName);
+  bool isFastDB() const;
+  static QList<int> parseSearchIds(const QString &str);
 
   DB db_;
+  QString dbFileName_;
   Search *search_;
   int nThreads_;
+  qint64 maxRateEvals_;
+  qint64 maxMsecs_;
+  quint16 serverPort_;
+  int nLocalWorkers_;
+  int batchSize_;
+  int iIslandProcess_;
+  int nIslandProcesses_;
+  QString spoolDir_;
+  QString scratchDir_;
+  bool asyncEvolution_;
+  QString checkpointFileName_;
+  int checkpointPeriod_;
+  bool resumeCheckpoint_;
 };
 
 } // namespace LoboLab
@@ -0,0 +1,144 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "rescorermultithread.h"
+#include "Search/individualerrortable.h"
+#include "Search/evaluatorproducts.h"
+#include "Search/individual.h"
+#include "Search/search.h"
+#include "Experiment/experiment.h"
+#include "Common/log.h"
+
+namespace LoboLab {
+
+RescorerMultiThread::RescorerMultiThread(int nThreads, const Search &search)
+  : nThreads_(nThreads),
+    search_(search) {
+}
+
+RescorerMultiThread::~RescorerMultiThread(void) {
+}
+
+// Returns the number of experiment simulations performed
+int RescorerMultiThread::rescore(
+    const QList<IndividualErrorTable*> &errorTables) {
+  // The checksums are calculated once here, instead of once per individual
+  int nExperiments = search_.nExperiments();
+  for (int i = 0; i < nExperiments; ++i) {
+    Experiment *experiment = search_.experiment(i);
+    experiments_.append(experiment);
+    checksums_.append(experiment->checksum());
+  }
+
+  pendTables_ = errorTables;
+
+  Log::write() << "RescorerMultiThread::rescore: " << errorTables.size() <<
+    " individuals, " << nExperiments << " experiments, " << nThreads_ << 
+    " threads." << endl;
+
+  QList<CalculatorThread*> threads;
+  for (int i = 0; i < nThreads_; ++i) {
+    CalculatorThread *thread = new CalculatorThread(search_, this);
+    threads.append(thread);
+    thread->start();
+  }
+
+  int nSimulations = 0;
+  for (int i = 0; i < nThreads_; ++i) {
+    threads.at(i)->wait();
+    nSimulations += threads.at(i)->nSimulations();
+    delete threads.at(i);
+  }
+
+  Log::write() << "RescorerMultiThread::rescore: " << nSimulations << 
+    " experiment simulations of " << errorTables.size() * nExperiments << 
+    " needed." << endl;
+
+  experiments_.clear();
+  checksums_.clear();
+
+  return nSimulations;
+}
+
+IndividualErrorTable *RescorerMultiThread::takeNextTable() {
+  IndividualErrorTable *errorTable = NULL;
+
+  mutex_.lock();
+  if (!pendTables_.isEmpty())
+    errorTable = pendTables_.takeFirst();
+  mutex_.unlock();
+
+  return errorTable;
+}
+
+// class CalculatorThread
+
+RescorerMultiThread::CalculatorThread::CalculatorThread(
+    const Search &search,
+    RescorerMultiThread *p)
+  : parent_(p), 
+    nSimulations_(0) {
+  evaluator_ = new EvaluatorProducts(search);
+}
+
+RescorerMultiThread::CalculatorThread::~CalculatorThread() {
+  wait();
+  delete evaluator_;
+}
+
+void RescorerMultiThread::CalculatorThread::run() {
+  setPriority(LowestPriority);
+
+  while (IndividualErrorTable *errorTable = parent_->takeNextTable())
+    rescore(errorTable);
+}
+
+// Each table is only accessed by one thread, so no locking is needed. The
+// contribution of an experiment whose simulation failed is not stored, as in
+// EvaluatorProducts::evaluate(), so the next rescore simulates it again. 
+// Failed contributions stored by older builds are simulated again too.
+void RescorerMultiThread::CalculatorThread::rescore(
+    IndividualErrorTable *errorTable) {
+  const QList<Experiment*> &experiments = parent_->experiments_;
+  const QList<QByteArray> &checksums = parent_->checksums_;
+  Individual *individual = errorTable->individual();
+  bool modelLoaded = false;
+  bool failed = false;
+
+  QList<double> contributions;
+  int n = experiments.size();
+  for (int i = 0; i < n; ++i) {
+    int experimentId = experiments.at(i)->id();
+    double contribution;
+    if (errorTable->isUpToDate(experimentId, checksums.at(i)) &&
+        errorTable->error(experimentId) >= 0.0) {
+      contribution = errorTable->error(experimentId);
+    } else {
+      if (!modelLoaded) {
+        evaluator_->loadModel(*individual->model());
+        modelLoaded = true;
+      }
+
+      contribution = 
+        evaluator_->calcExperimentContribution(*experiments.at(i));
+      if (contribution >= 0.0)
+        errorTable->setError(experimentId, checksums.at(i), contribution);
+      else
+        failed = true;
+      ++nSimulations_;
+    }
+
+    contributions.append(contribution);
+  }
+
+  // A simulator error is scored as in the evolution, only for this rescore
+  double error;
+  if (failed)
+    error = Individual::TimeoutError;
+  else
+    error = evaluator_->combineContributions(contributions);
+
+  individual->setError(error);
+}
+
+}
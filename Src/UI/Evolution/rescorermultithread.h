@@ -0,0 +1,61 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QList>
+#include <QThread>
+#include <QMutex>
+#include <QByteArray>
+
+namespace LoboLab {
+
+class EvaluatorProducts;
+class IndividualErrorTable;
+class Experiment;
+class Search;
+
+// Recalculates the error of stored individuals after the experiments of the
+// search have changed. Only the experiments without an up-to-date stored 
+// contribution are simulated. The individuals are distributed among several
+// threads.
+class RescorerMultiThread {
+
+ public:
+  RescorerMultiThread(int nThreads, const Search &search);
+  ~RescorerMultiThread(void);
+
+  int rescore(const QList<IndividualErrorTable*> &errorTables);
+
+ private:
+  class CalculatorThread : public QThread {
+   public:
+    CalculatorThread(const Search &search, RescorerMultiThread *parent);
+    ~CalculatorThread(void);
+
+    inline int nSimulations() const { return nSimulations_; }
+
+   protected:
+    void run();
+
+   private:
+    void rescore(IndividualErrorTable *errorTable);
+
+    EvaluatorProducts *evaluator_;
+    RescorerMultiThread *parent_;
+    int nSimulations_;
+  };
+
+  IndividualErrorTable *takeNextTable();
+
+  int nThreads_;
+  const Search &search_;
+
+  QList<Experiment*> experiments_;
+  QList<QByteArray> checksums_;
+  QList<IndividualErrorTable*> pendTables_;
+
+  QMutex mutex_;
+};
+
+} // namespace LoboLab
@@ -0,0 +1,78 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#include "searchrunner.h"
+#include "evaluationpool.h"
+#include "errorcalculatorpool.h"
+#include "DB/db.h"
+#include "DB/dbwriter.h"
+#include "Search/search.h"
+#include "Common/log.h"
+
+namespace LoboLab {
+
+SearchRunner::SearchRunner(int searchId, const QString &dbFileName, 
+                           bool inFastMode, EvaluationPool *pool)
+  : searchId_(searchId),
+    dbFileName_(dbFileName),
+    inFastMode_(inFastMode),
+    pool_(pool),
+    maxRateEvals_(0),
+    maxMsecs_(0),
+    errorCalculator_(NULL),
+    nEvaluated_(0) {
+}
+
+SearchRunner::~SearchRunner() {
+  wait();
+}
+
+// Must be called before starting the thread
+void SearchRunner::setBudget(qint64 maxRateEvals, qint64 maxMsecs) {
+  maxRateEvals_ = maxRateEvals;
+  maxMsecs_ = maxMsecs;
+}
+
+int SearchRunner::nEvaluated() {
+  progressMutex_.lock();
+  int n = errorCalculator_ ? errorCalculator_->nEvaluated() : nEvaluated_;
+  progressMutex_.unlock();
+
+  return n;
+}
+
+void SearchRunner::run() {
+  DB db;
+  if (db.connect(dbFileName_, inFastMode_)) {
+    Log::write() << "SearchRunner: Unable to open the database for search " <<
+      searchId_ << "." << endl;
+    return;
+  }
+
+  Search search(searchId_, &db, false);
+  DBWriter dbWriter(dbFileName_, inFastMode_);
+  dbWriter.start();
+  search.setDBWriter(&dbWriter);
+
+  ErrorCalculatorPool errorCalculator(search.nEvaluationUnits(), pool_, 
+                                      search);
+  errorCalculator.setBudget(maxRateEvals_, maxMsecs_);
+
+  progressMutex_.lock();
+  errorCalculator_ = &errorCalculator;
+  progressMutex_.unlock();
+
+  Log::write() << "SearchRunner: Search " << searchId_ << " started." << endl;
+  search.runEvolution(&errorCalculator);
+  Log::write() << "SearchRunner: Search " << searchId_ << " finished." << 
+    endl;
+
+  progressMutex_.lock();
+  nEvaluated_ = errorCalculator.nEvaluated();
+  errorCalculator_ = NULL;
+  progressMutex_.unlock();
+
+  search.setDBWriter(NULL);
+}
+
+}
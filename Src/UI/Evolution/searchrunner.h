@@ -0,0 +1,46 @@
+// Copyright (c) Lobo Lab (lobolab.umbc.edu)
+// All rights reserved.
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QString>
+
+namespace LoboLab {
+
+class EvaluationPool;
+class ErrorCalculatorPool;
+
+// Thread that runs one search of a batch. The search uses its own database 
+// connections, since the connections cannot be shared between threads, and 
+// its individuals are evaluated in the pool shared by the batch.
+class SearchRunner : public QThread {
+ public:
+  SearchRunner(int searchId, const QString &dbFileName, bool inFastMode,
+               EvaluationPool *pool);
+  ~SearchRunner();
+
+  inline int searchId() const { return searchId_; }
+  void setBudget(qint64 maxRateEvals, qint64 maxMsecs);
+
+  // Individuals evaluated until now, readable from any thread
+  int nEvaluated();
+
+ protected:
+  void run();
+
+ private:
+  int searchId_;
+  QString dbFileName_;
+  bool inFastMode_;
+  EvaluationPool *pool_;
+  qint64 maxRateEvals_;
+  qint64 maxMsecs_;
+
+  ErrorCalculatorPool *errorCalculator_; // While the search is running
+  int nEvaluated_; // After the search
+  QMutex progressMutex_;
+};
+
+} // namespace LoboLab
@@ -18,9 +18,9 @@
 
 namespace LoboLab {
 
-  ModelFormulaWidget::ModelFormulaWidget(Model *m,
-                                         const QHash<int, Product*> &products,
-                                         QWidget * parent)
+  ModelFormulaWidget::ModelFormulaWidget(const Model *m,
+                                          const QHash<int, Product*> &products,
+                                          QWidget * parent)
   : FormulaWidget(parent), 
     model_(m),
     products_(products) {
@@ -64,22 +64,22 @@ void ModelFormulaWidget::updateFormula() {
 
   for (int i = 1; i < nProducts; ++i) {
     int label = usedLabels[i];
-    ModelProd *prod = model_->prodWithLabel(label);
+    const ModelProd *prod = model_->prodWithLabel(label);
     
     mathMLStr += "<mtr><mtd columnalign='right'>";
     mathMLStr += QString("<mfrac><mrow><mo>&#x64;</mo><mi mathvariant='italic'>%1</mi></mrow><mrow><mo>&#x64;</mo><mi>t</mi></mrow></mfrac>").arg(names.at(i));
     mathMLStr +="</mtd><mtd columnalign='center'><mo>=</mo></mtd><mtd columnalign='left'>";
 
     // links
-  QList<ModelLink*> links = model_->linksToLabel(label);
+  QList<const ModelLink*> links = model_->linksToLabel(label);
   qSort(links.begin(), links.end(), linkRegulatorLessThan);
   int nLinks = links.size();
 
   if (nLinks > 0) {
-    QList<ModelLink*> orLinks, andLinks;
+    QList<const ModelLink*> orLinks, andLinks;
     bool anyActivator = false;
     for (int j = 0; j < nLinks; ++j) {
-      ModelLink *link = links[j];
+      const ModelLink *link = links[j];
       if (link->isAndReg())
         andLinks.append(link);
       else
@@ -98,7 +98,7 @@ void ModelFormulaWidget::updateFormula() {
     mathMLStr += "<mfrac>";
     if (anyActivator) {
       for (int j = 0; j < nOrLinks; ++j) {
-        ModelLink *link = orLinks[j];
+        const ModelLink *link = orLinks[j];
         if (link->hillCoef() >= 0) {
           hillStr = createLinkHillFormula(link,
             names[usedLabels.indexOf(link->regulatorProdLabel())]);
@@ -112,7 +112,7 @@ void ModelFormulaWidget::updateFormula() {
       }
       
       for (int j = 0; j < nAndLinks; ++j) {
-        ModelLink *link = andLinks[j];
+        const ModelLink *link = andLinks[j];
         if (link->hillCoef() >= 0) {
           hillStr = createLinkHillFormula(link,
             names[usedLabels.indexOf(link->regulatorProdLabel())]);
@@ -187,7 +187,8 @@ QString ModelFormulaWidget::createLinkHillFormula(const ModelLink *link,
 }
 
 // For sorting
-bool ModelFormulaWidget::linkRegulatorLessThan(ModelLink *l1, ModelLink *l2) {
+bool ModelFormulaWidget::linkRegulatorLessThan(const ModelLink *l1,
+                                               const ModelLink *l2) {
   return (l1->regulatorProdLabel() < l2->regulatorProdLabel());
 }
 
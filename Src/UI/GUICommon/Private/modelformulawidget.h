@@ -18,7 +18,7 @@ class ModelFormulaWidget : public FormulaWidget {
   Q_OBJECT
 
  public:
-  ModelFormulaWidget(Model *m, const QHash<int, Product*> &products, QWidget * parent = NULL);
+  ModelFormulaWidget(const Model *m, const QHash<int, Product*> &products, QWidget * parent = NULL);
   virtual ~ModelFormulaWidget();
 
   void updateFormula();
@@ -29,9 +29,10 @@ class ModelFormulaWidget : public FormulaWidget {
  private:
   QString createLinkLinearFormula(const ModelLink *link, const QString &regulator) const;
   QString createLinkHillFormula(const ModelLink *link, const QString &regulator) const;
-  static bool linkRegulatorLessThan(ModelLink *l1, ModelLink *l2);
+  static bool linkRegulatorLessThan(const ModelLink *l1,
+                                    const ModelLink *l2);
 
-  Model *model_;
+  const Model *model_;
   const QHash<int, Product*> &products_;
 };
 
@@ -17,7 +17,7 @@
 
 namespace LoboLab {
 
-ModelProdListWidget::ModelProdListWidget(Model *m, QWidget * parent)
+ModelProdListWidget::ModelProdListWidget(const Model *m, QWidget * parent)
   : QListWidget(parent), model_(m) {
   createActions();
 
@@ -127,7 +127,7 @@ void ModelProdListWidget::createList() {
   int nProducts = labels.size();
   for (int i = 0; i < nProducts; ++i) {
     int label = labels.at(i);
-    ModelProd *modelProd = model_->prodWithLabel(labels.at(i));
+    const ModelProd *modelProd = model_->prodWithLabel(labels.at(i));
 
     QString preStr;
     if (labels.last() > 9 && label < 10)
@@ -166,7 +166,7 @@ void ModelProdListWidget::createList() {
     addItem(item);
 
     // Links
-    QList<ModelLink*> links = model_->linksToLabel(label);
+    QList<const ModelLink*> links = model_->linksToLabel(label);
 
     if (labels.last() > 9)
       preStr = "    ";
@@ -175,7 +175,7 @@ void ModelProdListWidget::createList() {
 
     int nLinks = links.size();
     for (int j = 0; j < nLinks; ++j) {
-      ModelLink *link = links.at(j);
+      const ModelLink *link = links.at(j);
       int regulatorLabel = link->regulatorProdLabel();
       QString postStr;
       if (regulatorLabel < 10)
@@ -14,7 +14,7 @@ class ModelProdListWidget : public QListWidget {
   Q_OBJECT
 
  public:
-  ModelProdListWidget(Model *m, QWidget * parent = NULL);
+  ModelProdListWidget(const Model *m, QWidget * parent = NULL);
   virtual ~ModelProdListWidget();
 
   void updateList();
@@ -41,7 +41,7 @@ class ModelProdListWidget : public QListWidget {
   bool selectBoolValue(bool *ok, const QString &label);
   int selectDirection(bool *ok);
 
-  Model *model_;
+  const Model *model_;
 
   QMenu *prodContextMenu_;
   QMenu *blankContextMenu_;
@@ -332,8 +332,10 @@ namespace LoboLab {
     sort(labels.begin(), labels.end());
     out << "\t\t<listOfParameters>" << endl;
     
+    // Read through a const pointer, which keeps the blocks shared
+    const Model *model = model_;
     for (int i = 0; i < labels.size(); ++i) {
-      ModelProd* prod = model_->prodWithLabel(labels.at(i));
+      const ModelProd* prod = model->prodWithLabel(labels.at(i));
       out << "\t\t\t<parameter id=\"lambda" << labels.at(i) << "\" constant=\"true\" value=\""
         << prod->deg() << "\"/>" << endl;
     }
@@ -341,9 +343,10 @@ namespace LoboLab {
     //stores link objects instead of link pointers
     QList<ModelLink> linkList;
     int i = 0;
-    int listSize = model_->links().size();
+    QList<const ModelLink*> links = model->links();
+    int listSize = links.size();
     for (; i < listSize; i++) {
-      ModelLink temp = *((model_->links())[i]);
+      ModelLink temp = *(links[i]);
       linkList.append(temp);
     }
     //sorts links in order by subclone that is regulated
@@ -378,11 +381,12 @@ namespace LoboLab {
     out << "\t\t\t</assignmentRule>" << endl;
     
     // create dictionary of links for each subclone label
-    QMap<int, QList<ModelLink*>> clonelinks;
+    const Model *model = model_;
+    QMap<int, QList<const ModelLink*>> clonelinks;
     for (int i = 0; i < labels.size(); ++i) {
-      QList<ModelLink*> links; 
+      QList<const ModelLink*> links; 
       if (labels[i] > 1) {
-        links = model_->linksToLabel(labels[i]);
+        links = model->linksToLabel(labels[i]);
         clonelinks[labels[i]] = links; 
       }
     }
@@ -16,7 +16,8 @@
 
 namespace LoboLab {
 
-ModelGraphView::ModelGraphView(Model *m, const QHash<int, Product*> &products, 
+ModelGraphView::ModelGraphView(const Model *m,
+                               const QHash<int, Product*> &products, 
                                bool hideNotUsed, bool includeAllFeatures,
                                QWidget * parent)
   : ZoomGraphicsView(parent, true, false), 
@@ -107,7 +108,7 @@ void ModelGraphView::writeModel2Dot(QTextStream &stream, bool hideNotUsed, bool
 
     // Drugs are showed with plain nodes
     bool isPlain;
-    ModelProd *modelProd = model_->prodWithLabel(label);
+    const ModelProd *modelProd = model_->prodWithLabel(label);
       isPlain = false;
 
     if (usedLabels.contains(labels.at(i))) {
@@ -128,11 +129,11 @@ void ModelGraphView::writeModel2Dot(QTextStream &stream, bool hideNotUsed, bool
   int n = labels.size();
   for (int i = 0; i < n; ++i) {
     int regulatedLabel = labels.at(i);
-    QList<ModelLink*> links = model_->linksToLabel(regulatedLabel);
+    QList<const ModelLink*> links = model_->linksToLabel(regulatedLabel);
 
     int nLinks = links.size();
     for (int j = 0; j < nLinks; ++j) {
-      ModelLink *link = links.at(j);
+      const ModelLink *link = links.at(j);
 
       bool linkIsUsed = usedLabels.contains(link->regulatorProdLabel()) &&
                         usedLabels.contains(link->regulatedProdLabel());
@@ -20,7 +20,7 @@ class ModelGraphView : public ZoomGraphicsView {
   Q_OBJECT
 
  public:
-  ModelGraphView(Model *m, const QHash<int, Product*> &products,
+  ModelGraphView(const Model *m, const QHash<int, Product*> &products,
                  bool hideNotUsed = false, bool includeAllFeatures = false, QWidget * parent = NULL);
   virtual ~ModelGraphView();
 
@@ -38,7 +38,7 @@ class ModelGraphView : public ZoomGraphicsView {
   void writeProdAttribs(QTextStream &stream, const QStringList &props,
                         const QStringList &style) const;
 
-  Model *model_;
+  const Model *model_;
   ConcentPlotWidget *concPlotWidget_;
   QGraphicsSvgItem *svgItem_;
   QProcess *process_;
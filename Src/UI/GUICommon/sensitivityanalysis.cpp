@@ -37,19 +37,21 @@ namespace LoboLab {
 
 
   QList<SensitivityAnalysis::Parameter> SensitivityAnalysis::getParameters(ModelForm* modelFormPtr,
-    Model* model) {
+    const Model* model) {
 
     QList<Parameter> paras; 
     int numProds = model->nProducts();
 
     //stores link objects instead of link pointers
     QList<ModelLink> linkList;
+    QList<const ModelLink*> links = model->links();
+    QList<const ModelLink*> linksInUse = model->calcLinksInUse();
     int i = 0;
-    int listSize = model->links().size();
+    int listSize = links.size();
     for (; i < listSize; i++) {
-      ModelLink temp = *((model->links())[i]);
+      ModelLink temp = *(links[i]);
       if (!(temp.regulatedProdLabel() > 20))
-        if (model->calcLinksInUse().contains((model->links())[i]))
+        if (linksInUse.contains(links[i]))
           linkList.append(temp);
     }
     //sorts links in order by subclone that is regulated
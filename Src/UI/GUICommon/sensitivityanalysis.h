@@ -44,7 +44,8 @@ namespace LoboLab {
         double auc;
       }Parameter;
 
-      QList<Parameter> getParameters(ModelForm* modelFormPtr, Model* modelPtr);
+      QList<Parameter> getParameters(ModelForm* modelFormPtr,
+                                     const Model* modelPtr);
       void runSensitAnalysis(ModelForm* modelFormPtr, Model* modelPtr, DB* dbPtr, Search* search); 
       Experiment* createOrigExp(DB* dbPtr); 
       double simExp(Experiment* expPtr, Model* modelPtr, Search* searchPtr); 
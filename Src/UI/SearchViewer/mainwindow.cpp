@@ -10,6 +10,7 @@
 #include "Experiment/product.h"
 #include "DB/db.h"
 #include "DB/dbsea.h"
+#include "DB/dbpagedmodel.h"
 #include "Common/fileutils.h"
 #include "Search/search.h"
 #include "Search/deme.h"
@@ -46,12 +47,12 @@
 namespace LoboLab {
 
 MainWindow::MainWindow()
-    : search_(NULL),
+    : readOnly_(false),
+      search_(NULL),
       searchModel_(NULL), 
       demeModel_(NULL), 
       generationModel_(NULL),
       individualsModel_(NULL), 
-      individualsSortProxyModel_(NULL),
       maxRangeValue_(0) {
   db_ = new DB();
 
@@ -203,6 +204,16 @@ void MainWindow::createActionsAndMenus() {
                           ":/Images/famfamfam_silk_icons/folder_database.png"));
   connect(openDBAction, SIGNAL(triggered()), this, SLOT(openDB()));
 
+  QAction *openDBReadOnlyAction = new QAction(tr("Open database &read-only..."),
+                                              this);
+  openDBReadOnlyAction->setShortcut(tr("Ctrl+R"));
+  openDBReadOnlyAction->setStatusTip(tr("Load a database file for viewing, "
+                                        "even while a search writes it"));
+  openDBReadOnlyAction->setIcon(QIcon(
+                                 ":/Images/famfamfam_silk_icons/folder_database.png"));
+  connect(openDBReadOnlyAction, SIGNAL(triggered()), 
+          this, SLOT(openDBReadOnly()));
+
 
   QAction *openDBAppDirAction = new QAction(tr("&Open database app dir..."), this);
   openDBAppDirAction->setShortcut(tr("Ctrl+A"));
@@ -226,6 +237,12 @@ void MainWindow::createActionsAndMenus() {
                            ":/Images/famfamfam_silk_icons/database_go.png"));
   connect(closeDBAction_, SIGNAL(triggered()), this, SLOT(closeDB()));
 
+  refreshAction_ = new QAction(tr("Re&fresh"), this);
+  refreshAction_->setShortcut(QKeySequence::Refresh);
+  refreshAction_->setStatusTip(tr("Reload the plot and the individuals with "
+                                  "the last saved generations"));
+  connect(refreshAction_, SIGNAL(triggered()), this, SLOT(refresh()));
+
   importDBAction_ = new QAction(tr("&Import database..."), this);
   importDBAction_->setShortcut(tr("Ctrl+I"));
   importDBAction_->setStatusTip(tr("Import the experiments of another database "
@@ -283,9 +300,11 @@ void MainWindow::createActionsAndMenus() {
   QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
   fileMenu->addAction(newDBAction);
   fileMenu->addAction(openDBAction);
+  fileMenu->addAction(openDBReadOnlyAction);
   fileMenu->addAction(openDBAppDirAction);
   fileMenu->addAction(saveAsDBAction_);
   fileMenu->addAction(closeDBAction_);
+  fileMenu->addAction(refreshAction_);
 
   QAction *separator = new QAction(this);
   separator->setSeparator(true);
@@ -362,6 +381,7 @@ void MainWindow::newDB() {
     }
 
     closeDB();
+    readOnly_ = false;
 
     if (db_->createEmptyDB(fileName)) {
       DBSea::buildDB(db_);
@@ -378,6 +398,7 @@ void MainWindow::newDB() {
 
 // Called only from macapp (double click open file)
 void MainWindow::openDB(const QString &fileName) {
+  readOnly_ = false;
   dbFileName_ = fileName;
   connectDB();
 }
@@ -388,6 +409,20 @@ void MainWindow::openDB() {
                      dbFileName_, "Search databases (*.sdb)");
 
   if (!fileName.isEmpty()) {
+    readOnly_ = false;
+    dbFileName_ = fileName;
+    connectDB();
+  }
+}
+
+// private slot
+void MainWindow::openDBReadOnly() {
+  QString fileName = QFileDialog::getOpenFileName(this, 
+                     "Open database read-only", dbFileName_, 
+                     "Search databases (*.sdb)");
+
+  if (!fileName.isEmpty()) {
+    readOnly_ = true;
     dbFileName_ = fileName;
     connectDB();
   }
@@ -400,6 +435,7 @@ void MainWindow::openDBAppDir() {
                      qApp->applicationDirPath() + QString("\\"), "Search databases (*.sdb)");
 
   if (!fileName.isEmpty()) {
+    readOnly_ = false;
     dbFileName_ = fileName;
     connectDB();
   }
@@ -430,8 +466,6 @@ void MainWindow::saveAsDB() {
 // private slot
 void MainWindow::closeDB() {
   if (!dbFileName_.isEmpty()) {
-    delete individualsSortProxyModel_;
-    individualsSortProxyModel_ = NULL;
     delete individualsModel_;
     individualsModel_ = NULL;
     delete generationModel_;
@@ -449,14 +483,33 @@ void MainWindow::closeDB() {
   }
 }
 
+// private slot
+// Each query reads the last committed state, so the generations saved by a
+// running search since the last update are shown
+void MainWindow::refresh() {
+  if (search_) {
+    updatePlot();
+    updateIndividuals();
+  }
+}
+
 void MainWindow::connectDB(bool silent) {
   statusBarText_->setText("Opening database...");
   QString fileName = dbFileName_;
   dbFileName_.clear();
-  int error = db_->connect(fileName);
+  int error;
+  if (readOnly_)
+    error = db_->connectReadOnly(fileName);
+  else
+    error = db_->connect(fileName);
+
   if (!error) {
     dbFileName_ = fileName;
 
+    // The plots and the individuals list read the generations by deme
+    if (!readOnly_ && QFileInfo(fileName).isWritable())
+      DBSea::createIndexes(db_);
+
     searchModel_ = db_->newTableModel("Search", "Name");
     searchComboBox_->setModelColumn(Search::FName);
     searchComboBox_->setModel(searchModel_);
@@ -517,6 +570,7 @@ void MainWindow::updateStatus() {
 
     saveAsDBAction_->setEnabled(false);
     closeDBAction_->setEnabled(false);
+    refreshAction_->setEnabled(false);
     importDBAction_->setEnabled(false);
     morDistAction_->setEnabled(false);
     morDistCompAction_->setEnabled(false);
@@ -527,20 +581,24 @@ void MainWindow::updateStatus() {
   } else {
     QFileInfo dbFileInfo(dbFileName_);
     QString windowTitle = dbFileInfo.fileName();
-    if (!dbFileInfo.isWritable())
+    bool writable = dbFileInfo.isWritable() && !readOnly_;
+    if (!writable)
       windowTitle += " (read only)";
     windowTitle += " - Search Viewer";
     setWindowTitle(windowTitle);
     statusBarText_->setText("Database opened");
 
-    saveAsDBAction_->setEnabled(true);
+    // Copying the file alone would miss the changes still in the log of a
+    // running search
+    saveAsDBAction_->setEnabled(!readOnly_);
     closeDBAction_->setEnabled(true);
-    importDBAction_->setEnabled(true);
+    refreshAction_->setEnabled(true);
+    importDBAction_->setEnabled(writable);
     morDistAction_->setEnabled(true);
     morDistCompAction_->setEnabled(true);
-    deleteExperimentsAction_->setEnabled(true);
-    deleteExpAndManipulationsAction_->setEnabled(true);
-    deleteAllAction_->setEnabled(true);
+    deleteExperimentsAction_->setEnabled(writable);
+    deleteExpAndManipulationsAction_->setEnabled(writable);
+    deleteAllAction_->setEnabled(writable);
   }
 }
 
@@ -827,8 +885,6 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
 
 void MainWindow::searchComboChanged(int index) {
   individualsTable_->reset();
-  delete individualsSortProxyModel_;
-  individualsSortProxyModel_ = NULL;
   delete individualsModel_;
   individualsModel_ = NULL;
   errorPlotWidget_->clear();
@@ -951,8 +1007,6 @@ void MainWindow::updateIndividualsList() {
   setCursor(Qt::WaitCursor);
   QApplication::processEvents();
   
-  delete individualsSortProxyModel_;
-  individualsSortProxyModel_ = NULL;
   delete individualsModel_;
   individualsModel_ = NULL;
   
@@ -989,21 +1043,20 @@ void MainWindow::updateIndividualsList() {
 
   sql += " GROUP BY Individual.Id";
   
-  individualsModel_ = db_->newModel(sql);
-  individualsSortProxyModel_ = new QSortFilterProxyModel();
-  individualsSortProxyModel_->setSourceModel(individualsModel_);
-  individualsTable_->setModel(individualsSortProxyModel_);
-  individualsTable_->sortByColumn(0, Qt::AscendingOrder);
-  individualsTable_->sortByColumn(7, Qt::AscendingOrder);
-  individualsTable_->sortByColumn(6, Qt::AscendingOrder);
+  // The rows are read in pages as they are shown, and sorted by the database,
+  // so the memory does not depend on the size of the search. Sorted by 
+  // error, and then by complexity and time.
+  individualsModel_ = new DBPagedModel(db_, sql, 5);
+  individualsModel_->setTieColumns(QList<int>() << 7 << 0);
+  individualsTable_->setModel(individualsModel_);
   individualsTable_->setSortingEnabled(true);
+  individualsTable_->sortByColumn(6, Qt::AscendingOrder);
 
   setCursor(Qt::ArrowCursor);
 }
 
 void MainWindow::individualClicked() {
-  QModelIndex index = individualsSortProxyModel_->mapToSource(
-    individualsTable_->currentIndex());
+  QModelIndex index = individualsTable_->currentIndex();
   if (index.isValid()) {
     int indId = individualsModel_->index(index.row(), 5).data().toInt();
 
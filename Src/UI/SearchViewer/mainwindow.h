@@ -13,7 +13,6 @@
 #include <QGroupBox>
 #include <QSqlQueryModel>
 #include <QSlider>
-#include <QSortFilterProxyModel>
 #include <QProcess>
 
 namespace LoboLab {
@@ -23,6 +22,7 @@ class ErrorPlotWidget;
 class Search;
 class Product;
 class DB;
+class DBPagedModel;
 
 class MainWindow : public QMainWindow {
   Q_OBJECT
@@ -40,9 +40,11 @@ class MainWindow : public QMainWindow {
  private slots:
   void newDB();
   void openDB();
+  void openDBReadOnly();
   void openDBAppDir();
   void saveAsDB();
   void closeDB();
+  void refresh();
   void initDataBase();
   void processError(QProcess::ProcessError error);
 
@@ -93,6 +95,7 @@ class MainWindow : public QMainWindow {
 
 
   QString dbFileName_;
+  bool readOnly_; // For viewing a database while a search writes it
   DB *db_;
 
   Search *search_;
@@ -100,8 +103,7 @@ class MainWindow : public QMainWindow {
   QSqlQueryModel *searchModel_;
   QSqlQueryModel *demeModel_;
   QSqlQueryModel *generationModel_;
-  QSqlQueryModel *individualsModel_;
-  QSortFilterProxyModel *individualsSortProxyModel_;
+  DBPagedModel *individualsModel_;
   
   QComboBox *searchComboBox_;
 
@@ -126,6 +128,7 @@ class MainWindow : public QMainWindow {
   
   QAction *saveAsDBAction_;
   QAction *closeDBAction_;
+  QAction *refreshAction_;
   QAction *importDBAction_;
 
   QAction *morDistAction_;